@@ -0,0 +1,53 @@
+#include "alloccounter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <stddef.h>
+
+// the underlying allocator in glibc
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+// the number of allocations made by each thread
+static thread_local unsigned long allocationCount = 0;
+
+unsigned long threadAllocationCount()
+{
+    return(allocationCount);
+}
+
+// interpose the allocation functions to count calls; operator new and Qt's
+//  containers both end up here
+extern "C" {
+
+void *malloc(size_t size)
+{
+    allocationCount++;
+    return(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocationCount++;
+    return(__libc_calloc(count, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocationCount++;
+    return(__libc_realloc(ptr, size));
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    allocationCount++;
+    return(__libc_memalign(alignment, size));
+}
+
+}
+
+#endif // COUNT_ALLOCATIONS
@@ -0,0 +1,15 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+// When built with COUNT_ALLOCATIONS defined (qmake CONFIG+=count_allocations),
+//  every heap allocation is counted per thread so code that's meant to be
+//  allocation-free can check itself. Counting works by interposing malloc,
+//  which also catches allocations made by Qt containers, so it's only
+//  available with glibc.
+
+#ifdef COUNT_ALLOCATIONS
+// get the number of heap allocations made by the calling thread so far
+unsigned long threadAllocationCount();
+#endif
+
+#endif // ALLOCCOUNTER_H
@@ -0,0 +1,515 @@
+#include "analyzer.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <QDebug>
+
+#include "alloccounter.h"
+#include "profiler.h"
+
+// the default length of audio to accumulate into the wheels before
+//  publishing them
+#define WINDOW_SECONDS 0.05
+// the default length of audio the input buffers before waking the worker
+#define BLOCK_SECONDS 0.005
+// the longest the worker sleeps without being woken, in milliseconds, so it
+//  keeps applying changes when there's no input
+#define IDLE_MSECS 100
+
+Analyzer::Analyzer(QObject *parent) :
+    QThread(parent)
+{
+    requested.input = NULL;
+    requested.blockSeconds = BLOCK_SECONDS;
+    requested.inputChanged = false;
+    requested.resolution = 0;
+    requested.specsChanged = false;
+    requested.integration = IntegrateLeaky;
+    requested.windowSeconds = WINDOW_SECONDS;
+    requested.integrationChanged = false;
+    requested.filtering = true;
+    requested.noiseGate = PRE_GATE_OFF;
+    requested.preprocessChanged = false;
+    requested.osc = NULL;
+    requested.oscChanged = false;
+    input = NULL;
+    sem_init(&wake, 0, 0);
+    blockSeconds = BLOCK_SECONDS;
+    specsChanged = false;
+    resolution = 0;
+    plannedRate = 0.0;
+    integration = IntegrateLeaky;
+    windowSeconds = WINDOW_SECONDS;
+    integrationChanged = true;
+    filtering = true;
+    noiseGate = PRE_GATE_OFF;
+    preprocessChanged = false;
+    autoselect = true;
+    osc = NULL;
+    oscChanged = false;
+    stopping = false;
+    publishedFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (publishedFd < 0) {
+        qWarning() << "Failed to make an eventfd for publishing wheels:" <<
+            strerror(errno);
+    }
+}
+
+void Analyzer::setInput(AudioInput *newInput)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.input = newInput;
+    requested.inputChanged = true;
+    poke();
+}
+
+void Analyzer::waitForRelease(AudioInput *oldInput)
+{
+    QMutexLocker lock(&controlMutex);
+    while ((oldInput != NULL) && (input == oldInput) && (! stopping) &&
+           (isRunning())) {
+        inputTaken.wait(&controlMutex);
+    }
+}
+
+void Analyzer::setChannels(const QList<ChannelSpec> &newSpecs)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.specs = newSpecs;
+    requested.specsChanged = true;
+    poke();
+}
+
+void Analyzer::setResolution(int bins)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.resolution = bins;
+    requested.specsChanged = true;
+    poke();
+}
+
+bool Analyzer::setOsc(const QString &host, int port)
+{
+    // look the host up before taking the lock, since that can take a while
+    bool ok = true;
+    OscPublisher *newOsc = NULL;
+    if (! host.isEmpty()) {
+        newOsc = new OscPublisher();
+        if (! newOsc->open(host.toUtf8().constData(), port)) {
+            delete newOsc;
+            newOsc = NULL;
+            ok = false;
+        }
+    }
+    controlMutex.lock();
+    // the worker lets go of the publisher it's using, but one it hasn't
+    //  taken up yet can go right away
+    OscPublisher *untaken = requested.oscChanged ? requested.osc : NULL;
+    requested.osc = newOsc;
+    requested.oscChanged = true;
+    controlMutex.unlock();
+    poke();
+    delete untaken;
+    return(ok);
+}
+
+void Analyzer::setAutoselect(bool value)
+{
+    autoselect = value;
+}
+
+void Analyzer::setIntegration(IntegrationMode mode)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.integration = mode;
+    requested.integrationChanged = true;
+    poke();
+}
+
+void Analyzer::setWindowSeconds(float seconds)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.windowSeconds = seconds;
+    requested.integrationChanged = true;
+    poke();
+}
+
+void Analyzer::setPreprocessing(bool filter, float gateDb)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.filtering = filter;
+    requested.noiseGate = gateDb;
+    requested.preprocessChanged = true;
+    poke();
+}
+
+void Analyzer::setBlockSeconds(float seconds)
+{
+    QMutexLocker lock(&controlMutex);
+    requested.blockSeconds = seconds;
+    requested.inputChanged = true;
+    poke();
+}
+
+void Analyzer::stop()
+{
+    stopping = true;
+    poke();
+    wait();
+    // nothing is using an input once the worker has exited
+    QMutexLocker lock(&controlMutex);
+    inputTaken.wakeAll();
+}
+
+OscPublisher *Analyzer::takeRequests()
+{
+    OscPublisher *oldOsc = NULL;
+    if (requested.inputChanged) {
+        if ((input != NULL) && (input != requested.input)) {
+            input->setWakeup(NULL, 0);
+        }
+        input = requested.input;
+        blockSeconds = requested.blockSeconds;
+        if (input != NULL) {
+            input->setWakeup(&wake,
+                (jack_nframes_t)(blockSeconds * (float)input->getSampleRate()));
+        }
+        requested.inputChanged = false;
+        inputTaken.wakeAll();
+    }
+    if (requested.specsChanged) {
+        specs = requested.specs;
+        resolution = requested.resolution;
+        specsChanged = true;
+        requested.specsChanged = false;
+    }
+    if (requested.integrationChanged) {
+        integration = requested.integration;
+        windowSeconds = requested.windowSeconds;
+        integrationChanged = true;
+        requested.integrationChanged = false;
+    }
+    if (requested.preprocessChanged) {
+        filtering = requested.filtering;
+        noiseGate = requested.noiseGate;
+        preprocessChanged = true;
+        requested.preprocessChanged = false;
+    }
+    if (requested.oscChanged) {
+        oldOsc = osc;
+        osc = requested.osc;
+        oscChanged = true;
+        requested.oscChanged = false;
+    }
+    return(oldOsc);
+}
+
+void Analyzer::run()
+{
+    int channels;
+    bool planChanged, anyFinished;
+#ifndef QT_NO_DEBUG
+    // make sure the accumulation kernel agrees with the reference kernel
+    float deviation;
+    KernelType kernelType = bestKernelType();
+    if (! checkKernel(kernelType, &deviation)) {
+        qWarning() << "The" << kernelTypeName(kernelType) <<
+            "accumulation kernel failed its check, deviation:" << deviation;
+    }
+#endif
+    Profiler::nameThread("analyzer");
+    while (! stopping) {
+#ifdef COUNT_ALLOCATIONS
+        unsigned long allocations = threadAllocationCount();
+#endif
+        // take up new settings without holding the lock while planning or
+        //  analyzing, so control calls never wait on the worker
+        controlMutex.lock();
+        OscPublisher *oldOsc = takeRequests();
+        controlMutex.unlock();
+        delete oldOsc;
+        planChanged = applyPlan();
+        if (oscChanged) {
+            if (osc != NULL) planOsc();
+            oscChanged = false;
+            planChanged = true;
+        }
+        if (input != NULL) {
+            // gather each channel's buffered audio here, since the input
+            //  only allows one thread to read it
+            channels = engines.size();
+            AudioSpan *span = spans.data();
+            for (int c = 0; c < channels; c++) {
+                if (c < input->getChannels()) input->readSpans(c, span);
+                else memset(span, 0, 2 * sizeof(AudioSpan));
+                span += 2;
+            }
+            // process it in place on the pool and then release it
+            pool.run(processChannel, this, channels);
+            span = spans.data();
+            anyFinished = false;
+            for (int c = 0; c < channels; c++) {
+                if (c < input->getChannels()) {
+                    input->advance(c, span[0].count + span[1].count);
+                }
+                if (finished.at(c)) anyFinished = true;
+                span += 2;
+            }
+            if (anyFinished) publish();
+        }
+#ifdef COUNT_ALLOCATIONS
+        // once the wheels are built, analysis should never allocate
+        if ((! planChanged) && (threadAllocationCount() != allocations)) {
+            qWarning() << "The analyzer allocated memory" <<
+                (threadAllocationCount() - allocations) << "times while running";
+        }
+#else
+        (void)planChanged;
+#endif
+        waitForAudio();
+    }
+}
+
+void Analyzer::waitForAudio()
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)IDLE_MSECS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+    }
+    while ((sem_timedwait(&wake, &deadline) != 0) && (errno == EINTR)) { }
+    // everything buffered gets processed at once, so extra posts that came
+    //  in while the worker was busy don't need their own passes
+    while (sem_trywait(&wake) == 0) { }
+}
+
+bool Analyzer::applyPlan()
+{
+    int c, i, count;
+    // keep the last plan's rate while there's no input so a reconnecting
+    //  input at the same rate doesn't force a rebuild
+    float sampleRate = (input != NULL) ? (float)input->getSampleRate() :
+        ((plannedRate > 0.0) ? plannedRate : 44100.0);
+    // cleaning up the input doesn't change the wheels
+    if (preprocessChanged) {
+        for (c = 0; c < engines.size(); c++) {
+            engines.at(c)->setFiltering(filtering);
+            engines.at(c)->setNoiseGate(noiseGate);
+        }
+        preprocessChanged = false;
+    }
+    if (integrationChanged) {
+        for (c = 0; c < engines.size(); c++) {
+            engines.at(c)->setIntegration(integration, DEFAULT_INTEGRATION_CYCLES);
+            engines.at(c)->setWindowFrames((int)(windowSeconds * sampleRate));
+        }
+        integrationChanged = false;
+        if ((! specsChanged) && (sampleRate == plannedRate)) return(true);
+    }
+    if ((! specsChanged) && (sampleRate == plannedRate)) return(false);
+    // when only frequencies have changed, retune the wheels in place so they
+    //  keep what they've accumulated
+    if ((sampleRate == plannedRate) && (canRetune())) {
+        for (c = 0; c < specs.length(); c++) {
+            const QList<WheelSpec> &wheels = specs.at(c).wheels;
+            count = wheels.length();
+            float *frequencies = new float[count];
+            for (i = 0; i < count; i++) {
+                frequencies[i] = wheels.at(i).frequency;
+            }
+            engines.at(c)->retuneWheels(frequencies, count);
+            delete[] frequencies;
+        }
+        specsChanged = false;
+        publish();
+        return(true);
+    }
+    // make an engine for each channel, keeping the ones there are so their
+    //  memory gets reused for the new wheels
+    while (engines.size() > specs.length()) delete engines.takeLast();
+    while (engines.size() < specs.length()) engines.append(new StrobeEngine());
+    labels.clear();
+    for (c = 0; c < specs.length(); c++) {
+        const QList<WheelSpec> &wheels = specs.at(c).wheels;
+        count = wheels.length();
+        float *frequencies = new float[count];
+        QStringList channelLabels;
+        for (i = 0; i < count; i++) {
+            frequencies[i] = wheels.at(i).frequency;
+            channelLabels.append(wheels.at(i).label);
+        }
+        StrobeEngine *engine = engines.at(c);
+        engine->setGating(specs.at(c).gated);
+        engine->setFolding(specs.at(c).foldOctaves);
+        engine->setResolution(resolution);
+        engine->setIntegration(integration, DEFAULT_INTEGRATION_CYCLES);
+        engine->setFiltering(filtering);
+        engine->setNoiseGate(noiseGate);
+        engine->setWindowFrames((int)(windowSeconds * sampleRate));
+        engine->initWheels(frequencies, count, sampleRate);
+        delete[] frequencies;
+        labels.append(channelLabels);
+    }
+    if (osc != NULL) planOsc();
+    oscChanged = false;
+    spans.resize(2 * engines.size());
+    finished.resize(engines.size());
+    // use a thread per channel, up to the number of cores
+    int threads = qMin(engines.size(), QThread::idealThreadCount());
+    if (threads != pool.getThreads()) pool.init(threads);
+    specsChanged = false;
+    plannedRate = sampleRate;
+    // show the new wheels right away
+    publish();
+    return(true);
+}
+
+bool Analyzer::canRetune()
+{
+    if (specs.length() != engines.size()) return(false);
+    for (int c = 0; c < specs.length(); c++) {
+        const ChannelSpec &spec = specs.at(c);
+        if (spec.gated != engines.at(c)->getGating()) return(false);
+        // folding changes the taps behind every wheel
+        if (((spec.foldOctaves > 1) ? spec.foldOctaves : 0) !=
+            engines.at(c)->getFolding()) return(false);
+        // a new resolution resizes every wheel, where folded wheels get a
+        //  fixed one even if none was asked for
+        if (engines.at(c)->getResolution() !=
+            StrobeEngine::wheelResolution(resolution, spec.foldOctaves)) {
+            return(false);
+        }
+        const QStringList &channelLabels = labels.at(c);
+        if (spec.wheels.length() != channelLabels.length()) return(false);
+        for (int i = 0; i < channelLabels.length(); i++) {
+            if (spec.wheels.at(i).label != channelLabels.at(i)) return(false);
+        }
+    }
+    return(true);
+}
+
+void Analyzer::processChannel(void *context, int index)
+{
+    Analyzer *analyzer = (Analyzer *)context;
+    StrobeEngine *engine = analyzer->engines.at(index);
+    const AudioSpan *span = analyzer->spans.constData() + (2 * index);
+    bool done = analyzer->process(engine, span[0].samples, span[0].count);
+    done |= analyzer->process(engine, span[1].samples, span[1].count);
+    analyzer->finished.data()[index] = done;
+}
+
+bool Analyzer::process(StrobeEngine *engine, const float *samples, int count)
+{
+    int n;
+    bool done = false;
+    while (count > 0) {
+        // fill up to the end of the current window
+        n = engine->fillWindow(samples, count);
+        samples += n;
+        count -= n;
+        // finish the window when it's full, keeping only the latest for
+        //  the display
+        if (engine->windowFull()) {
+            engine->autoselect = autoselect;
+            engine->finishWindow();
+            done = true;
+        }
+    }
+    return(done);
+}
+
+void Analyzer::publish()
+{
+    PROFILE_SCOPE(ProfilePublish);
+    WheelSnapshot *snapshot = snapshots.writeBuffer();
+    int groupCount = engines.size();
+    // the buffer only reallocates when the wheels get bigger or more numerous
+    snapshot->groups.resize(groupCount);
+    WheelGroup *group = snapshot->groups.data();
+    bool sending = (osc != NULL);
+    if (sending) osc->begin();
+    for (int c = 0; c < groupCount; c++) {
+        StrobeEngine *engine = engines.at(c);
+        const QStringList &channelLabels = labels.at(c);
+        int count = engine->getWheelCount();
+        group->name = specs.at(c).name;
+        group->wheels.resize(count);
+        Wheel *wheel = engine->getWheels();
+        WheelFrame *frame = group->wheels.data();
+        for (int i = 0; i < count; i++) {
+            frame->label = channelLabels.at(i);
+            frame->frequency = wheel->frequency;
+            frame->samples.resize(wheel->sampleCount);
+            memcpy(frame->samples.data(), wheel->sampleBuffer,
+                wheel->sampleCount * sizeof(*(wheel->sampleBuffer)));
+            frame->maxAmplitude = wheel->maxAmplitude;
+            frame->instability = wheel->instability;
+            frame->selected = wheel->selected;
+            frame->offsetHz = wheel->offsetHz;
+            frame->cents = wheel->cents;
+            frame->hasOffset = wheel->hasOffset;
+            frame->active = wheel->active;
+            // only send the wheels being run
+            if ((sending) && (wheel->active)) {
+                osc->addWheel(c, i, wheel->frequency, wheel->selected,
+                    wheel->instability, wheel->maxAmplitude,
+                    wheel->cents, wheel->hasOffset);
+            }
+            frame++;
+            wheel++;
+        }
+        group++;
+    }
+    snapshot->autoselect = autoselect;
+    snapshots.publish();
+    if (sending) osc->publish();
+    // wake the display, where writes it hasn't read yet just add up
+    if (publishedFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(publishedFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void Analyzer::clearPublished()
+{
+    uint64_t count;
+    if (publishedFd < 0) return;
+    ssize_t got = read(publishedFd, &count, sizeof(count));
+    (void)got;
+}
+
+void Analyzer::planOsc()
+{
+    QVector<int> counts;
+    QList<QByteArray> encoded;
+    for (int c = 0; c < labels.length(); c++) {
+        const QStringList &channelLabels = labels.at(c);
+        counts.append(channelLabels.length());
+        for (int i = 0; i < channelLabels.length(); i++) {
+            encoded.append(channelLabels.at(i).toUtf8());
+        }
+    }
+    QVector<const char *> pointers;
+    for (int i = 0; i < encoded.length(); i++) {
+        pointers.append(encoded.at(i).constData());
+    }
+    osc->plan(counts.size(), counts.constData(), pointers.constData());
+}
+
+Analyzer::~Analyzer()
+{
+    stop();
+    delete osc;
+    if (requested.osc != osc) delete requested.osc;
+    for (int c = 0; c < engines.size(); c++) delete engines.at(c);
+    sem_destroy(&wake);
+    if (publishedFd >= 0) close(publishedFd);
+}
@@ -0,0 +1,220 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <atomic>
+
+#include <semaphore.h>
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+
+#include "audioinput.h"
+#include "frequencymap.h"
+#include "oscpublisher.h"
+#include "strobeengine.h"
+#include "triplebuffer.h"
+#include "workerpool.h"
+
+// the displayable state of a wheel at the end of an analysis window
+typedef struct {
+    QString label;
+    float frequency;
+    // the normalized wheel segments
+    QVector<float> samples;
+    // statistics about the stability of the wheel contents
+    float maxAmplitude;
+    float instability;
+    bool selected;
+    // the estimated offset of the signal from the wheel's frequency
+    float offsetHz;
+    float cents;
+    bool hasOffset;
+    // whether the wheel is being run, which is false for wheels gated off
+    //  for being far from the detected pitch
+    bool active;
+} WheelFrame;
+
+// the wheels for one input channel
+typedef struct {
+    QString name;
+    QVector<WheelFrame> wheels;
+} WheelGroup;
+
+// a complete set of wheels published by the analyzer, grouped by channel
+typedef struct {
+    QVector<WheelGroup> groups;
+    // whether wheels were selected by detecting the fundamental
+    bool autoselect;
+} WheelSnapshot;
+
+// the wheels to analyze on one input channel
+typedef struct {
+    QString name;
+    QList<WheelSpec> wheels;
+    // whether to only run the wheels near the detected pitch
+    bool gated;
+    // the number of octaves to fold onto each wheel, or zero for none
+    int foldOctaves;
+} ChannelSpec;
+
+// settings changed by control calls, which the worker takes up at the
+//  start of its next pass
+typedef struct {
+    // the input and how much audio it buffers before waking the worker
+    AudioInput *input;
+    float blockSeconds;
+    bool inputChanged;
+    // the wheels on each channel and their fixed resolution
+    QList<ChannelSpec> specs;
+    int resolution;
+    bool specsChanged;
+    // how wheels combine analysis windows and how long a window is
+    IntegrationMode integration;
+    float windowSeconds;
+    bool integrationChanged;
+    bool filtering;
+    float noiseGate;
+    bool preprocessChanged;
+    OscPublisher *osc;
+    bool oscChanged;
+} AnalyzerRequest;
+
+// a worker thread that owns the wheels, continuously consumes audio from the
+//  input and publishes finished wheels for display; each channel has its own
+//  engine, and channels are analyzed in parallel on a pool of threads
+class Analyzer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit Analyzer(QObject *parent = 0);
+    ~Analyzer();
+    // set the input to consume audio from, or NULL to stop consuming; the
+    //  worker may keep using the previous input until its current pass is
+    //  done, so wait for it to be released before deleting it
+    void setInput(AudioInput *newInput);
+    // wait until the worker is no longer using an input that's been
+    //  replaced, which takes at most one pass
+    void waitForRelease(AudioInput *oldInput);
+    // set the wheels to analyze on each channel of the input, where
+    //  channels past the end of the input get no audio
+    void setChannels(const QList<ChannelSpec> &newSpecs);
+    // set a fixed number of bins per revolution for every wheel, or 0 to
+    //  size each wheel to its period at its sample rate
+    void setResolution(int bins);
+    // set whether to detect the fundamental frequency
+    void setAutoselect(bool value);
+    // set how wheels combine successive analysis windows
+    void setIntegration(IntegrationMode mode);
+    // set the length of an analysis window in seconds, which is how often
+    //  wheels are published to the display and as OSC
+    void setWindowSeconds(float seconds);
+    // set whether to band-limit the input to the range of each channel's
+    //  wheels and the level in dB below which to silence it, where
+    //  PRE_GATE_OFF turns the noise gate off
+    void setPreprocessing(bool filter, float gateDb);
+    // set how much audio the input buffers before waking the worker, which
+    //  bounds how long a finished window waits to be published
+    void setBlockSeconds(float seconds);
+    // stream the state of the wheels as OSC messages to a UDP port on a
+    //  host, or stop if the host is empty; returns false if the host can't
+    //  be found
+    bool setOsc(const QString &host, int port);
+    // stop the worker thread and wait for it to finish
+    void stop();
+    // get the most recently published wheels (call from one thread only)
+    const WheelSnapshot *latest() { return(snapshots.readBuffer()); }
+    // whether wheels have been published since they were last read
+    bool hasUpdate() { return(snapshots.hasUpdate()); }
+    // a descriptor that becomes readable when wheels are published, so the
+    //  display can wait for them instead of polling; call
+    //  clearPublished() once it's readable
+    int publishedDescriptor() { return(publishedFd); }
+    void clearPublished();
+
+protected:
+    // consume audio until stopped
+    void run();
+
+private:
+    // copy the settings changed by control calls, holding controlMutex,
+    //  and return a publisher that's been replaced for the caller to
+    //  delete once the lock is released
+    OscPublisher *takeRequests();
+    // rebuild the wheels if the plan or sample rate has changed,
+    //  returning whether they were rebuilt
+    bool applyPlan();
+    // whether the new plan has the same channels and wheels as the current
+    //  one, differing only in frequency
+    bool canRetune();
+    // process the buffered audio of a channel, called from the pool
+    static void processChannel(void *context, int index);
+    // process a block of audio for a channel, returning whether a window
+    //  was finished
+    bool process(StrobeEngine *engine, const float *samples, int count);
+    // publish the current state of the wheels
+    void publish();
+    // lay out OSC messages for the current wheels
+    void planOsc();
+    // wait until the input has a block of audio or the worker is poked
+    void waitForAudio();
+    // wake the worker to apply changes right away
+    void poke() { sem_post(&wake); }
+    // guards the requested settings, which are only held long enough to
+    //  copy so control calls never wait on analysis
+    QMutex controlMutex;
+    AnalyzerRequest requested;
+    // signalled when the worker takes up a new input
+    QWaitCondition inputTaken;
+    // the rest is only used by the worker
+    // the input to receive audio from
+    AudioInput *input;
+    // posted by the input when audio is ready and by control calls, and
+    //  the length of a block of audio in seconds
+    sem_t wake;
+    float blockSeconds;
+    // the wheels to analyze on each channel and whether they've changed
+    QList<ChannelSpec> specs;
+    bool specsChanged;
+    // the fixed number of bins per revolution or 0
+    int resolution;
+    // the sample rate the wheels were built for
+    float plannedRate;
+    // how wheels combine analysis windows, how long a window is, and
+    //  whether either has changed
+    IntegrationMode integration;
+    float windowSeconds;
+    bool integrationChanged;
+    // how to clean up the input and whether that's changed
+    bool filtering;
+    float noiseGate;
+    bool preprocessChanged;
+    // the analysis engine for each channel, the labels of its wheels, the
+    //  audio it has to process and whether it finished a window
+    QVector<StrobeEngine *> engines;
+    QList<QStringList> labels;
+    QVector<AudioSpan> spans;
+    QVector<char> finished;
+    // runs the engines in parallel
+    WorkerPool pool;
+    // whether to detect the fundamental frequency
+    std::atomic<bool> autoselect;
+    // whether the worker should exit
+    std::atomic<bool> stopping;
+    // finished wheels passed to the display
+    TripleBuffer<WheelSnapshot> snapshots;
+    // an eventfd written each time wheels are published
+    int publishedFd;
+    // sends finished wheels to other programs, or NULL if there's nowhere
+    //  to send them, and whether it's been replaced since its messages
+    //  were laid out
+    OscPublisher *osc;
+    bool oscChanged;
+};
+
+#endif // ANALYZER_H
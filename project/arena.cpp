@@ -0,0 +1,59 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <new>
+
+Arena::Arena()
+{
+    base = NULL;
+    capacity = 0;
+    used = 0;
+}
+
+bool Arena::reserve(size_t size)
+{
+    used = 0;
+    if (size <= capacity) return(false);
+    release();
+    // big arenas can be backed by huge pages, which saves TLB misses when
+    //  walking many wheels
+    size_t alignment = (size >= ARENA_HUGE_BYTES) ?
+        ARENA_HUGE_BYTES : ARENA_ALIGN;
+    size = (size + alignment - 1) & ~(alignment - 1);
+    void *block;
+    if (posix_memalign(&block, alignment, size) != 0) throw std::bad_alloc();
+    base = (char *)block;
+    capacity = size;
+#ifdef MADV_HUGEPAGE
+    if (alignment == ARENA_HUGE_BYTES) madvise(base, size, MADV_HUGEPAGE);
+#endif
+    return(true);
+}
+
+void Arena::swap(Arena &other)
+{
+    char *otherBase = other.base;
+    size_t otherCapacity = other.capacity;
+    size_t otherUsed = other.used;
+    other.base = base;
+    other.capacity = capacity;
+    other.used = used;
+    base = otherBase;
+    capacity = otherCapacity;
+    used = otherUsed;
+}
+
+void Arena::release()
+{
+    free(base);
+    base = NULL;
+    capacity = 0;
+    used = 0;
+}
+
+Arena::~Arena()
+{
+    release();
+}
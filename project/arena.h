@@ -0,0 +1,52 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// the alignment of every array in an arena, which is a cache line and
+//  enough for any SIMD load
+#define ARENA_ALIGN 64
+// arenas at least this big are aligned to and advised as huge pages
+#define ARENA_HUGE_BYTES (2 * 1024 * 1024)
+
+// a single block of memory that arrays are carved out of one after another,
+//  so arrays that are used together sit together and the whole set can be
+//  laid out again without touching the heap as long as it fits; the block
+//  isn't touched when it's allocated, so with the kernel's first-touch
+//  policy its pages land on the NUMA node of the thread that first clears
+//  the arrays
+class Arena
+{
+public:
+    Arena();
+    ~Arena();
+    // make sure the arena holds at least the given number of bytes,
+    //  replacing its memory if it doesn't, and start carving arrays from the
+    //  beginning again; returns whether it had to allocate
+    bool reserve(size_t size);
+    // carve an aligned array out of the arena, which must have been
+    //  reserved big enough for it
+    template <typename T> T *take(int count) {
+        T *array = (T *)(base + used);
+        used += bytes(count * sizeof(T));
+        return(array);
+    }
+    // the space an array of the given size in bytes takes up in an arena
+    static size_t bytes(size_t size) {
+        return((size + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1));
+    }
+    // exchange memory with another arena
+    void swap(Arena &other);
+    // release the arena's memory
+    void release();
+    // the number of bytes the arena holds
+    size_t getCapacity() { return(capacity); }
+
+private:
+    // the block of memory, its size and how much of it has been carved out
+    char *base;
+    size_t capacity;
+    size_t used;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,241 @@
+#include "audiofile.h"
+#include "capture.h"
+
+#include <string.h>
+
+#include <QtEndian>
+
+// WAV format tags
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+AudioFile::AudioFile()
+{
+    audio = NULL;
+    format = SampleFloat32;
+    sampleRate = 0;
+    channels = 1;
+    frameSize = 4;
+    frames = 0;
+    position = 0;
+    blocksEnd = NULL;
+    block = NULL;
+    blockPosition = 0;
+}
+
+bool AudioFile::open(const QString &path, int rawSampleRate)
+{
+    file.setFileName(path);
+    if (! file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return(false);
+    }
+    qint64 size = file.size();
+    const uchar *data = file.map(0, size);
+    if (data == NULL) {
+        error = "Failed to map the file into memory.";
+        return(false);
+    }
+    if ((size >= 12) && (memcmp(data, "RIFF", 4) == 0) &&
+        (memcmp(data + 8, "WAVE", 4) == 0)) {
+        return(parseWav(data, size));
+    }
+    if (((size_t)size >= sizeof(CaptureHeader)) &&
+        (memcmp(data, CAPTURE_MAGIC, 8) == 0)) {
+        return(parseCapture(data, size));
+    }
+    // anything else is taken to be raw 32-bit float mono
+    if (rawSampleRate <= 0) {
+        error = "A sample rate is required for raw audio.";
+        return(false);
+    }
+    audio = data;
+    format = SampleFloat32;
+    sampleRate = rawSampleRate;
+    channels = 1;
+    frameSize = 4;
+    frames = size / frameSize;
+    position = 0;
+    return(true);
+}
+
+bool AudioFile::parseWav(const uchar *data, qint64 size)
+{
+    const uchar *fmt = NULL;
+    const uchar *chunk = data + 12;
+    const uchar *end = data + size;
+    quint32 chunkSize;
+    // find the format and data chunks
+    while (chunk + 8 <= end) {
+        chunkSize = qFromLittleEndian<quint32>(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            fmt = chunk + 8;
+            if ((chunkSize < 16) || (fmt + 16 > end)) break;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (fmt == NULL) break;
+            // take the format from the chunk
+            quint16 tag = qFromLittleEndian<quint16>(fmt);
+            channels = qFromLittleEndian<quint16>(fmt + 2);
+            sampleRate = qFromLittleEndian<quint32>(fmt + 4);
+            int bits = qFromLittleEndian<quint16>(fmt + 14);
+            if ((tag == WAVE_FORMAT_EXTENSIBLE) && (fmt + 26 <= end)) {
+                // the real tag starts the subformat GUID
+                tag = qFromLittleEndian<quint16>(fmt + 24);
+            }
+            if ((tag == WAVE_FORMAT_PCM) && (bits == 16)) format = SampleInt16;
+            else if ((tag == WAVE_FORMAT_PCM) && (bits == 24)) format = SampleInt24;
+            else if ((tag == WAVE_FORMAT_PCM) && (bits == 32)) format = SampleInt32;
+            else if ((tag == WAVE_FORMAT_IEEE_FLOAT) && (bits == 32)) format = SampleFloat32;
+            else if ((tag == WAVE_FORMAT_IEEE_FLOAT) && (bits == 64)) format = SampleFloat64;
+            else {
+                error = QString("Unsupported WAV format %1 with %2 bits.")
+                    .arg(tag).arg(bits);
+                return(false);
+            }
+            if ((channels < 1) || (sampleRate < 1)) break;
+            frameSize = channels * (bits / 8);
+            audio = chunk + 8;
+            // allow for files whose data chunk runs short
+            if (audio + chunkSize > end) chunkSize = end - audio;
+            frames = chunkSize / frameSize;
+            position = 0;
+            return(true);
+        }
+        // chunks are padded to an even length
+        chunk += 8 + chunkSize + (chunkSize & 1);
+    }
+    error = "Failed to find audio in the WAV file.";
+    return(false);
+}
+
+bool AudioFile::parseCapture(const uchar *data, qint64 size)
+{
+    CaptureHeader header;
+    memcpy(&header, data, sizeof(header));
+    if ((header.channels < 1) || (header.sampleRate < 1)) {
+        error = "Failed to find audio in the recording.";
+        return(false);
+    }
+    format = SampleCapture;
+    channels = header.channels;
+    sampleRate = header.sampleRate;
+    frameSize = channels * sizeof(float);
+    // count the frames in whole blocks, since a recording that was cut
+    //  short won't have its header filled in
+    const uchar *end = data + size;
+    const uchar *next = data + sizeof(CaptureHeader);
+    CaptureBlock info;
+    qint64 blockSize;
+    frames = 0;
+    while (next + sizeof(CaptureBlock) <= end) {
+        memcpy(&info, next, sizeof(info));
+        blockSize = sizeof(CaptureBlock) + ((qint64)info.frames * frameSize);
+        if (next + blockSize > end) break;
+        frames += info.frames;
+        next += blockSize;
+    }
+    audio = data;
+    blocksEnd = next;
+    block = data + sizeof(CaptureHeader);
+    blockPosition = 0;
+    position = 0;
+    return(true);
+}
+
+int AudioFile::readCapture(float *out, int maxFrames)
+{
+    CaptureBlock info;
+    float scale = 1.0 / (float)channels;
+    float sum, value;
+    int count = 0;
+    while ((count < maxFrames) && (block < blocksEnd)) {
+        memcpy(&info, block, sizeof(info));
+        // the block holds all of one channel and then the next
+        const uchar *samples = block + sizeof(CaptureBlock);
+        qint64 n = info.frames - blockPosition;
+        if (n > maxFrames - count) n = maxFrames - count;
+        for (qint64 i = 0; i < n; i++) {
+            // mix all channels down to mono
+            sum = 0.0;
+            for (int c = 0; c < channels; c++) {
+                memcpy(&value, samples + ((((qint64)c * info.frames) +
+                    blockPosition + i) * sizeof(float)), sizeof(value));
+                sum += value;
+            }
+            *out = sum * scale;
+            out++;
+        }
+        count += n;
+        blockPosition += n;
+        if (blockPosition >= info.frames) {
+            block = samples + ((qint64)info.frames * frameSize);
+            blockPosition = 0;
+        }
+    }
+    position += count;
+    return(count);
+}
+
+int AudioFile::read(float *out, int maxFrames)
+{
+    if (format == SampleCapture) return(readCapture(out, maxFrames));
+    qint64 n = frames - position;
+    if (n > maxFrames) n = maxFrames;
+    if (n <= 0) return(0);
+    const uchar *frame = audio + (position * frameSize);
+    int bytes = frameSize / channels;
+    float scale = 1.0 / (float)channels;
+    float sum;
+    const uchar *sample;
+    for (qint64 i = 0; i < n; i++) {
+        // mix all channels down to mono
+        sum = 0.0;
+        sample = frame;
+        for (int c = 0; c < channels; c++) {
+            switch (format) {
+            case SampleInt16:
+                sum += (float)qFromLittleEndian<qint16>(sample) / 32768.0f;
+                break;
+            case SampleInt24:
+                sum += (float)((qint32)(((quint32)sample[0] << 8) |
+                    ((quint32)sample[1] << 16) | ((quint32)sample[2] << 24)) >> 8) /
+                    8388608.0f;
+                break;
+            case SampleInt32:
+                sum += (float)qFromLittleEndian<qint32>(sample) / 2147483648.0f;
+                break;
+            case SampleFloat32: {
+                quint32 bits = qFromLittleEndian<quint32>(sample);
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                sum += value;
+                break;
+            }
+            case SampleFloat64: {
+                quint64 bits = qFromLittleEndian<quint64>(sample);
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                sum += (float)value;
+                break;
+            }
+            case SampleCapture:
+                // recordings are read by readCapture
+                break;
+            }
+            sample += bytes;
+        }
+        *out = sum * scale;
+        out++;
+        frame += frameSize;
+    }
+    position += n;
+    return((int)n);
+}
+
+AudioFile::~AudioFile()
+{
+    // the mapping is released when the file closes
+    file.close();
+}
@@ -0,0 +1,64 @@
+#ifndef AUDIOFILE_H
+#define AUDIOFILE_H
+
+#include <QFile>
+#include <QString>
+
+// the sample formats an audio file can hold
+typedef enum {
+    SampleInt16,
+    SampleInt24,
+    SampleInt32,
+    SampleFloat32,
+    SampleFloat64,
+    // blocks of 32-bit float audio recorded with JackInput::startCapture
+    SampleCapture
+} SampleFormat;
+
+// reads a WAV file, a recording of JACK input or a headerless file of
+//  32-bit float samples as mono float audio, mapping the file into memory
+//  rather than copying it
+class AudioFile
+{
+public:
+    AudioFile();
+    ~AudioFile();
+    // open a file, treating it as raw float audio at rawSampleRate if it
+    //  doesn't have a WAV header; returns false and sets the error on failure
+    bool open(const QString &path, int rawSampleRate);
+    // read up to maxFrames frames as mono, returning the number read
+    int read(float *out, int maxFrames);
+    // properties of the open file
+    int getSampleRate() { return(sampleRate); }
+    int getChannels() { return(channels); }
+    qint64 getFrames() { return(frames); }
+    QString getError() { return(error); }
+
+private:
+    // parse the header of a WAV file
+    bool parseWav(const uchar *data, qint64 size);
+    // parse the header of a recording and count its frames
+    bool parseCapture(const uchar *data, qint64 size);
+    // read up to maxFrames frames of a recording as mono
+    int readCapture(float *out, int maxFrames);
+    // the file and the mapped data
+    QFile file;
+    const uchar *audio;
+    // the format of the audio
+    SampleFormat format;
+    int sampleRate;
+    int channels;
+    int frameSize;
+    // the number of frames and the read position
+    qint64 frames;
+    qint64 position;
+    // for a recording, where its blocks end, the block being read and the
+    //  position in it
+    const uchar *blocksEnd;
+    const uchar *block;
+    qint64 blockPosition;
+    // a description of the last error
+    QString error;
+};
+
+#endif // AUDIOFILE_H
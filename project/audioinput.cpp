@@ -0,0 +1,164 @@
+#include "audioinput.h"
+
+#include <math.h>
+
+AudioInput::AudioInput()
+{
+    channels = 0;
+    sampleRate = 0;
+    buffers = NULL;
+    capacity = 0;
+    overflow = DropNewest;
+    wakeup = NULL;
+    wakeFrames = 0;
+    pendingFrames = 0;
+    discarded = NULL;
+    mostDiscarded = 0;
+    listener = NULL;
+    listenerContext = NULL;
+    lost = false;
+}
+
+bool AudioInput::initBuffers(float bufferSeconds)
+{
+    int bufferSamples = (int)ceil(bufferSeconds * (float)sampleRate);
+    size_t bytes = bufferSamples * sizeof(jack_default_audio_sample_t);
+    buffers = new jack_ringbuffer_t *[channels];
+    discarded = new unsigned long[channels];
+    for (int c = 0; c < channels; c++) {
+        buffers[c] = NULL;
+        discarded[c] = 0;
+    }
+    for (int c = 0; c < channels; c++) {
+        buffers[c] = jack_ringbuffer_create(bytes);
+        if (buffers[c] == NULL) return(false);
+        jack_ringbuffer_reset(buffers[c]);
+    }
+    capacity = jack_ringbuffer_write_space(buffers[0]) /
+        sizeof(jack_default_audio_sample_t);
+    return(true);
+}
+
+void AudioInput::bufferBlock(const jack_default_audio_sample_t * const *audio,
+                             jack_nframes_t nframes)
+{
+    size_t frameSize = sizeof(jack_default_audio_sample_t);
+    size_t space, frames = 0, dropped = 0;
+    if (buffers == NULL) return;
+    for (int c = 0; c < channels; c++) {
+        if (buffers[c] == NULL) return;
+        // only write whole frames so the buffer never holds a partial frame
+        //  and readers can use it in place
+        space = jack_ringbuffer_write_space(buffers[c]) / frameSize;
+        frames = (space < nframes) ? space : nframes;
+        frames = jack_ringbuffer_write(buffers[c], (const char *)audio[c],
+                                       frames * frameSize) / frameSize;
+        // a frame is lost if any channel loses it, so count the most lost
+        //  from a channel rather than each channel's loss
+        if (nframes - frames > dropped) dropped = nframes - frames;
+        InputTelemetry::raise(telemetry.highWater, capacity - space + frames);
+    }
+    if (dropped > 0) {
+        telemetry.droppedFrames.fetch_add(dropped, std::memory_order_relaxed);
+    }
+    // wake the consumer once a block is ready; posting a semaphore doesn't
+    //  block or allocate, so it's safe in the realtime thread
+    pendingFrames += nframes;
+    if (pendingFrames >= wakeFrames.load(std::memory_order_relaxed)) {
+        sem_t *semaphore = wakeup.load(std::memory_order_acquire);
+        if (semaphore != NULL) sem_post(semaphore);
+        pendingFrames = 0;
+    }
+}
+
+void AudioInput::setListener(InputListener function, void *context)
+{
+    listenerContext.store(context, std::memory_order_relaxed);
+    listener.store(function, std::memory_order_release);
+}
+
+void AudioInput::notify(InputEvent event)
+{
+    if (event == InputLost) lost = true;
+    InputListener function = listener.load(std::memory_order_acquire);
+    if (function != NULL) {
+        function(listenerContext.load(std::memory_order_relaxed), event);
+    }
+}
+
+jack_nframes_t AudioInput::writeSpace()
+{
+    size_t frameSize = sizeof(jack_default_audio_sample_t);
+    size_t space, least = capacity;
+    if (buffers == NULL) return(0);
+    for (int c = 0; c < channels; c++) {
+        if (buffers[c] == NULL) return(0);
+        space = jack_ringbuffer_write_space(buffers[c]) / frameSize;
+        if (space < least) least = space;
+    }
+    return(least);
+}
+
+void AudioInput::setWakeup(sem_t *semaphore, jack_nframes_t frames)
+{
+    wakeFrames.store(frames, std::memory_order_relaxed);
+    wakeup.store(semaphore, std::memory_order_release);
+}
+
+jack_nframes_t AudioInput::readSpans(int channel, AudioSpan spans[2])
+{
+    PROFILE_SCOPE(ProfileJackRead);
+    size_t frameSize = sizeof(jack_default_audio_sample_t);
+    jack_ringbuffer_data_t vector[2];
+    jack_ringbuffer_t *buffer = buffers[channel];
+    jack_ringbuffer_get_read_vector(buffer, vector);
+    size_t frames = (vector[0].len + vector[1].len) / frameSize;
+    telemetry.readLatency.store(frames, std::memory_order_relaxed);
+    InputTelemetry::raise(telemetry.maxReadLatency, frames);
+    // keep only the newest half of the buffer if asked to, so the writer
+    //  always has room for the next few callbacks
+    if ((overflow == DropOldest) && (frames > capacity / 2)) {
+        size_t discard = frames - (capacity / 2);
+        advance(channel, discard);
+        // each channel discards the same frames, so only count the ones
+        //  past what any channel has discarded before
+        discarded[channel] += discard;
+        if (discarded[channel] > mostDiscarded) {
+            telemetry.droppedFrames.fetch_add(
+                discarded[channel] - mostDiscarded, std::memory_order_relaxed);
+            mostDiscarded = discarded[channel];
+        }
+        jack_ringbuffer_get_read_vector(buffer, vector);
+    }
+    for (int i = 0; i < 2; i++) {
+        spans[i].samples = (const jack_default_audio_sample_t *)vector[i].buf;
+        spans[i].count = vector[i].len / frameSize;
+    }
+    return(spans[0].count + spans[1].count);
+}
+
+void AudioInput::advance(int channel, jack_nframes_t frames)
+{
+    jack_ringbuffer_read_advance(buffers[channel],
+        frames * sizeof(jack_default_audio_sample_t));
+}
+
+jack_nframes_t AudioInput::read(int channel, jack_default_audio_sample_t *out,
+                                jack_nframes_t maxFrames)
+{
+    PROFILE_SCOPE(ProfileJackRead);
+    size_t frameSize = sizeof(jack_default_audio_sample_t);
+    size_t bytesRead = jack_ringbuffer_read(buffers[channel], (char *)out,
+                                            maxFrames * frameSize);
+    return(bytesRead / frameSize);
+}
+
+AudioInput::~AudioInput()
+{
+    if (buffers == NULL) return;
+    for (int c = 0; c < channels; c++) {
+        if (buffers[c] != NULL) jack_ringbuffer_free(buffers[c]);
+    }
+    delete[] buffers;
+    delete[] discarded;
+}
@@ -0,0 +1,135 @@
+#ifndef AUDIOINPUT_H
+#define AUDIOINPUT_H
+
+#include <atomic>
+#include <exception>
+
+#include <semaphore.h>
+
+#include <jack/jack.h>
+#include <jack/ringbuffer.h>
+
+#include "inputtelemetry.h"
+#include "profiler.h"
+
+// a contiguous region of buffered audio
+typedef struct {
+    const jack_default_audio_sample_t *samples;
+    jack_nframes_t count;
+} AudioSpan;
+
+// what to throw away when audio arrives faster than it's read
+typedef enum {
+    // keep the buffered audio and drop incoming audio that doesn't fit
+    DropNewest,
+    // discard the oldest buffered audio on read so there's always room
+    //  for incoming audio and the reader stays close to live
+    DropOldest
+} OverflowPolicy;
+
+// things an input reports from its own threads
+typedef enum {
+    // the source went away, so no more audio will arrive
+    InputLost,
+    // the sample rate of the source changed
+    InputRateChanged
+} InputEvent;
+
+// a function to call with an input's events, which runs on whatever thread
+//  the input noticed the event on, so it should only pass the event along
+typedef void (*InputListener)(void *context, InputEvent event);
+
+// a source of audio that buffers each channel in a lock-free ring, with
+//  subclasses writing blocks of audio from their own thread and one reader
+//  consuming them from another
+class AudioInput
+{
+protected:
+    // the number of input channels, which subclasses set before making
+    //  the buffers
+    int channels;
+    // the sample rate of the audio, which the source may change
+    std::atomic<jack_nframes_t> sampleRate;
+    // a buffer to store each channel's audio into and how many frames each
+    //  one holds
+    jack_ringbuffer_t **buffers;
+    jack_nframes_t capacity;
+    // what to drop when the buffer overflows
+    std::atomic<OverflowPolicy> overflow;
+    // a semaphore to post whenever a block of audio has been buffered, the
+    //  length of the block, and the frames buffered since the last post
+    std::atomic<sem_t *> wakeup;
+    std::atomic<jack_nframes_t> wakeFrames;
+    jack_nframes_t pendingFrames;
+    // the frames the reader has discarded from each channel and the most
+    //  discarded from any one, which is what counts as dropped, since the
+    //  channels hold the same frames
+    unsigned long *discarded;
+    unsigned long mostDiscarded;
+    // make a buffer of the given length in seconds for each channel once
+    //  the channels and sample rate are known, returning false on failure
+    bool initBuffers(float bufferSeconds);
+    // add a block of audio with the given data for each channel to the
+    //  buffers and wake the reader if a block is ready, which is safe in a
+    //  realtime thread
+    void bufferBlock(const jack_default_audio_sample_t * const *audio,
+                     jack_nframes_t nframes);
+    // get the number of frames every channel's buffer has room for
+    jack_nframes_t writeSpace();
+    // report an event to the listener, if there is one
+    void notify(InputEvent event);
+    // the function to report events to and its context, and whether the
+    //  source has been lost
+    std::atomic<InputListener> listener;
+    std::atomic<void *> listenerContext;
+    std::atomic<bool> lost;
+public:
+    // make an input with no channels or buffers
+    AudioInput();
+    // post to the given semaphore from the writing thread each time the
+    //  given number of frames has been buffered, or stop posting if it's NULL
+    void setWakeup(sem_t *semaphore, jack_nframes_t frames);
+    // get all of a channel's buffered audio as up to two regions of its ring
+    //  buffer without copying, returning the total number of frames; the
+    //  regions stay valid until the frames are released with advance, and
+    //  only one thread may read
+    jack_nframes_t readSpans(int channel, AudioSpan spans[2]);
+    // release frames at the start of a channel's buffered audio after
+    //  processing them
+    void advance(int channel, jack_nframes_t frames);
+    // copy up to maxFrames of a channel's buffered audio into a caller-owned
+    //  buffer, returning the number of frames copied
+    jack_nframes_t read(int channel, jack_default_audio_sample_t *out,
+                        jack_nframes_t maxFrames);
+    // call a function with events from the input, or stop if it's NULL
+    void setListener(InputListener function, void *context);
+    // whether the source has gone away, which can happen before there's a
+    //  listener to hear about it
+    bool isLost() { return(lost.load()); }
+    // get the number of channels
+    int getChannels() { return(channels); }
+    // get the current sample rate
+    jack_nframes_t getSampleRate() { return(sampleRate); }
+    // get the number of frames each channel's buffer can hold
+    jack_nframes_t getCapacity() { return(capacity); }
+    // set what to drop when the buffer overflows
+    void setOverflowPolicy(OverflowPolicy policy) { overflow = policy; }
+    // counters describing the health of the input, readable from any thread
+    InputTelemetry telemetry;
+    // free the buffers, which subclasses must stop writing to first
+    virtual ~AudioInput();
+};
+
+class AudioInputException : public std::exception {
+private:
+    const char *message;
+public:
+    AudioInputException(const char *inMessage) {
+        message = inMessage;
+    }
+    virtual const char* what() const throw() {
+        return(message);
+    }
+};
+
+#endif // AUDIOINPUT_H
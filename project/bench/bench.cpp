@@ -0,0 +1,660 @@
+// Measures how many samples per second the strobe engine sustains for
+//  synthetic signals at common sample rates and wheel counts, reporting the
+//  cost of each stage and the real-time factor of the whole pipeline, along
+//  with the heap allocations and cache misses of each wheel set and the
+//  cost of cleaning up each block of input.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include <atomic>
+#include <thread>
+
+#include "alloccounter.h"
+#include "oscpublisher.h"
+#include "strobeengine.h"
+#include "strobekernel.h"
+#include "workerpool.h"
+
+// the size of a block of input, as a JACK period would deliver it
+#define BLOCK_FRAMES 256
+// the default length of an analysis window in seconds
+#define WINDOW_SECONDS 0.05
+// how many channels and windows to check for allocations, and how many
+//  windows to run first so every wheel has filled its integration
+#define CHECK_CHANNELS 2
+#define CHECK_WINDOWS 100
+#define CHECK_WARMUP_WINDOWS 40
+// the local UDP port the check sends OSC to, which is the discard port
+#define CHECK_OSC_PORT 9
+
+// the kinds of test signal
+typedef enum {
+    SignalSine,
+    SignalHarmonic,
+    SignalNoise
+} SignalType;
+
+static const char *signalNames[] = { "sine", "harmonic", "noise" };
+
+// the wheel sets to test, as MIDI note ranges
+typedef struct {
+    const char *name;
+    int notes[108];
+    int count;
+    // whether to only run the wheels near the detected pitch
+    bool gated;
+} WheelSet;
+
+// a monotonic time in nanoseconds
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return((double)t.tv_sec * 1.0e9 + (double)t.tv_nsec);
+}
+
+// the equal-tempered frequency of a MIDI note
+static float noteFrequency(int note)
+{
+    return(440.0 * pow(2.0, (double)(note - 69) / 12.0));
+}
+
+// fill a buffer with a test signal
+static void makeSignal(SignalType type, float *out, int count, float sampleRate)
+{
+    // a slightly sharp A2, or the harmonics of a slightly flat E2
+    unsigned int seed = 12345;
+    double t;
+    for (int s = 0; s < count; s++) {
+        t = (double)s / sampleRate;
+        switch (type) {
+        case SignalSine:
+            out[s] = 0.8 * sin(2.0 * M_PI * 110.2 * t);
+            break;
+        case SignalHarmonic:
+            out[s] = 0.0;
+            for (int h = 1; h <= 8; h++) {
+                out[s] += (0.8 / h) * sin(2.0 * M_PI * 82.3 * h * t);
+            }
+            break;
+        case SignalNoise:
+            seed = (seed * 1103515245) + 12345;
+            out[s] = ((float)((seed >> 16) & 0x7FFF) / 16384.0) - 1.0;
+            break;
+        }
+    }
+}
+
+// times for each stage in nanoseconds
+typedef struct {
+    double accumulate;
+    double integrate;
+    double normalize;
+    double drift;
+    double stats;
+    double select;
+    double gate;
+} StageTimes;
+
+// run the engine over a signal and time each stage, returning the number
+//  of windows finished
+static int runEngine(StrobeEngine *engine, const float *input, int count,
+                     StageTimes *times)
+{
+    int windows = 0;
+    double start;
+    int offset = 0, n, used;
+    memset(times, 0, sizeof(*times));
+    while (offset < count) {
+        n = count - offset;
+        if (n > BLOCK_FRAMES) n = BLOCK_FRAMES;
+        while (n > 0) {
+            start = now();
+            used = engine->fillWindow(input + offset, n);
+            times->accumulate += now() - start;
+            offset += used;
+            n -= used;
+            if (engine->windowFull()) {
+                start = now();
+                engine->integrateWheels();
+                times->integrate += now() - start;
+                start = now();
+                engine->normalizeWheels();
+                times->normalize += now() - start;
+                start = now();
+                engine->estimateDrift();
+                times->drift += now() - start;
+                start = now();
+                engine->updateStats();
+                times->stats += now() - start;
+                start = now();
+                engine->selectWheels();
+                times->select += now() - start;
+                start = now();
+                engine->gateWheels();
+                times->gate += now() - start;
+                windows++;
+            }
+        }
+    }
+    return(windows);
+}
+
+// open a hardware counter for the calling thread, returning -1 if the
+//  kernel or CPU doesn't allow it
+static int openCounter(unsigned int type, unsigned long long config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return((int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+// read a counter, or -1 if it isn't open
+static long long readCounter(int fd)
+{
+    long long value;
+    if ((fd < 0) || (read(fd, &value, sizeof(value)) != sizeof(value))) {
+        return(-1);
+    }
+    return(value);
+}
+
+// the number of heap allocations made by the calling thread so far, or 0
+//  if allocations aren't being counted
+static unsigned long allocations()
+{
+#ifdef COUNT_ALLOCATIONS
+    return(threadAllocationCount());
+#else
+    return(0);
+#endif
+}
+
+// print a count per window, or n/a if it couldn't be measured
+static void printPerWindow(long long count, int windows)
+{
+    if (count < 0) printf(" %15s", "n/a");
+    else printf(" %15.0f", (double)count / (double)windows);
+}
+
+// measure how many heap allocations building and running each wheel set
+//  takes and how many cache misses each window costs
+static void runMemory(const WheelSet *sets, int setCount, double seconds,
+                      KernelType kernelType, int harmonics, int resolution,
+                      IntegrationMode integration, float windowSeconds)
+{
+    float rate = 48000.0;
+    int count = (int)(seconds * rate);
+    float *input = new float[count];
+    makeSignal(SignalHarmonic, input, count, rate);
+    float frequencies[108], largest[108];
+    for (int w = 0; w < 108; w++) largest[w] = noteFrequency(12 + w);
+    printf("\nmemory at %.0f Hz%s\n", rate,
+#ifdef COUNT_ALLOCATIONS
+        ""
+#else
+        " (allocations aren't counted without COUNT_ALLOCATIONS)"
+#endif
+        );
+    printf("%-18s %11s %13s %10s %15s %15s\n", "wheels", "init allocs",
+        "switch allocs", "run allocs", "L1D misses/win", "LLC misses/win");
+    int l1 = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    int llc = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    StageTimes times;
+    for (int set = 0; set < setCount; set++) {
+        for (int w = 0; w < sets[set].count; w++) {
+            frequencies[w] = noteFrequency(sets[set].notes[w]);
+        }
+        StrobeEngine engine;
+        engine.setKernel(kernelType);
+        engine.setHarmonics(harmonics);
+        engine.setResolution(resolution);
+        engine.setGating(sets[set].gated);
+        engine.setIntegration(integration, DEFAULT_INTEGRATION_CYCLES);
+        engine.setWindowFrames((int)(windowSeconds * rate));
+        // build the set from nothing
+        unsigned long start = allocations();
+        engine.initWheels(frequencies, sets[set].count, rate);
+        unsigned long initAllocs = allocations() - start;
+        // switch to it from the largest set, as when changing scales
+        engine.initWheels(largest, 108, rate);
+        start = allocations();
+        engine.initWheels(frequencies, sets[set].count, rate);
+        unsigned long switchAllocs = allocations() - start;
+        // warm up and then run
+        runEngine(&engine, input, count / 4, &times);
+        if (l1 >= 0) ioctl(l1, PERF_EVENT_IOC_RESET, 0);
+        if (llc >= 0) ioctl(llc, PERF_EVENT_IOC_RESET, 0);
+        if (l1 >= 0) ioctl(l1, PERF_EVENT_IOC_ENABLE, 0);
+        if (llc >= 0) ioctl(llc, PERF_EVENT_IOC_ENABLE, 0);
+        start = allocations();
+        int windows = runEngine(&engine, input, count, &times);
+        unsigned long runAllocs = allocations() - start;
+        if (l1 >= 0) ioctl(l1, PERF_EVENT_IOC_DISABLE, 0);
+        if (llc >= 0) ioctl(llc, PERF_EVENT_IOC_DISABLE, 0);
+        printf("%-18s %11lu %13lu %10lu", sets[set].name, initAllocs,
+            switchAllocs, runAllocs);
+        printPerWindow(readCounter(l1), windows);
+        printPerWindow(readCounter(llc), windows);
+        printf("\n");
+    }
+    if (l1 >= 0) close(l1);
+    if (llc >= 0) close(llc);
+    delete[] input;
+}
+
+// the state of a multichannel run, shared with the worker pool
+typedef struct {
+    StrobeEngine *engines;
+    const float *input;
+    int offset;
+    int count;
+} ChannelRun;
+
+// process a block of input for one channel, finishing full windows
+static void runChannel(void *context, int index)
+{
+    ChannelRun *run = (ChannelRun *)context;
+    StrobeEngine *engine = &run->engines[index];
+    // offset each channel's signal so the channels don't share a cache line
+    const float *samples = run->input + run->offset + (index * 7);
+    int n = run->count, used;
+    while (n > 0) {
+        used = engine->fillWindow(samples, n);
+        samples += used;
+        n -= used;
+        if (engine->windowFull()) engine->finishWindow();
+    }
+}
+
+// a multichannel run that counts the heap allocations made while
+//  processing, on whichever thread each channel runs
+typedef struct {
+    ChannelRun run;
+    std::atomic<unsigned long> allocations;
+} CheckRun;
+
+// process a block of input for one channel as the analyzer would,
+//  counting what it allocates
+static void checkChannel(void *context, int index)
+{
+    CheckRun *check = (CheckRun *)context;
+    unsigned long start = allocations();
+    runChannel(&check->run, index);
+    check->allocations += allocations() - start;
+}
+
+// send the active wheels of every channel as OSC, as the analyzer does
+//  each time a window is finished
+static void publishWheels(OscPublisher *osc, StrobeEngine *engines)
+{
+    osc->begin();
+    for (int c = 0; c < CHECK_CHANNELS; c++) {
+        Wheel *wheel = engines[c].getWheels();
+        for (int i = 0; i < engines[c].getWheelCount(); i++, wheel++) {
+            if (! wheel->active) continue;
+            osc->addWheel(c, i, wheel->frequency, wheel->selected,
+                wheel->instability, wheel->maxAmplitude,
+                wheel->cents, wheel->hasOffset);
+        }
+    }
+    osc->publish();
+}
+
+// run the analysis loop over a few channels of synthetic input for each
+//  kind of wheel set and integration, with the input cleaned up and each
+//  finished window sent as OSC as the analyzer does, and check that
+//  nothing is allocated once the wheels are built and warmed up; returns
+//  false if anything was
+static bool checkAllocations(const WheelSet *sets, int setCount,
+                             KernelType kernelType, int harmonics,
+                             int resolution, float windowSeconds)
+{
+    const char *integrationNames[] = { "window", "leaky", "sliding" };
+    float rate = 48000.0;
+    int windowFrames = (int)(windowSeconds * rate);
+    int warmup = CHECK_WARMUP_WINDOWS * windowFrames;
+    int count = CHECK_WINDOWS * windowFrames;
+    float *input = new float[warmup + count + (CHECK_CHANNELS * 7)];
+    makeSignal(SignalHarmonic, input, warmup + count + (CHECK_CHANNELS * 7),
+               rate);
+    float frequencies[108];
+    // label each wheel with its note number for the OSC messages
+    char names[108][8];
+    const char *labels[CHECK_CHANNELS * 108];
+    int wheelCounts[CHECK_CHANNELS];
+    bool passed = true;
+    printf("allocations over %d windows of %d channels after %d to warm up, "
+        "publishing %.0f times a second\n", CHECK_WINDOWS, CHECK_CHANNELS,
+        CHECK_WARMUP_WINDOWS, rate / windowFrames);
+#ifndef COUNT_ALLOCATIONS
+    printf("  can't check without COUNT_ALLOCATIONS\n");
+    delete[] input;
+    return(false);
+#endif
+    OscPublisher osc;
+    if (! osc.open("127.0.0.1", CHECK_OSC_PORT)) {
+        printf("  can't open a socket to send OSC on\n");
+        delete[] input;
+        return(false);
+    }
+    WorkerPool pool;
+    pool.init(CHECK_CHANNELS);
+    // the sets as they are plus every pitch folded into pitch classes
+    for (int set = 0; set <= setCount; set++) {
+        const WheelSet *wheelSet = (set < setCount) ? &sets[set] : &sets[2];
+        int wheelCount = (set < setCount) ? wheelSet->count : 12;
+        for (int w = 0; w < wheelCount; w++) {
+            frequencies[w] = noteFrequency(wheelSet->notes[w]);
+            snprintf(names[w], sizeof(names[w]), "%d", wheelSet->notes[w]);
+        }
+        for (int c = 0; c < CHECK_CHANNELS; c++) {
+            wheelCounts[c] = wheelCount;
+            for (int w = 0; w < wheelCount; w++) {
+                labels[(c * wheelCount) + w] = names[w];
+            }
+        }
+        for (int mode = 0; mode < 3; mode++) {
+            StrobeEngine engines[CHECK_CHANNELS];
+            for (int c = 0; c < CHECK_CHANNELS; c++) {
+                engines[c].setKernel(kernelType);
+                engines[c].setHarmonics(harmonics);
+                engines[c].setResolution(resolution);
+                engines[c].setGating((set < setCount) && (wheelSet->gated));
+                engines[c].setFolding((set < setCount) ? 0 : 6);
+                engines[c].setIntegration((IntegrationMode)mode,
+                                          DEFAULT_INTEGRATION_CYCLES);
+                engines[c].setNoiseGate(-60.0);
+                engines[c].setWindowFrames(windowFrames);
+                engines[c].initWheels(frequencies, wheelCount, rate);
+                engines[c].autoselect = true;
+            }
+            osc.plan(CHECK_CHANNELS, wheelCounts, labels);
+            CheckRun check;
+            check.run.engines = engines;
+            check.run.input = input;
+            check.allocations = 0;
+            for (check.run.offset = 0; check.run.offset < warmup + count;
+                 check.run.offset += BLOCK_FRAMES) {
+                // only count once everything has been warmed up
+                if (check.run.offset < warmup) check.allocations = 0;
+                check.run.count = warmup + count - check.run.offset;
+                if (check.run.count > BLOCK_FRAMES) {
+                    check.run.count = BLOCK_FRAMES;
+                }
+                pool.run(checkChannel, &check, CHECK_CHANNELS);
+                // every channel finishes its windows in the same blocks
+                if ((check.run.offset + check.run.count) / windowFrames >
+                    check.run.offset / windowFrames) {
+                    unsigned long start = allocations();
+                    publishWheels(&osc, engines);
+                    check.allocations += allocations() - start;
+                }
+            }
+            unsigned long made = check.allocations;
+            printf("  %-18s %-8s %s", (set < setCount) ?
+                wheelSet->name : "pitch classes (12)",
+                integrationNames[mode], (made == 0) ? "ok" : "FAILED");
+            if (made != 0) printf(" (%lu allocations)", made);
+            printf("\n");
+            if (made != 0) passed = false;
+        }
+    }
+    delete[] input;
+    return(passed);
+}
+
+// time the input cleanup on its own for each JACK-sized block, with the
+//  band of a guitar and the noise gate on, against the time the block
+//  lasts
+static void runPreprocess(double seconds)
+{
+    const float rates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+    printf("\n%-7s %14s %12s %14s\n", "rate", "ns/sample", "us/block",
+        "% of block");
+    for (int r = 0; r < 4; r++) {
+        float rate = rates[r];
+        int count = (int)(seconds * rate);
+        float *input = new float[count];
+        makeSignal(SignalNoise, input, count, rate);
+        Preprocessor pre;
+        pre.plan(rate, noteFrequency(40) * BAND_LOW_RATIO,
+                 noteFrequency(64) * DEFAULT_HARMONICS);
+        pre.setGate(-60.0);
+        int blocks = 0;
+        float checksum = 0.0;
+        double start = now();
+        for (int offset = 0; offset + BLOCK_FRAMES <= count;
+             offset += BLOCK_FRAMES) {
+            checksum += pre.process(input + offset, BLOCK_FRAMES)[0];
+            blocks++;
+        }
+        double elapsed = now() - start;
+        double perBlock = elapsed / (blocks > 0 ? blocks : 1);
+        printf("%7.0f %14.3f %12.3f %13.4f%%%s\n", rate,
+            perBlock / BLOCK_FRAMES, perBlock / 1.0e3,
+            100.0 * perBlock / (1.0e9 * BLOCK_FRAMES / rate),
+            (checksum != checksum) ? " (NaN)" : "");
+        delete[] input;
+    }
+}
+
+// time how long a number of channels take with each number of threads
+static void runScaling(int channels, const float *frequencies, int wheelCount,
+                       double seconds, KernelType kernelType, int harmonics,
+                       int resolution, IntegrationMode integration,
+                       float windowSeconds)
+{
+    float rate = 48000.0;
+    int count = (int)(seconds * rate);
+    float *input = new float[count + (channels * 7)];
+    makeSignal(SignalHarmonic, input, count + (channels * 7), rate);
+    int cores = (int)std::thread::hardware_concurrency();
+    if (cores < 1) cores = 1;
+    printf("\n%d channels of %d wheels at %.0f Hz on up to %d cores\n",
+        channels, wheelCount, rate, cores);
+    printf("%7s %9s %9s %10s\n", "threads", "realtime", "speedup", "efficiency");
+    double single = 0.0;
+    int threads = 1;
+    while (true) {
+        StrobeEngine *engines = new StrobeEngine[channels];
+        for (int c = 0; c < channels; c++) {
+            engines[c].setKernel(kernelType);
+            engines[c].setHarmonics(harmonics);
+            engines[c].setResolution(resolution);
+            engines[c].setIntegration(integration, DEFAULT_INTEGRATION_CYCLES);
+            engines[c].setWindowFrames((int)(windowSeconds * rate));
+            engines[c].initWheels(frequencies, wheelCount, rate);
+        }
+        WorkerPool pool;
+        pool.init((threads < channels) ? threads : channels);
+        ChannelRun run = { engines, input, 0, 0 };
+        double start = now();
+        for (run.offset = 0; run.offset < count; run.offset += BLOCK_FRAMES) {
+            run.count = count - run.offset;
+            if (run.count > BLOCK_FRAMES) run.count = BLOCK_FRAMES;
+            pool.run(runChannel, &run, channels);
+        }
+        double elapsed = now() - start;
+        if (threads == 1) single = elapsed;
+        printf("%7d %8.1fx %8.2fx %9.0f%%\n", threads,
+            (seconds * 1.0e9) / elapsed, single / elapsed,
+            100.0 * single / (elapsed * threads));
+        delete[] engines;
+        // double the threads up to the number of cores
+        if (threads >= cores) break;
+        threads = (threads * 2 < cores) ? threads * 2 : cores;
+    }
+    delete[] input;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: jackstrobe-bench [--seconds N] [--kernel scalar|sse2|avx2]\n"
+        "                        [--harmonics N] [--integration window|leaky|sliding]\n"
+        "                        [--bins N] [--channels N] [--window SECONDS]\n"
+        "                        [--check-allocations]\n"
+        "  Measures strobe engine throughput on synthetic signals.\n"
+        "  --harmonics sets how many harmonics decimated wheels keep,\n"
+        "  where 0 runs every wheel at the full sample rate.\n"
+        "  --integration sets how wheels combine analysis windows.\n"
+        "  --bins gives every wheel a fixed power-of-two number of bins,\n"
+        "  where 0 (the default) sizes each wheel to its period.\n"
+        "  --channels sets how many channels to run in parallel when\n"
+        "  measuring how throughput scales with threads (default 8).\n"
+        "  --window sets the length of an analysis window in seconds,\n"
+        "  which is how often wheels are published (default 0.05).\n"
+        "  --check-allocations only checks that analysis and publishing\n"
+        "  wheels as OSC don't allocate once they're warmed up, exiting\n"
+        "  with an error if they do.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = 2.0;
+    KernelType kernelType = bestKernelType();
+    int harmonics = DEFAULT_HARMONICS;
+    int resolution = 0;
+    IntegrationMode integration = IntegrateLeaky;
+    int channels = 8;
+    float windowSeconds = WINDOW_SECONDS;
+    bool checking = false;
+    const char *integrationNames[] = { "window", "leaky", "sliding" };
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--seconds") == 0) && (i + 1 < argc)) {
+            seconds = atof(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--channels") == 0) && (i + 1 < argc)) {
+            channels = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--window") == 0) && (i + 1 < argc)) {
+            windowSeconds = atof(argv[++i]);
+            if (! (windowSeconds > 0.0)) { usage(); return(1); }
+        }
+        else if (strcmp(argv[i], "--check-allocations") == 0) {
+            checking = true;
+        }
+        else if ((strcmp(argv[i], "--bins") == 0) && (i + 1 < argc)) {
+            resolution = StrobeEngine::roundResolution(atoi(argv[++i]));
+        }
+        else if ((strcmp(argv[i], "--harmonics") == 0) && (i + 1 < argc)) {
+            harmonics = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--integration") == 0) && (i + 1 < argc)) {
+            i++;
+            if (strcmp(argv[i], "window") == 0) integration = IntegrateWindow;
+            else if (strcmp(argv[i], "leaky") == 0) integration = IntegrateLeaky;
+            else if (strcmp(argv[i], "sliding") == 0) integration = IntegrateSliding;
+            else { usage(); return(1); }
+        }
+        else if ((strcmp(argv[i], "--kernel") == 0) && (i + 1 < argc)) {
+            i++;
+            if (strcmp(argv[i], "scalar") == 0) kernelType = KernelScalar;
+            else if (strcmp(argv[i], "sse2") == 0) kernelType = KernelSSE2;
+            else if (strcmp(argv[i], "avx2") == 0) kernelType = KernelAVX2;
+            else { usage(); return(1); }
+        }
+        else { usage(); return(1); }
+    }
+    if (kernelForType(kernelType) == NULL) {
+        fprintf(stderr, "The %s kernel isn't supported on this CPU.\n",
+            kernelTypeName(kernelType));
+        return(1);
+    }
+    // check the kernel before timing it
+    float deviation;
+    bool ok = checkKernel(kernelType, &deviation);
+    printf("kernel: %s, check %s (max deviation from reference %.4f)\n",
+        kernelTypeName(kernelType), ok ? "passed" : "FAILED", deviation);
+    if (harmonics > 0) printf("decimating to keep %d harmonics\n", harmonics);
+    else printf("not decimating\n");
+    if (resolution > 0) printf("fixed resolution: %d bins\n", resolution);
+    else printf("resolution: sized to each period\n");
+    printf("integration: %s\n\n", integrationNames[integration]);
+    // define wheel sets like the built-in scales, plus every pitch
+    WheelSet sets[4] = {
+        { "bass (4)", { 28, 33, 38, 43 }, 4, false },
+        { "chromatic 2 (11)", { 36, 37, 38, 39, 40, 41, 43, 44, 45, 46, 47 }, 11, false },
+        { "all pitches (108)", { 0 }, 108, false },
+        { "auto-range (108)", { 0 }, 108, true }
+    };
+    for (int i = 0; i < 108; i++) {
+        sets[2].notes[i] = 12 + i;
+        sets[3].notes[i] = 12 + i;
+    }
+    if (checking) {
+        return(checkAllocations(sets, 4, kernelType, harmonics, resolution,
+                                windowSeconds) ? 0 : 1);
+    }
+    const float rates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+    printf("%-9s %-18s %7s %14s %10s %10s %10s %12s %10s %10s %10s %9s\n",
+        "signal", "wheels", "rate", "ns/sample/whl", "accum ms", "integ ms", "norm ms",
+        "drift us/whl", "stats ms", "select ms", "gate ms", "realtime");
+    float frequencies[108];
+    StageTimes times;
+    for (int sig = 0; sig < 3; sig++) {
+        for (int set = 0; set < 4; set++) {
+            for (int r = 0; r < 4; r++) {
+                float rate = rates[r];
+                int count = (int)(seconds * rate);
+                float *input = new float[count];
+                makeSignal((SignalType)sig, input, count, rate);
+                for (int w = 0; w < sets[set].count; w++) {
+                    frequencies[w] = noteFrequency(sets[set].notes[w]);
+                }
+                StrobeEngine engine;
+                engine.setKernel(kernelType);
+                engine.setHarmonics(harmonics);
+                engine.setResolution(resolution);
+                engine.setGating(sets[set].gated);
+                engine.setIntegration(integration, DEFAULT_INTEGRATION_CYCLES);
+                engine.setWindowFrames((int)(windowSeconds * rate));
+                engine.initWheels(frequencies, sets[set].count, rate);
+                int windows = runEngine(&engine, input, count, &times);
+                double total = times.accumulate + times.integrate +
+                    times.normalize + times.drift + times.stats + times.select +
+                    times.gate;
+                printf("%-9s %-18s %7.0f %14.3f %10.2f %10.2f %10.2f %12.3f %10.2f %10.3f %10.2f %8.1fx\n",
+                    signalNames[sig], sets[set].name, rate,
+                    times.accumulate / ((double)count * sets[set].count),
+                    times.accumulate / 1.0e6, times.integrate / 1.0e6,
+                    times.normalize / 1.0e6,
+                    times.drift / (1.0e3 * windows * sets[set].count),
+                    times.stats / 1.0e6, times.select / 1.0e6,
+                    times.gate / 1.0e6, (seconds * 1.0e9) / total);
+                delete[] input;
+            }
+        }
+    }
+    runMemory(sets, 4, seconds, kernelType, harmonics, resolution,
+              integration, windowSeconds);
+    runPreprocess(seconds);
+    // measure how throughput scales across cores with a chromatic octave
+    //  of wheels on each channel, as for several instruments on a rig
+    if (channels > 0) {
+        for (int w = 0; w < sets[1].count; w++) {
+            frequencies[w] = noteFrequency(sets[1].notes[w]);
+        }
+        runScaling(channels, frequencies, sets[1].count, seconds, kernelType,
+                   harmonics, resolution, integration, windowSeconds);
+    }
+    return(0);
+}
@@ -0,0 +1,43 @@
+#-------------------------------------------------
+#
+# Throughput benchmarks for the strobe engine
+#
+#-------------------------------------------------
+
+CONFIG += c++11 console thread
+CONFIG -= qt app_bundle
+
+TARGET = jackstrobe-bench
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+# count heap allocations so the memory measurements can report them
+DEFINES += COUNT_ALLOCATIONS
+
+SOURCES += bench.cpp \
+    ../arena.cpp \
+    ../strobeengine.cpp \
+    ../strobekernel.cpp \
+    ../fft.cpp \
+    ../driftestimator.cpp \
+    ../pitchdetector.cpp \
+    ../octavebank.cpp \
+    ../preprocessor.cpp \
+    ../workerpool.cpp \
+    ../oscpublisher.cpp \
+    ../profiler.cpp \
+    ../alloccounter.cpp
+
+HEADERS += ../arena.h \
+    ../strobeengine.h \
+    ../strobekernel.h \
+    ../fft.h \
+    ../driftestimator.h \
+    ../pitchdetector.h \
+    ../octavebank.h \
+    ../preprocessor.h \
+    ../workerpool.h \
+    ../oscpublisher.h \
+    ../profiler.h \
+    ../alloccounter.h
@@ -0,0 +1,177 @@
+#include "capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <QDebug>
+
+Capture::Capture()
+{
+    queue = NULL;
+    sem_init(&ready, 0, 0);
+    stopping = false;
+    dropped = 0;
+    fd = -1;
+    map = NULL;
+    mapSize = 0;
+    used = 0;
+    channels = 0;
+    blocks = 0;
+    frames = 0;
+}
+
+bool Capture::open(const char *path, int channelCount, jack_nframes_t rate,
+                   float bufferSeconds)
+{
+    close();
+    channels = channelCount;
+    blocks = 0;
+    frames = 0;
+    dropped = 0;
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return(false);
+    used = 0;
+    if (! reserve(sizeof(CaptureHeader))) {
+        int error = errno;
+        close();
+        errno = error;
+        return(false);
+    }
+    CaptureHeader *header = (CaptureHeader *)map;
+    memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+    header->channels = channels;
+    header->sampleRate = rate;
+    header->blocks = 0;
+    header->frames = 0;
+    used = sizeof(CaptureHeader);
+    // leave room for the audio and plenty of block headers, and keep the
+    //  queue in memory since the realtime thread writes to it
+    size_t bytes = (size_t)(bufferSeconds * (float)rate) * channels *
+        sizeof(jack_default_audio_sample_t);
+    queue = jack_ringbuffer_create(bytes + (1024 * sizeof(CaptureBlock)));
+    if (queue == NULL) {
+        close();
+        errno = ENOMEM;
+        return(false);
+    }
+    jack_ringbuffer_mlock(queue);
+    stopping = false;
+    writer = std::thread(threadMain, this);
+    return(true);
+}
+
+void Capture::close()
+{
+    if (writer.joinable()) {
+        stopping = true;
+        sem_post(&ready);
+        writer.join();
+    }
+    if (map != NULL) {
+        CaptureHeader *header = (CaptureHeader *)map;
+        header->blocks = blocks;
+        header->frames = frames;
+        munmap(map, mapSize);
+        map = NULL;
+    }
+    if (fd >= 0) {
+        // trim the unused end of the last growth, which leaves a recording
+        //  that replays fine but is bigger than it needs to be if it fails
+        if (ftruncate(fd, used) != 0) {
+            qWarning() << "Failed to trim the recording to" << (qulonglong)used <<
+                "bytes:" << strerror(errno);
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    mapSize = 0;
+    used = 0;
+    if (queue != NULL) jack_ringbuffer_free(queue);
+    queue = NULL;
+}
+
+void Capture::write(const jack_default_audio_sample_t * const *audio,
+                    jack_nframes_t count, uint64_t frameTime, uint64_t usecs)
+{
+    if (queue == NULL) return;
+    size_t bytes = count * sizeof(jack_default_audio_sample_t);
+    // only queue whole blocks so the writer never sees part of one
+    if (jack_ringbuffer_write_space(queue) <
+        sizeof(CaptureBlock) + (bytes * channels)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    CaptureBlock block;
+    block.frameTime = frameTime;
+    block.usecs = usecs;
+    block.frames = count;
+    block.reserved = 0;
+    jack_ringbuffer_write(queue, (const char *)&block, sizeof(block));
+    for (int c = 0; c < channels; c++) {
+        jack_ringbuffer_write(queue, (const char *)audio[c], bytes);
+    }
+    sem_post(&ready);
+}
+
+void Capture::threadMain(Capture *capture)
+{
+    while (true) {
+        while (sem_wait(&capture->ready) != 0) { }
+        capture->drain();
+        if (capture->stopping) return;
+    }
+}
+
+bool Capture::drain()
+{
+    CaptureBlock block;
+    size_t size;
+    bool ok = true;
+    while (jack_ringbuffer_read_space(queue) >= sizeof(CaptureBlock)) {
+        jack_ringbuffer_peek(queue, (char *)&block, sizeof(block));
+        size = sizeof(CaptureBlock) +
+            (block.frames * channels * sizeof(jack_default_audio_sample_t));
+        // the rest of the block may still be on its way
+        if (jack_ringbuffer_read_space(queue) < size) break;
+        if (! reserve(size)) {
+            // if the disk is full, throw the block away to keep the queue
+            //  moving
+            jack_ringbuffer_read_advance(queue, size);
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            ok = false;
+            continue;
+        }
+        jack_ringbuffer_read(queue, map + used, size);
+        used += size;
+        blocks++;
+        frames += block.frames;
+    }
+    return(ok);
+}
+
+bool Capture::reserve(size_t bytes)
+{
+    if (used + bytes <= mapSize) return(true);
+    size_t newSize = mapSize + CAPTURE_GROW_BYTES;
+    if (newSize < used + bytes) newSize = used + bytes;
+    // allocate the space on disk now rather than extending the file
+    //  sparsely, since writing to a page of the map that the disk has no
+    //  room for raises SIGBUS instead of failing
+    if (posix_fallocate(fd, mapSize, newSize - mapSize) != 0) return(false);
+    void *newMap = (map == NULL) ?
+        mmap(NULL, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) :
+        mremap(map, mapSize, newSize, MREMAP_MAYMOVE);
+    if (newMap == MAP_FAILED) return(false);
+    map = (char *)newMap;
+    mapSize = newSize;
+    return(true);
+}
+
+Capture::~Capture()
+{
+    close();
+    sem_destroy(&ready);
+}
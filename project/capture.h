@@ -0,0 +1,90 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <atomic>
+#include <thread>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <semaphore.h>
+
+#include <jack/jack.h>
+#include <jack/ringbuffer.h>
+
+// the first bytes of a capture file
+#define CAPTURE_MAGIC "JSCAPT01"
+// how much to grow a capture file by when it fills up
+#define CAPTURE_GROW_BYTES (16 * 1024 * 1024)
+
+// the start of a capture file, which is followed by blocks of audio in the
+//  byte order of the machine that recorded them
+typedef struct {
+    char magic[8];
+    uint32_t channels;
+    uint32_t sampleRate;
+    // the number of blocks and frames in the file, which are filled in
+    //  when the capture is closed
+    uint64_t blocks;
+    uint64_t frames;
+} CaptureHeader;
+
+// the start of one block of captured audio, which is followed by the
+//  block's frames for each channel in turn
+typedef struct {
+    // the frame time of the block's first frame and the time it arrived
+    //  in microseconds, both on the JACK server's clock
+    uint64_t frameTime;
+    uint64_t usecs;
+    uint32_t frames;
+    uint32_t reserved;
+} CaptureBlock;
+
+// records blocks of multichannel audio to a memory-mapped file; blocks are
+//  queued from a realtime thread without blocking or allocating and written
+//  out on a thread of the capture's own, so a slow disk drops blocks
+//  rather than causing an xrun
+class Capture
+{
+public:
+    Capture();
+    ~Capture();
+    // start writing to a file, queueing up to bufferSeconds of audio while
+    //  the file catches up; returns false and sets errno on failure
+    bool open(const char *path, int channelCount, jack_nframes_t rate,
+              float bufferSeconds);
+    // write out what's queued and close the file
+    void close();
+    // queue a block with the given data for each channel (realtime safe)
+    void write(const jack_default_audio_sample_t * const *audio,
+               jack_nframes_t frames, uint64_t frameTime, uint64_t usecs);
+    // the number of blocks that didn't fit in the queue
+    unsigned long getDropped() { return(dropped.load()); }
+
+private:
+    // write queued blocks to the file until closed
+    static void threadMain(Capture *capture);
+    // write out every whole block in the queue, returning false if the
+    //  file can't be grown
+    bool drain();
+    // make sure the mapping has room for more bytes
+    bool reserve(size_t bytes);
+    // the queue of blocks, posted to when a block is added
+    jack_ringbuffer_t *queue;
+    sem_t ready;
+    // the thread writing blocks out and whether it should exit
+    std::thread writer;
+    std::atomic<bool> stopping;
+    // blocks that didn't fit in the queue
+    std::atomic<unsigned long> dropped;
+    // the file, its mapping, the size of both and how much has been written
+    int fd;
+    char *map;
+    size_t mapSize;
+    size_t used;
+    // the shape of the audio and what's been written
+    int channels;
+    uint64_t blocks;
+    uint64_t frames;
+};
+
+#endif // CAPTURE_H
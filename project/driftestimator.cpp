@@ -0,0 +1,173 @@
+#include "driftestimator.h"
+
+#include <math.h>
+#include <string.h>
+
+DriftEstimator::DriftEstimator()
+{
+    for (int i = 0; i <= DRIFT_MAX_LOG2; i++) {
+        ffts[i] = (i >= DRIFT_MIN_LOG2) ? new FFT(i) : NULL;
+    }
+    wheelCount = 0;
+    log2Sizes = NULL;
+    log2Capacities = NULL;
+    prevRe = NULL;
+    prevIm = NULL;
+    hasPrev = NULL;
+}
+
+void DriftEstimator::init(const int *binCounts, int count)
+{
+    // reuse the memory of the last set of wheels if it's big enough
+    wheelCount = count;
+    wheelArena.reserve(
+        (2 * Arena::bytes(count * sizeof(int))) +
+        (2 * Arena::bytes(count * sizeof(float *))) +
+        Arena::bytes(count * sizeof(bool)));
+    log2Sizes = wheelArena.take<int>(count);
+    log2Capacities = wheelArena.take<int>(count);
+    prevRe = wheelArena.take<float *>(count);
+    prevIm = wheelArena.take<float *>(count);
+    hasPrev = wheelArena.take<bool>(count);
+    for (int w = 0; w < count; w++) {
+        log2Sizes[w] = log2SizeFor(binCounts[w]);
+        log2Capacities[w] = log2Sizes[w];
+        hasPrev[w] = false;
+    }
+    layoutSpectra(false);
+}
+
+void DriftEstimator::layoutSpectra(bool keep)
+{
+    int w, size;
+    size_t total = 0;
+    for (w = 0; w < wheelCount; w++) {
+        total += 2 * Arena::bytes((1 << log2Capacities[w]) * sizeof(float));
+    }
+    // keeping the spectra means copying them out of the old arena
+    Arena moved;
+    Arena *arena = keep ? &moved : &spectrumArena;
+    arena->reserve(total);
+    float *re, *im;
+    for (w = 0; w < wheelCount; w++) {
+        re = arena->take<float>(1 << log2Capacities[w]);
+        im = arena->take<float>(1 << log2Capacities[w]);
+        if ((keep) && (hasPrev[w])) {
+            size = 1 << log2Sizes[w];
+            memcpy(re, prevRe[w], size * sizeof(float));
+            memcpy(im, prevIm[w], size * sizeof(float));
+        }
+        prevRe[w] = re;
+        prevIm[w] = im;
+    }
+    if (keep) spectrumArena.swap(moved);
+}
+
+int DriftEstimator::log2SizeFor(int binCount)
+{
+    // use the largest power of two that doesn't exceed the bin count
+    int log2Size = DRIFT_MIN_LOG2;
+    while ((log2Size < DRIFT_MAX_LOG2) &&
+           ((1 << (log2Size + 1)) <= binCount)) {
+        log2Size++;
+    }
+    return(log2Size);
+}
+
+void DriftEstimator::retune(int w, int binCount)
+{
+    int log2Size = log2SizeFor(binCount);
+    // the previous spectrum covers a whole revolution no matter how many
+    //  bins it came from, so it only goes stale if the size changes
+    if (log2Size == log2Sizes[w]) return;
+    log2Sizes[w] = log2Size;
+    hasPrev[w] = false;
+    if (log2Size > log2Capacities[w]) {
+        log2Capacities[w] = log2Size;
+        layoutSpectra(true);
+    }
+}
+
+void DriftEstimator::forget(int w)
+{
+    hasPrev[w] = false;
+}
+
+bool DriftEstimator::estimate(int w, const float *bins, int binCount,
+                              float *revolutions, bool fundamental)
+{
+    FFT *fft = ffts[log2Sizes[w]];
+    int size = fft->getSize();
+    int i, j, peak;
+    float pos, frac, cre, cim;
+    // resample the wheel to the transform size
+    float scale = (float)binCount / (float)size;
+    for (i = 0; i < size; i++) {
+        pos = (float)i * scale;
+        j = (int)pos;
+        frac = pos - (float)j;
+        re[i] = bins[j] + (frac * (bins[(j + 1) % binCount] - bins[j]));
+        im[i] = 0.0;
+    }
+    fft->transform(re, im, false);
+    // multiply by the conjugate of the last window's spectrum to get the
+    //  cross-power spectrum, keeping this window's spectrum for next time
+    float *pre = prevRe[w];
+    float *pim = prevIm[w];
+    for (i = 0; i < size; i++) {
+        cre = re[i];
+        cim = im[i];
+        re[i] = (cre * pre[i]) + (cim * pim[i]);
+        im[i] = (cim * pre[i]) - (cre * pim[i]);
+        pre[i] = cre;
+        pim[i] = cim;
+    }
+    bool hadPrev = hasPrev[w];
+    hasPrev[w] = true;
+    if (! hadPrev) return(false);
+    // a shift of the pattern turns the phase of its first harmonic
+    //  backward by the same fraction of a revolution
+    if (fundamental) {
+        if ((re[1] == 0.0f) && (im[1] == 0.0f)) return(false);
+        *revolutions = - atan2f(im[1], re[1]) / (2.0f * (float)M_PI);
+        return(true);
+    }
+    // the inverse gives the circular cross-correlation, which peaks at the
+    //  offset of the current window relative to the last one
+    fft->transform(re, im, true);
+    peak = 0;
+    for (i = 1; i < size; i++) {
+        if (re[i] > re[peak]) peak = i;
+    }
+    // interpolate between bins by fitting a parabola through the peak
+    float before = re[(peak + size - 1) % size];
+    float after = re[(peak + 1) % size];
+    float denominator = before - (2.0f * re[peak]) + after;
+    float offset = (float)peak;
+    if (denominator < 0.0f) offset += 0.5f * (before - after) / denominator;
+    // express the offset as a fraction of a revolution either way
+    offset /= (float)size;
+    if (offset >= 0.5f) offset -= 1.0f;
+    *revolutions = offset;
+    return(true);
+}
+
+void DriftEstimator::destroy()
+{
+    wheelArena.release();
+    spectrumArena.release();
+    log2Sizes = NULL;
+    log2Capacities = NULL;
+    prevRe = NULL;
+    prevIm = NULL;
+    hasPrev = NULL;
+    wheelCount = 0;
+}
+
+DriftEstimator::~DriftEstimator()
+{
+    destroy();
+    for (int i = 0; i <= DRIFT_MAX_LOG2; i++) {
+        delete ffts[i];
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef DRIFTESTIMATOR_H
+#define DRIFTESTIMATOR_H
+
+#include "arena.h"
+#include "fft.h"
+
+// the range of transform sizes used to compare wheels, as powers of two
+#define DRIFT_MIN_LOG2 4
+#define DRIFT_MAX_LOG2 8
+
+// estimates how far each wheel's pattern has rotated since the previous
+//  window by cross-correlating the two with FFTs; each wheel is resampled to
+//  a power-of-two size no larger than its bin count, and only the spectrum
+//  of the previous window is kept, so each estimate costs one forward and
+//  one inverse transform
+class DriftEstimator
+{
+public:
+    DriftEstimator();
+    ~DriftEstimator();
+    // set up state for wheels with the given bin counts, reusing the memory
+    //  of the last set if it's big enough
+    void init(const int *binCounts, int count);
+    // release all state
+    void destroy();
+    // change the bin count of wheel w, which keeps its previous window
+    //  unless that needs a different transform size
+    void retune(int w, int binCount);
+    // forget the previous window of a wheel, e.g. when it goes silent
+    void forget(int w);
+    // estimate the rotation of wheel w in revolutions since the last call,
+    //  where a pattern moving toward higher bins is positive; returns false
+    //  if there was no previous window to compare with; if fundamental is
+    //  set, only the phase of the pattern's first harmonic is compared,
+    //  which ignores parts of the pattern repeating more than once per
+    //  revolution
+    bool estimate(int w, const float *bins, int binCount, float *revolutions,
+                  bool fundamental = false);
+
+private:
+    // the transform size to use for a wheel with the given bin count
+    static int log2SizeFor(int binCount);
+    // carve each wheel's spectrum out of the arena for its capacity,
+    //  keeping the spectra if keep is set
+    void layoutSpectra(bool keep);
+    // transforms for each size
+    FFT *ffts[DRIFT_MAX_LOG2 + 1];
+    // the number of wheels, their transform sizes and the largest size
+    //  their buffers can hold
+    int wheelCount;
+    int *log2Sizes;
+    int *log2Capacities;
+    // the spectrum of each wheel's previous window and whether it's valid
+    float **prevRe;
+    float **prevIm;
+    bool *hasPrev;
+    // memory for the arrays above and for the spectra
+    Arena wheelArena;
+    Arena spectrumArena;
+    // working space for the current window
+    float re[1 << DRIFT_MAX_LOG2];
+    float im[1 << DRIFT_MAX_LOG2];
+};
+
+#endif // DRIFTESTIMATOR_H
@@ -0,0 +1,61 @@
+#include "fft.h"
+
+#include <math.h>
+
+FFT::FFT(int log2Size)
+{
+    size = 1 << log2Size;
+    cosines = new float[size / 2];
+    sines = new float[size / 2];
+    reversed = new int[size];
+    for (int i = 0; i < size / 2; i++) {
+        cosines[i] = cos(2.0 * M_PI * (double)i / (double)size);
+        sines[i] = sin(2.0 * M_PI * (double)i / (double)size);
+    }
+    for (int i = 0; i < size; i++) {
+        int r = 0;
+        for (int b = 0; b < log2Size; b++) {
+            if (i & (1 << b)) r |= 1 << (log2Size - 1 - b);
+        }
+        reversed[i] = r;
+    }
+}
+
+void FFT::transform(float *re, float *im, bool inverse)
+{
+    int i, j, k, half, step;
+    float t, tre, tim, wre, wim;
+    // put the input in bit-reversed order
+    for (i = 0; i < size; i++) {
+        j = reversed[i];
+        if (j > i) {
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    // combine butterflies of increasing size
+    float sign = inverse ? 1.0 : -1.0;
+    for (half = 1; half < size; half *= 2) {
+        step = size / (half * 2);
+        for (k = 0; k < half; k++) {
+            wre = cosines[k * step];
+            wim = sign * sines[k * step];
+            for (i = k; i < size; i += half * 2) {
+                j = i + half;
+                tre = (wre * re[j]) - (wim * im[j]);
+                tim = (wre * im[j]) + (wim * re[j]);
+                re[j] = re[i] - tre;
+                im[j] = im[i] - tim;
+                re[i] += tre;
+                im[i] += tim;
+            }
+        }
+    }
+}
+
+FFT::~FFT()
+{
+    delete[] cosines;
+    delete[] sines;
+    delete[] reversed;
+}
@@ -0,0 +1,27 @@
+#ifndef FFT_H
+#define FFT_H
+
+// an in-place radix-2 complex FFT of a fixed power-of-two size, with its
+//  twiddle factors and bit reversal table computed once up front
+class FFT
+{
+public:
+    // make a transform of size 2^log2Size
+    FFT(int log2Size);
+    ~FFT();
+    // transform split real and imaginary arrays in place; the inverse
+    //  transform is not scaled by 1/size
+    void transform(float *re, float *im, bool inverse);
+    // get the size of the transform
+    int getSize() { return(size); }
+
+private:
+    int size;
+    // cosines and sines for the first half of a turn
+    float *cosines;
+    float *sines;
+    // the bit-reversed index of each position
+    int *reversed;
+};
+
+#endif // FFT_H
@@ -1,49 +1,88 @@
 #include "frequencymap.h"
+#include "tuninglibrary.h"
+
+#include <QRegularExpression>
 
 #include "math.h"
 
+// the key that plays the first degree of a Scala scale with no keyboard
+//  mapping, which is middle C as in Scala itself
+#define SCALA_MIDDLE_NOTE 60
+
+// a built-in temperament, which is worked out from its type and parameter
+//  rather than from a list of degrees or a keyboard mapping
+static Temperament builtInTemperament(const QString &name,
+                                      TemperamentType type, float param)
+{
+    Temperament t;
+    t.name = name;
+    t.type = type;
+    t.param = param;
+    t.mapped = false;
+    t.firstNote = 0;
+    t.lastNote = 127;
+    t.middleNote = SCALA_MIDDLE_NOTE;
+    t.mapPeriod = 0;
+    return(t);
+}
+
+// a built-in scale, which runs all of its wheels without folding unless
+//  it says otherwise
+static Scale builtInScale(const QString &name, const QList<QString> &pitches,
+                          bool autoRange = false, int foldOctaves = 0)
+{
+    Scale s;
+    s.name = name;
+    s.pitches = pitches;
+    s.autoRange = autoRange;
+    s.foldOctaves = foldOctaves;
+    return(s);
+}
+
 FrequencyMap::FrequencyMap()
 {
     // temperaments
-    temperaments.append({"12-edo (standard)", EqualTemperament, 12.0 });
-    temperaments.append({"Syntonic (5-TET)", SyntonicTemperament, pow(2.0, 3.0 / 5.0) });
-    temperaments.append({"Syntonic (22-TET)", SyntonicTemperament, pow(2.0, 13.0 / 22.0) });
-    temperaments.append({"Syntonic (17-TET)", SyntonicTemperament, pow(2.0, 10.0 / 17.0) });
-    temperaments.append({"Syntonic (Pythagorean)", SyntonicTemperament, 1.5 });
-    temperaments.append({"Syntonic (12-TET)", SyntonicTemperament, pow(2.0, 7.0 / 12.0) });
-    temperaments.append({"Syntonic (43-TET, 1/5 Comma)", SyntonicTemperament, pow(2.0, 25.0 / 43.0) });
-    temperaments.append({"Syntonic (31-TET, 1/4 Comma)", SyntonicTemperament, pow(2.0, 18.0 / 31.0) });
-    temperaments.append({"Syntonic (50-TET, 2/7 Comma)", SyntonicTemperament, pow(2.0, 29.0 / 50.0) });
-    temperaments.append({"Syntonic (19-TET, 1/3 Comma)", SyntonicTemperament, pow(2.0, 11.0 / 19.0) });
-    temperaments.append({"Syntonic (26-TET)", SyntonicTemperament, pow(2.0, 15.0 / 26.0) });
-    temperaments.append({"Syntonic (7-TET)", SyntonicTemperament, pow(2.0, 4.0 / 7.0) });
-    temperaments.append({"Just 5-limit (Symmetric 1 Aug 4th)", JustTemperament, 0 });
-    temperaments.append({"Just 5-limit (Symmetric 1 Dim 5th)", JustTemperament, 1 });
-    temperaments.append({"Just 5-limit (Symmetric 2 Aug 4th)", JustTemperament, 2 });
-    temperaments.append({"Just 5-limit (Symmetric 2 Dim 5th)", JustTemperament, 3 });
-    temperaments.append({"Just 5-limit (Asymmetric Standard Aug 4th)", JustTemperament, 4 });
-    temperaments.append({"Just 5-limit (Asymmetric Standard Dim 5th)", JustTemperament, 5 });
-    temperaments.append({"Just 5-limit (Asymmetric Extended Aug 4th)", JustTemperament, 6 });
-    temperaments.append({"Just 5-limit (Asymmetric Extended Dim 5th)", JustTemperament, 7 });
-    temperaments.append({"Just 7-limit (Aug 4th)", JustTemperament, 8 });
-    temperaments.append({"Just 7-limit (Dim 5th)", JustTemperament, 9 });
-    temperaments.append({"Just 17-limit (Aug 4th)", JustTemperament, 10 });
-    temperaments.append({"Just 17-limit (Dim 5th)", JustTemperament, 11 });
+    temperaments.append(builtInTemperament("12-edo (standard)", EqualTemperament, 12.0));
+    temperaments.append(builtInTemperament("Syntonic (5-TET)", SyntonicTemperament, pow(2.0, 3.0 / 5.0)));
+    temperaments.append(builtInTemperament("Syntonic (22-TET)", SyntonicTemperament, pow(2.0, 13.0 / 22.0)));
+    temperaments.append(builtInTemperament("Syntonic (17-TET)", SyntonicTemperament, pow(2.0, 10.0 / 17.0)));
+    temperaments.append(builtInTemperament("Syntonic (Pythagorean)", SyntonicTemperament, 1.5));
+    temperaments.append(builtInTemperament("Syntonic (12-TET)", SyntonicTemperament, pow(2.0, 7.0 / 12.0)));
+    temperaments.append(builtInTemperament("Syntonic (43-TET, 1/5 Comma)", SyntonicTemperament, pow(2.0, 25.0 / 43.0)));
+    temperaments.append(builtInTemperament("Syntonic (31-TET, 1/4 Comma)", SyntonicTemperament, pow(2.0, 18.0 / 31.0)));
+    temperaments.append(builtInTemperament("Syntonic (50-TET, 2/7 Comma)", SyntonicTemperament, pow(2.0, 29.0 / 50.0)));
+    temperaments.append(builtInTemperament("Syntonic (19-TET, 1/3 Comma)", SyntonicTemperament, pow(2.0, 11.0 / 19.0)));
+    temperaments.append(builtInTemperament("Syntonic (26-TET)", SyntonicTemperament, pow(2.0, 15.0 / 26.0)));
+    temperaments.append(builtInTemperament("Syntonic (7-TET)", SyntonicTemperament, pow(2.0, 4.0 / 7.0)));
+    temperaments.append(builtInTemperament("Just 5-limit (Symmetric 1 Aug 4th)", JustTemperament, 0));
+    temperaments.append(builtInTemperament("Just 5-limit (Symmetric 1 Dim 5th)", JustTemperament, 1));
+    temperaments.append(builtInTemperament("Just 5-limit (Symmetric 2 Aug 4th)", JustTemperament, 2));
+    temperaments.append(builtInTemperament("Just 5-limit (Symmetric 2 Dim 5th)", JustTemperament, 3));
+    temperaments.append(builtInTemperament("Just 5-limit (Asymmetric Standard Aug 4th)", JustTemperament, 4));
+    temperaments.append(builtInTemperament("Just 5-limit (Asymmetric Standard Dim 5th)", JustTemperament, 5));
+    temperaments.append(builtInTemperament("Just 5-limit (Asymmetric Extended Aug 4th)", JustTemperament, 6));
+    temperaments.append(builtInTemperament("Just 5-limit (Asymmetric Extended Dim 5th)", JustTemperament, 7));
+    temperaments.append(builtInTemperament("Just 7-limit (Aug 4th)", JustTemperament, 8));
+    temperaments.append(builtInTemperament("Just 7-limit (Dim 5th)", JustTemperament, 9));
+    temperaments.append(builtInTemperament("Just 17-limit (Aug 4th)", JustTemperament, 10));
+    temperaments.append(builtInTemperament("Just 17-limit (Dim 5th)", JustTemperament, 11));
 
     // scales
-    scales.append({"Banjo (standard)", {"G4","D3","G3","B3","D4"}});
-    scales.append({"Bass Guitar (standard)", {"E1","A1","D2","G2"}});
-    scales.append({"Cello (standard)", {"C2","G2","D3","A3"}});
-    scales.append({"Guitar (standard)", {"E2","A2","D3","G3","B3","E4"}});
-    scales.append({"Mandolin", {"G3","D4","A4","E5"}});
-    scales.append({"Ukelele (Concert)", {"G4","C4","E4","A4"}});
-    scales.append({"Violin", {"G3","D4","A4","E5"}});
-    scales.append({"Chromatic 1", {"C1","C#1","D1","D#1","E1","F1","G1","G#1","A1","A#1","B1"}});
-    scales.append({"Chromatic 2", {"C2","C#2","D2","D#2","E2","F2","G2","G#2","A2","A#2","B2"}});
-    scales.append({"Chromatic 3", {"C3","C#3","D3","D#3","E3","F3","G3","G#3","A3","A#3","B3"}});
-    scales.append({"Chromatic 4", {"C4","C#4","D4","D#4","E4","F4","G4","G#4","A4","A#4","B4"}});
-    scales.append({"Chromatic 5", {"C5","C#5","D5","D#5","E5","F5","G5","G#5","A5","A#5","B5"}});
-    scales.append({"Chromatic 6", {"C6","C#6","D6","D#6","E6","F6","G6","G#6","A6","A#6","B6"}});
+    scales.append(builtInScale("Banjo (standard)", {"G4","D3","G3","B3","D4"}));
+    scales.append(builtInScale("Bass Guitar (standard)", {"E1","A1","D2","G2"}));
+    scales.append(builtInScale("Cello (standard)", {"C2","G2","D3","A3"}));
+    scales.append(builtInScale("Guitar (standard)", {"E2","A2","D3","G3","B3","E4"}));
+    scales.append(builtInScale("Mandolin", {"G3","D4","A4","E5"}));
+    scales.append(builtInScale("Ukelele (Concert)", {"G4","C4","E4","A4"}));
+    scales.append(builtInScale("Violin", {"G3","D4","A4","E5"}));
+    scales.append(builtInScale("Chromatic 1", {"C1","C#1","D1","D#1","E1","F1","G1","G#1","A1","A#1","B1"}));
+    scales.append(builtInScale("Chromatic 2", {"C2","C#2","D2","D#2","E2","F2","G2","G#2","A2","A#2","B2"}));
+    scales.append(builtInScale("Chromatic 3", {"C3","C#3","D3","D#3","E3","F3","G3","G#3","A3","A#3","B3"}));
+    scales.append(builtInScale("Chromatic 4", {"C4","C#4","D4","D#4","E4","F4","G4","G#4","A4","A#4","B4"}));
+    scales.append(builtInScale("Chromatic 5", {"C5","C#5","D5","D#5","E5","F5","G5","G#5","A5","A#5","B5"}));
+    scales.append(builtInScale("Chromatic 6", {"C6","C#6","D6","D#6","E6","F6","G6","G#6","A6","A#6","B6"}));
+    // one wheel per pitch class, folding C1 through B6 onto each
+    scales.append(builtInScale("Pitch Classes (C1-B6)", {"C1","C#1","D1","D#1","E1","F1","F#1","G1","G#1","A1","A#1","B1"}, false, 6));
 
     // pitch names
     QList<QString> octaves({"0", "1", "2", "3", "4", "5", "6", "7", "8"});
@@ -68,6 +107,19 @@ FrequencyMap::FrequencyMap()
             num++;
         }
     }
+    // a scale of every pitch, gated by a coarse pitch estimate
+    Scale autoRange = builtInScale("Auto-range (C0-B8)", QList<QString>(), true);
+    for (int oct = 0; oct < octaves.length(); oct++) {
+        for (int i = 0; i < sharps.length(); i++) {
+            autoRange.pitches.append(sharps.at(i) + octaves.at(oct));
+        }
+    }
+    scales.append(autoRange);
+
+    // load temperaments and scales from files, which go after the
+    //  built-in ones
+    library = new TuningLibrary;
+    library->open(TuningLibrary::defaultDirectory(), pitches);
 
     // set defaults to 12-edo at A4 = 440.0 Hz
     temperamentIndex = 0;
@@ -78,10 +130,90 @@ FrequencyMap::FrequencyMap()
     updateFrequencies();
 }
 
+FrequencyMap::~FrequencyMap()
+{
+    delete library;
+}
+
+int FrequencyMap::temperamentCount()
+{
+    return(temperaments.length() + library->temperamentCount());
+}
+
+int FrequencyMap::scaleCount()
+{
+    return(scales.length() + library->scaleCount());
+}
+
+QString FrequencyMap::temperamentName(int index)
+{
+    if ((index >= 0) && (index < temperaments.length())) {
+        return(temperaments.at(index).name);
+    }
+    return(library->temperamentName(index - temperaments.length()));
+}
+
+QString FrequencyMap::scaleName(int index)
+{
+    if ((index >= 0) && (index < scales.length())) return(scales.at(index).name);
+    return(library->scaleName(index - scales.length()));
+}
+
+Temperament FrequencyMap::temperament(int index)
+{
+    if ((index >= 0) && (index < temperaments.length())) {
+        return(temperaments.at(index));
+    }
+    // fall back to the standard temperament if the library has changed
+    Temperament temp;
+    if (! library->temperament(index - temperaments.length(), &temp)) {
+        temp = temperaments.at(0);
+    }
+    return(temp);
+}
+
+Scale FrequencyMap::scale(int index)
+{
+    if ((index >= 0) && (index < scales.length())) return(scales.at(index));
+    Scale s;
+    if (! library->scale(index - scales.length(), &s)) s = scales.at(0);
+    return(s);
+}
+
+int FrequencyMap::findTemperament(const QString &value)
+{
+    bool isNumber;
+    int count = temperamentCount();
+    int index = value.toInt(&isNumber);
+    if (isNumber) return(((index >= 0) && (index < count)) ? index : -1);
+    for (int i = 0; i < count; i++) {
+        if (temperamentName(i).compare(value, Qt::CaseInsensitive) == 0) {
+            return(i);
+        }
+    }
+    return(-1);
+}
+
+int FrequencyMap::findScale(const QString &value)
+{
+    bool isNumber;
+    int count = scaleCount();
+    int index = value.toInt(&isNumber);
+    if (isNumber) return(((index >= 0) && (index < count)) ? index : -1);
+    for (int i = 0; i < count; i++) {
+        if (scaleName(i).compare(value, Qt::CaseInsensitive) == 0) return(i);
+    }
+    return(-1);
+}
+
 void FrequencyMap::updateFrequencies()
 {
     int p;
-    Temperament temp = temperaments[temperamentIndex];
+    Temperament temp = temperament(temperamentIndex);
+    if (temp.type == ScalaTemperament) {
+        updateScalaFrequencies(temp);
+        return;
+    }
     // set the reference pitch
     frequencies[refPitch] = refFreq;
     // build the octave above the reference pitch
@@ -126,3 +258,81 @@ void FrequencyMap::updateFrequencies()
         frequencies[p] = frequencies[p + 12] * 0.5;
     }
 }
+
+// get the degree of a Scala scale a key plays, returning false if the key
+//  isn't mapped
+static bool keyDegree(const Temperament &temp, int key, int *degree)
+{
+    // without a mapping the first degree is on middle C and each key above
+    //  or below it moves by one degree
+    if (! temp.mapped) {
+        *degree = key - SCALA_MIDDLE_NOTE;
+        return(true);
+    }
+    if ((key < temp.firstNote) || (key > temp.lastNote)) return(false);
+    int offset = key - temp.middleNote;
+    int size = temp.keyMap.size();
+    if (size == 0) {
+        *degree = offset;
+        return(true);
+    }
+    int repeat = (int)floor((float)offset / (float)size);
+    int mapped = temp.keyMap.at(offset - (repeat * size));
+    if (mapped < 0) return(false);
+    *degree = mapped + (repeat * temp.mapPeriod);
+    return(true);
+}
+
+// get the size in cents of any degree of a Scala scale above its first,
+//  repeating the scale at its period
+static float degreeCents(const Temperament &temp, int degree)
+{
+    int size = temp.cents.size();
+    int repeat = (int)floor((float)degree / (float)size);
+    int step = degree - (repeat * size);
+    float cents = (float)repeat * temp.cents.at(size - 1);
+    if (step > 0) cents += temp.cents.at(step - 1);
+    return(cents);
+}
+
+void FrequencyMap::updateScalaFrequencies(const Temperament &temp)
+{
+    int degree;
+    // put the reference pitch at the reference frequency, and if it isn't
+    //  mapped, treat it as the first degree
+    float refCents = 0.0;
+    if (keyDegree(temp, refPitch, &degree)) {
+        refCents = degreeCents(temp, degree);
+    }
+    // the period needn't be an octave, so work out every key directly
+    for (int p = 0; p < 128; p++) {
+        if (keyDegree(temp, p, &degree)) {
+            frequencies[p] = refFreq *
+                pow(2.0, (degreeCents(temp, degree) - refCents) / 1200.0);
+        }
+        else {
+            // keys the mapping leaves out stay in equal temperament so
+            //  every pitch still has a frequency
+            frequencies[p] = refFreq * pow(2.0, (float)(p - refPitch) / 12.0);
+        }
+    }
+}
+
+// the octave number at the end of a pitch name
+static const QRegularExpression octaveNumber("[0-9]+$");
+
+QList<WheelSpec> FrequencyMap::wheelsForScale(const Scale &scale)
+{
+    QList<WheelSpec> specs;
+    WheelSpec spec;
+    QString pitch;
+    for (int i = 0; i < scale.pitches.length(); i++) {
+        pitch = scale.pitches.at(i);
+        spec.label = pitch;
+        // a folded wheel stands for its pitch in every octave
+        if (scale.foldOctaves > 0) spec.label.remove(octaveNumber);
+        spec.frequency = frequencies[pitches[pitch]];
+        specs.append(spec);
+    }
+    return(specs);
+}
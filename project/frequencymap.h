@@ -4,33 +4,81 @@
 #include <QString>
 #include <QList>
 #include <QHash>
+#include <QVector>
+
+class TuningLibrary;
 
 typedef enum {
     EqualTemperament,
     SyntonicTemperament,
-    JustTemperament
+    JustTemperament,
+    ScalaTemperament
 } TemperamentType;
 
 typedef struct {
     QString name;
     TemperamentType type;
     float param;
+    // for temperaments from Scala files, the size in cents of each degree
+    //  above the first, ending with the period
+    QVector<float> cents;
+    // whether the degrees are mapped onto keys by a keyboard mapping rather
+    //  than one per key from middle C, and if so the range of
+    //  keys it covers, the key that plays the first degree, the degree each
+    //  key in a repeating pattern plays or -1 for none, and how many degrees
+    //  the pattern moves each time it repeats
+    bool mapped;
+    int firstNote;
+    int lastNote;
+    int middleNote;
+    QVector<int> keyMap;
+    int mapPeriod;
 } Temperament;
 
 typedef struct {
     QString name;
     QList<QString> pitches;
+    // whether to only run the wheels near the detected pitch, for scales
+    //  too big to run all at once
+    bool autoRange;
+    // the number of octaves to fold onto each wheel, for scales of pitch
+    //  classes, or zero to only analyze the pitches themselves
+    int foldOctaves;
 } Scale;
 
+// a wheel to be analyzed
+typedef struct {
+    // a label to go in the center of the wheel, e.g. a pitch class
+    QString label;
+    // the fundamental frequency of the wheel in Hz
+    float frequency;
+} WheelSpec;
+
 class FrequencyMap
 {
 public:
     // initiliaze and update
     FrequencyMap();
+    ~FrequencyMap();
     void updateFrequencies();
-    // available temperaments
+    // get the number of temperaments and scales, built in and from the
+    //  tuning library after them, their names, and the temperaments and
+    //  scales themselves
+    int temperamentCount();
+    int scaleCount();
+    QString temperamentName(int index);
+    QString scaleName(int index);
+    Temperament temperament(int index);
+    Scale scale(int index);
+    // find a temperament or scale by name or index, returning -1 if it
+    //  isn't there
+    int findTemperament(const QString &value);
+    int findScale(const QString &value);
+    // get the wheels to show for a scale with the current frequencies
+    QList<WheelSpec> wheelsForScale(const Scale &scale);
+    // built-in temperaments
     QList<Temperament> temperaments;
-    // available scales
+    // built-in scales
     QList<Scale> scales;
     // a map from pitch name to MIDI note number
     QHash<QString, int> pitches;
@@ -44,6 +92,10 @@ public:
     float refFreq;
 
 protected:
+    // fill in the frequencies for a temperament from a Scala file
+    void updateScalaFrequencies(const Temperament &temp);
+    // temperaments and scales loaded from files
+    TuningLibrary *library;
     // a table of ratios for just intonations
     int justRatios[12][11][2] = {
         // 5-limit (Symmetric 1 Aug 4th)
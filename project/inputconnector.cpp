@@ -0,0 +1,152 @@
+#include "inputconnector.h"
+#include "jackinput.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <QDebug>
+
+InputConnector::InputConnector(Analyzer *inputAnalyzer, QObject *parent) :
+    QThread(parent)
+{
+    analyzer = inputAnalyzer;
+    plan.replaySpeed = ReplayRealTime;
+    plan.channels = 1;
+    plan.bufferSeconds = 0.2;
+    wanted = false;
+    generation = 0;
+    ready = NULL;
+    stopping = false;
+}
+
+void InputConnector::request(const InputPlan &newPlan)
+{
+    QMutexLocker lock(&mutex);
+    plan = newPlan;
+    wanted = true;
+    generation++;
+    wake.wakeAll();
+}
+
+void InputConnector::cancel()
+{
+    QMutexLocker lock(&mutex);
+    wanted = false;
+    generation++;
+    // an input that wasn't taken never reached the analyzer, so the
+    //  worker can close it right away
+    if (ready != NULL) retired.append(ready);
+    ready = NULL;
+    wake.wakeAll();
+}
+
+AudioInput *InputConnector::takeInput()
+{
+    QMutexLocker lock(&mutex);
+    AudioInput *input = ready;
+    ready = NULL;
+    return(input);
+}
+
+void InputConnector::retire(AudioInput *oldInput)
+{
+    if (oldInput == NULL) return;
+    QMutexLocker lock(&mutex);
+    retired.append(oldInput);
+    wake.wakeAll();
+}
+
+void InputConnector::stop()
+{
+    mutex.lock();
+    stopping = true;
+    wanted = false;
+    wake.wakeAll();
+    mutex.unlock();
+    // the worker closes retired inputs before it exits
+    wait();
+    delete takeInput();
+}
+
+AudioInput *InputConnector::makeInput(const InputPlan &plan)
+{
+    if (! plan.replayPath.isEmpty()) {
+        return(new ReplayInput(plan.replayPath.toUtf8().constData(),
+                               plan.bufferSeconds, plan.replaySpeed));
+    }
+    JackInput *jackInput = new JackInput(plan.bufferSeconds, plan.channels);
+    if ((! plan.capturePath.isEmpty()) &&
+        (! jackInput->startCapture(plan.capturePath.toUtf8().constData()))) {
+        qWarning() << "Failed to record input to" << plan.capturePath <<
+            ":" << strerror(errno);
+    }
+    return(jackInput);
+}
+
+void InputConnector::run()
+{
+    InputPlan attemptPlan;
+    unsigned int attempt;
+    AudioInput *input;
+    QString error;
+    bool retry;
+    int delay = CONNECT_MIN_RETRY_MSECS;
+    QMutexLocker lock(&mutex);
+    while (true) {
+        // close old inputs first, since closing a JACK client can take as
+        //  long as opening one and the new one shouldn't overlap it
+        if (! retired.isEmpty()) {
+            input = retired.takeFirst();
+            lock.unlock();
+            analyzer->waitForRelease(input);
+            delete input;
+            lock.relock();
+            continue;
+        }
+        if (stopping) break;
+        if (! wanted) {
+            wake.wait(&mutex);
+            delay = CONNECT_MIN_RETRY_MSECS;
+            continue;
+        }
+        // try without holding the lock, since opening a JACK client can
+        //  take a while
+        attemptPlan = plan;
+        attempt = generation;
+        lock.unlock();
+        input = NULL;
+        retry = true;
+        try {
+            input = makeInput(attemptPlan);
+        }
+        catch (AudioInputException &e) {
+            error = e.what();
+            // a recording that can't be read won't get any better
+            retry = attemptPlan.replayPath.isEmpty();
+        }
+        lock.relock();
+        // throw away the result of a request that's been replaced
+        if (attempt != generation) {
+            delete input;
+            delay = CONNECT_MIN_RETRY_MSECS;
+            continue;
+        }
+        if (input != NULL) {
+            delete ready;
+            ready = input;
+            wanted = false;
+            emit connected();
+            continue;
+        }
+        if (! retry) {
+            wanted = false;
+            emit failed(error, -1);
+            continue;
+        }
+        emit failed(error, delay);
+        // a new request or stopping cuts the wait short
+        wake.wait(&mutex, delay);
+        if (attempt != generation) delay = CONNECT_MIN_RETRY_MSECS;
+        else delay = qMin(delay * 2, CONNECT_MAX_RETRY_MSECS);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef INPUTCONNECTOR_H
+#define INPUTCONNECTOR_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QList>
+
+#include "analyzer.h"
+#include "audioinput.h"
+#include "replayinput.h"
+
+// how long to wait before trying to connect again after the first
+//  failure, and the longest to wait as failures pile up, in milliseconds
+#define CONNECT_MIN_RETRY_MSECS 250
+#define CONNECT_MAX_RETRY_MSECS 8000
+
+// what kind of input to make
+typedef struct {
+    // a recording to replay instead of using JACK, and how fast
+    QString replayPath;
+    ReplaySpeed replaySpeed;
+    // the number of JACK ports to make and a file to record them to, or
+    //  an empty path to not record
+    int channels;
+    QString capturePath;
+    // the length of the input's buffer in seconds
+    float bufferSeconds;
+} InputPlan;
+
+// a worker thread that makes and tears down inputs, so a JACK server that's
+//  slow or missing never holds up the interface; failed attempts to reach
+//  JACK are retried with a growing delay until one succeeds or the attempt
+//  is cancelled
+class InputConnector : public QThread
+{
+    Q_OBJECT
+
+public:
+    // make a connector for inputs that the given analyzer reads from
+    explicit InputConnector(Analyzer *inputAnalyzer, QObject *parent = 0);
+    // start trying to make an input for a plan, replacing any attempt
+    //  already in progress
+    void request(const InputPlan &newPlan);
+    // stop trying to make an input, discarding one that's been made but
+    //  not taken
+    void cancel();
+    // take the input made by the latest request, or NULL if there isn't
+    //  one; the caller owns it
+    AudioInput *takeInput();
+    // close an input that's no longer wanted once the analyzer has let go
+    //  of it, which has to be replaced in the analyzer first; this happens
+    //  before the next input is made
+    void retire(AudioInput *oldInput);
+    // stop the worker thread and wait for it to finish
+    void stop();
+
+signals:
+    // an input has been made and can be taken
+    void connected();
+    // an attempt failed with the given message, and the next one will be
+    //  made after a number of milliseconds, or never if it's negative
+    void failed(QString message, int retryMsecs);
+
+protected:
+    // make inputs as they're requested
+    void run();
+
+private:
+    // make the input for a plan, throwing an AudioInputException on failure
+    static AudioInput *makeInput(const InputPlan &plan);
+    // the analyzer that reads from the inputs
+    Analyzer *analyzer;
+    // guards everything below
+    QMutex mutex;
+    // wakes the worker for a new request or to stop
+    QWaitCondition wake;
+    // the latest plan, whether an input is wanted for it, and a count of
+    //  requests so the worker can tell when its attempt is stale
+    InputPlan plan;
+    bool wanted;
+    unsigned int generation;
+    // an input that's been made but not taken yet, and inputs waiting to
+    //  be closed
+    AudioInput *ready;
+    QList<AudioInput *> retired;
+    // whether the worker should exit
+    bool stopping;
+};
+
+#endif // INPUTCONNECTOR_H
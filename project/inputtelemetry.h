@@ -0,0 +1,68 @@
+#ifndef INPUTTELEMETRY_H
+#define INPUTTELEMETRY_H
+
+#include <atomic>
+
+// the number of buckets in the callback duration histogram
+#define TELEMETRY_BUCKETS 8
+// the longest callback in the first bucket in microseconds; each bucket
+//  after it holds callbacks up to twice as long, and the last one holds
+//  everything longer
+#define TELEMETRY_FIRST_BUCKET_USECS 32
+
+// counters describing the health of an audio input, which the realtime
+//  thread updates without locking and any thread can read
+class InputTelemetry
+{
+public:
+    InputTelemetry() { reset(); }
+    // the frames thrown away because the reader fell behind
+    std::atomic<unsigned long> droppedFrames;
+    // the most frames the buffer has held at once
+    std::atomic<unsigned long> highWater;
+    // the number of xruns the server has reported
+    std::atomic<unsigned long> xruns;
+    // the frames that were waiting in the buffer at the last read and the
+    //  most that have been waiting at any read
+    std::atomic<unsigned long> readLatency;
+    std::atomic<unsigned long> maxReadLatency;
+    // the number of process callbacks and how many took each length of time
+    std::atomic<unsigned long> callbacks;
+    std::atomic<unsigned long> durations[TELEMETRY_BUCKETS];
+
+    // start all counters over
+    void reset() {
+        droppedFrames = 0;
+        highWater = 0;
+        xruns = 0;
+        readLatency = 0;
+        maxReadLatency = 0;
+        callbacks = 0;
+        for (int i = 0; i < TELEMETRY_BUCKETS; i++) durations[i] = 0;
+    }
+    // raise a high-water mark, which only one thread may do
+    static void raise(std::atomic<unsigned long> &mark, unsigned long value) {
+        if (value > mark.load(std::memory_order_relaxed)) {
+            mark.store(value, std::memory_order_relaxed);
+        }
+    }
+    // count a process callback that took the given number of microseconds
+    void addCallback(unsigned long usecs) {
+        int bucket = 0;
+        unsigned long limit = TELEMETRY_FIRST_BUCKET_USECS;
+        while ((bucket < TELEMETRY_BUCKETS - 1) && (usecs > limit)) {
+            bucket++;
+            limit *= 2;
+        }
+        durations[bucket].fetch_add(1, std::memory_order_relaxed);
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+    // the longest callback in a bucket in microseconds, or 0 for the last
+    //  bucket, which has no limit
+    static unsigned long bucketLimit(int bucket) {
+        if (bucket >= TELEMETRY_BUCKETS - 1) return(0);
+        return((unsigned long)TELEMETRY_FIRST_BUCKET_USECS << bucket);
+    }
+};
+
+#endif // INPUTTELEMETRY_H
@@ -2,6 +2,7 @@
 
 #include <exception>
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <QDebug>
@@ -13,96 +14,182 @@ static int jack_process(jack_nframes_t nframes, void *context)
     return(jackInput->process(nframes));
 }
 
-JackInput::JackInput(float bufferSeconds)
+// name the JACK thread for profiling
+static void jack_thread_init(void *)
+{
+    Profiler::nameThread("jack");
+}
+
+// route JACK xrun notifications to a class instance
+static int jack_xrun(void *context)
+{
+    JackInput *jackInput = (JackInput *)context;
+    return(jackInput->xrun());
+}
+
+// route JACK shutdown notifications to a class instance
+static void jack_shutdown(void *context)
+{
+    JackInput *jackInput = (JackInput *)context;
+    jackInput->shutdown();
+}
+
+// route JACK sample rate changes to a class instance
+static int jack_sample_rate(jack_nframes_t rate, void *context)
+{
+    JackInput *jackInput = (JackInput *)context;
+    return(jackInput->sampleRateChanged(rate));
+}
+
+JackInput::JackInput(float bufferSeconds, int channelCount)
 {
     // initialize pointers in case of failure
     client = NULL;
-    port = NULL;
-    buffer = NULL;
+    channels = (channelCount < 1) ? 1 : channelCount;
+    ports = new jack_port_t *[channels];
+    portBuffers = new const jack_default_audio_sample_t *[channels];
+    for (int c = 0; c < channels; c++) {
+        ports[c] = NULL;
+        portBuffers[c] = NULL;
+    }
+    capture = NULL;
     // connect to JACK
     jack_status_t jack_status;
     client = jack_client_open("qjackstrobe", JackNoStartServer, &jack_status);
     if ((jack_status & JackServerFailed) != 0) {
-        throw JackInputException("Failed to connect to the JACK server.");
+        fail("Failed to connect to the JACK server.");
     }
     else if ((jack_status & JackServerError) != 0) {
-        throw JackInputException("Failed to communicate with the JACK server.");
+        fail("Failed to communicate with the JACK server.");
     }
-    else if ((jack_status & JackFailure) != 0) {
-        throw JackInputException("Failed to create a JACK client.");
+    else if (((jack_status & JackFailure) != 0) || (client == NULL)) {
+        fail("Failed to create a JACK client.");
     }
-    // create a port for audio input
-    port = jack_port_register(client, "in",
-        JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput | JackPortIsTerminal, 0);
-    if (port == NULL) {
-        throw JackInputException("Failed to create a JACK output port.");
+    // create a port for each channel of audio input
+    char name[16];
+    for (int c = 0; c < channels; c++) {
+        if (channels == 1) strcpy(name, "in");
+        else snprintf(name, sizeof(name), "in_%d", c + 1);
+        ports[c] = jack_port_register(client, name,
+            JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput | JackPortIsTerminal, 0);
+        if (ports[c] == NULL) {
+            fail("Failed to create a JACK input port.");
+        }
     }
     // get the sample rate to convert times
     sampleRate = jack_get_sample_rate(client);
-    // create a ring buffer for storing received audio
-    int bufferSamples = (int)ceil(bufferSeconds * (float)sampleRate);
-    size_t bytes = bufferSamples * sizeof(jack_default_audio_sample_t);
-    buffer = jack_ringbuffer_create(bytes);
-    if (buffer == NULL) {
-        throw JackInputException("Failed to allocate a buffer for JACK input.");
+    // create ring buffers for storing received audio
+    if (! initBuffers(bufferSeconds)) {
+        fail("Failed to allocate a buffer for JACK input.");
     }
-    jack_ringbuffer_reset(buffer);
     // activate the client for receiving audio
+    jack_set_thread_init_callback(client, jack_thread_init, NULL);
     int result = jack_set_process_callback(client, jack_process, (void *)this);
     if (result != 0) {
-        throw JackInputException("Failed to bind a JACK processing callback.");
+        fail("Failed to bind a JACK processing callback.");
+    }
+    result = jack_set_xrun_callback(client, jack_xrun, (void *)this);
+    if (result != 0) {
+        fail("Failed to bind a JACK xrun callback.");
     }
+    result = jack_set_sample_rate_callback(client, jack_sample_rate,
+                                           (void *)this);
+    if (result != 0) {
+        fail("Failed to bind a JACK sample rate callback.");
+    }
+    // find out when the server goes away so the client can be remade
+    jack_on_shutdown(client, jack_shutdown, (void *)this);
     result = jack_activate(client);
     if (result != 0) {
-        throw JackInputException("Failed to activate JACK client.");
+        fail("Failed to activate JACK client.");
     }
 }
 
+void JackInput::fail(const char *message)
+{
+    release();
+    throw JackInputException(message);
+}
+
 int JackInput::process(jack_nframes_t nframes)
 {
-    size_t frameSize = sizeof(jack_default_audio_sample_t);
-    // handle the case where an xrun has misaligned the ring buffer
-    if (buffer->write_ptr % frameSize != 0) {
-        buffer->write_ptr -= buffer->write_ptr % frameSize;
+    PROFILE_SCOPE(ProfileJackProcess);
+    jack_time_t start = jack_get_time();
+    for (int c = 0; c < channels; c++) {
+        portBuffers[c] = (const jack_default_audio_sample_t *)
+            jack_port_get_buffer(ports[c], nframes);
     }
-    const char *audio = (const char *)jack_port_get_buffer(port, nframes);
-    if (buffer == NULL) return(0);
-    int bytes = nframes * frameSize;
-    jack_ringbuffer_write(buffer, audio, bytes);
+    // record the block as it arrived, before any of it gets dropped
+    Capture *recording = capture.load(std::memory_order_acquire);
+    if (recording != NULL) {
+        recording->write(portBuffers, nframes,
+            jack_last_frame_time(client), start);
+    }
+    bufferBlock(portBuffers, nframes);
+    telemetry.addCallback((unsigned long)(jack_get_time() - start));
     return(0);
 }
 
-jack_nframes_t JackInput::read(jack_default_audio_sample_t **out)
+int JackInput::xrun()
 {
-    size_t frameSize = sizeof(jack_default_audio_sample_t);
-    // see how much data we have in the buffer
-    size_t bytesAvailable = jack_ringbuffer_read_space(buffer);
-    jack_nframes_t framesAvailable = bytesAvailable / frameSize;
-    // try to read the number of frames since the last time we read
-    jack_nframes_t thisRead = jack_time_to_frames(client, jack_get_time());
-    jack_nframes_t framesToRead = thisRead - lastRead;
-    lastRead = thisRead;
-    // avoid underruns
-    if (framesToRead > (framesAvailable / 2)) framesToRead = (framesAvailable / 2);
-    size_t bytesToRead = framesToRead * frameSize;
-    // allocate a buffer for the audio
-    *out = new jack_default_audio_sample_t[framesToRead];
-    // read audio from the buffer
-    size_t bytesRead = jack_ringbuffer_read(buffer, (char *)(*out), bytesToRead);
-    // return how many frames were read
-    jack_nframes_t framesRead = bytesRead / frameSize;
-    return(framesRead);
+    telemetry.xruns.fetch_add(1, std::memory_order_relaxed);
+    return(0);
 }
 
-JackInput::~JackInput() {
-    // disconnect gracefully from JACK
+void JackInput::shutdown()
+{
+    notify(InputLost);
+}
+
+int JackInput::sampleRateChanged(jack_nframes_t rate)
+{
+    // the server reports the rate once on activation whether or not it
+    //  has changed
+    if (rate == sampleRate.exchange(rate)) return(0);
+    notify(InputRateChanged);
+    return(0);
+}
+
+bool JackInput::startCapture(const char *path)
+{
+    if (capture.load() != NULL) return(true);
+    Capture *recording = new Capture();
+    if (! recording->open(path, channels, sampleRate, 1.0)) {
+        delete recording;
+        return(false);
+    }
+    capture.store(recording, std::memory_order_release);
+    return(true);
+}
+
+unsigned long JackInput::getCaptureDropped()
+{
+    Capture *recording = capture.load();
+    return((recording != NULL) ? recording->getDropped() : 0);
+}
+
+void JackInput::release()
+{
     if (client != NULL) {
-        if (port != NULL) jack_port_disconnect(client, port);
-        jack_deactivate(client);
+        // disconnect gracefully unless the server is already gone, in
+        //  which case closing just frees the client
+        if (! isLost()) {
+            for (int c = 0; c < channels; c++) {
+                if (ports[c] != NULL) jack_port_disconnect(client, ports[c]);
+            }
+            jack_deactivate(client);
+        }
         jack_client_close(client);
+        client = NULL;
     }
-    // free the buffer
-    if (buffer != NULL) {
-        jack_ringbuffer_free(buffer);
-    }
+    // finish the recording now that nothing's writing to it
+    delete capture.exchange(NULL);
+    delete[] ports;
+    delete[] portBuffers;
+    ports = NULL;
+    portBuffers = NULL;
+}
+
+JackInput::~JackInput() {
+    release();
 }
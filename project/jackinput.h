@@ -1,48 +1,56 @@
 #ifndef JACKINPUT_H
 #define JACKINPUT_H
 
-#include <exception>
+#include <atomic>
 
 #include <jack/jack.h>
-#include <jack/ringbuffer.h>
 
-class JackInput
+#include "audioinput.h"
+#include "capture.h"
+
+// audio input from ports on a JACK server
+class JackInput : public AudioInput
 {
 private:
     // the JACK client we're connected as
     jack_client_t *client;
-    // the JACK input port for audio
-    jack_port_t *port;
-    // the sample rate JACK is using
-    jack_nframes_t sampleRate;
-    // the buffer to store captured audio into
-    jack_ringbuffer_t *buffer;
-    // the frame count the last time the read function was called
-    jack_nframes_t lastRead;
+    // a JACK port for each channel and the audio on each in a callback
+    jack_port_t **ports;
+    const jack_default_audio_sample_t **portBuffers;
+    // a recording of the input being made, or NULL
+    std::atomic<Capture *> capture;
+    // close the client, which the server may already have dropped, and
+    //  release the ports
+    void release();
+    // release everything and throw an exception with the given message
+    void fail(const char *message);
 public:
-    // initialize the input with the given buffer length in seconds
-    JackInput(float bufferSeconds);
+    // initialize the input with the given buffer length in seconds and
+    //  number of channels, where a single channel's port is named "in" and
+    //  several are named "in_1", "in_2" and so on
+    JackInput(float bufferSeconds, int channelCount = 1);
     // handle incoming audio data
     int process(jack_nframes_t nframes);
-    // get all buffered audio data, leaving a certain number of seconds in
-    //  the buffer to avoid underruns
-    jack_nframes_t read(jack_default_audio_sample_t **out);
-    // get the current sample rate
-    jack_nframes_t getSampleRate() { return(sampleRate); }
+    // count an xrun reported by the server
+    int xrun();
+    // note that the server has shut down or dropped the client
+    void shutdown();
+    // take up a new sample rate from the server
+    int sampleRateChanged(jack_nframes_t rate);
+    // record everything that arrives from now on to a file along with when
+    //  it arrived, which can be replayed with ReplayInput; returns false
+    //  and sets errno on failure
+    bool startCapture(const char *path);
+    // the number of blocks that couldn't be recorded in time
+    unsigned long getCaptureDropped();
     // release the JACK connections and buffer
     ~JackInput();
 };
 
-class JackInputException : public std::exception {
-private:
-    const char *message;
+class JackInputException : public AudioInputException {
 public:
-    JackInputException(const char *inMessage) {
-        message = inMessage;
-    }
-    virtual const char* what() const throw() {
-        return(message);
-    }
+    JackInputException(const char *inMessage) :
+        AudioInputException(inMessage) { }
 };
 
 #endif // JACKINPUT_H
@@ -16,13 +16,63 @@ TEMPLATE = app
 
 LIBS += -L/usr/include/jack/ -ljack
 
+# count heap allocations so the analyzer can check that it doesn't make any
+count_allocations {
+    DEFINES += COUNT_ALLOCATIONS
+}
+
 SOURCES += main.cpp\
         widget.cpp \
+    audioinput.cpp \
     jackinput.cpp \
-    frequencymap.cpp
+    inputconnector.cpp \
+    capture.cpp \
+    replayinput.cpp \
+    frequencymap.cpp \
+    tuninglibrary.cpp \
+    arena.cpp \
+    strobeengine.cpp \
+    strobekernel.cpp \
+    fft.cpp \
+    driftestimator.cpp \
+    pitchdetector.cpp \
+    octavebank.cpp \
+    preprocessor.cpp \
+    analyzer.cpp \
+    workerpool.cpp \
+    profiler.cpp \
+    oscpublisher.cpp \
+    alloccounter.cpp \
+    audiofile.cpp \
+    offline.cpp \
+    wheelrenderer.cpp
 
 HEADERS  += widget.h \
+    audioinput.h \
     jackinput.h \
-    frequencymap.h
+    inputconnector.h \
+    capture.h \
+    replayinput.h \
+    inputtelemetry.h \
+    frequencymap.h \
+    tuninglibrary.h \
+    tuningmodel.h \
+    arena.h \
+    strobeengine.h \
+    strobekernel.h \
+    fft.h \
+    driftestimator.h \
+    pitchdetector.h \
+    octavebank.h \
+    preprocessor.h \
+    analyzer.h \
+    workerpool.h \
+    profiler.h \
+    oscpublisher.h \
+    triplebuffer.h \
+    alloccounter.h \
+    audiofile.h \
+    offline.h \
+    wheelrenderer.h
 
 FORMS    += widget.ui
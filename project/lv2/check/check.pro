@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Runs the LV2 plugin the way a host would and checks that run() never
+#  allocates
+#
+#-------------------------------------------------
+
+CONFIG += c++11 console thread
+CONFIG -= qt app_bundle
+
+TARGET = jackstrobe-lv2-check
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+# count heap allocations so run() can be checked, and leave out the
+#  profiler as the plugin does
+DEFINES += COUNT_ALLOCATIONS NO_PROFILING
+
+SOURCES += lv2check.cpp \
+    ../strobeplugin.cpp \
+    ../../arena.cpp \
+    ../../strobeengine.cpp \
+    ../../strobekernel.cpp \
+    ../../fft.cpp \
+    ../../driftestimator.cpp \
+    ../../pitchdetector.cpp \
+    ../../octavebank.cpp \
+    ../../preprocessor.cpp \
+    ../../alloccounter.cpp
+
+HEADERS += ../../arena.h \
+    ../../strobeengine.h \
+    ../../strobekernel.h \
+    ../../fft.h \
+    ../../driftestimator.h \
+    ../../pitchdetector.h \
+    ../../octavebank.h \
+    ../../preprocessor.h \
+    ../../alloccounter.h
@@ -0,0 +1,153 @@
+// Drives the LV2 plugin through its descriptor the way a host would, over
+//  synthetic tones with the reference moving under them, and checks that
+//  run() never allocates; it also prints what the plugin reports for each
+//  tone so a broken build shows up as nonsense readings.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lv2/core/lv2.h>
+
+#include "alloccounter.h"
+
+// the sample rate and block size to run the plugin at, as a host might
+#define CHECK_RATE 48000.0
+#define CHECK_BLOCK_FRAMES 256
+// how many run() calls each stage of the check lasts, and how often the
+//  reference moves during the first half of the stage that moves it, after
+//  which it holds at the last reference so the reading can settle
+#define CHECK_STAGE_RUNS 1000
+#define CHECK_REFERENCE_RUNS 100
+
+// the port indices from jackstrobe.ttl
+typedef enum {
+    PortInput,
+    PortOutput,
+    PortReference,
+    PortNote,
+    PortFrequency,
+    PortCents,
+    PortInstability,
+    PortAmplitude,
+    PortTracking,
+    PORT_COUNT
+} PortIndex;
+
+// a stage of the check: a tone with a few harmonics, or silence for a
+//  frequency of zero, and whether to move the reference while it plays
+typedef struct {
+    const char *name;
+    float frequency;
+    bool moveReference;
+} CheckStage;
+
+extern "C" const LV2_Descriptor *lv2_descriptor(uint32_t index);
+
+// the number of heap allocations made by the calling thread so far, or 0
+//  if allocations aren't being counted
+static unsigned long allocations()
+{
+#ifdef COUNT_ALLOCATIONS
+    return(threadAllocationCount());
+#else
+    return(0);
+#endif
+}
+
+// fill a block with a tone, carrying its phase between blocks
+static void makeTone(float frequency, float *out, int count, double *phase)
+{
+    double step = 2.0 * M_PI * frequency / CHECK_RATE;
+    for (int s = 0; s < count; s++) {
+        out[s] = 0.5 * sin(*phase) + 0.2 * sin(2.0 * *phase) +
+            0.1 * sin(3.0 * *phase);
+        *phase += step;
+        if (*phase > 2.0 * M_PI) *phase -= 2.0 * M_PI;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argv;
+    if (argc > 1) {
+        fprintf(stderr,
+            "usage: jackstrobe-lv2-check\n"
+            "  Runs the LV2 plugin over synthetic tones and exits with an\n"
+            "  error if run() allocates any memory.\n");
+        return(1);
+    }
+#ifndef COUNT_ALLOCATIONS
+    printf("can't check without COUNT_ALLOCATIONS\n");
+    return(1);
+#endif
+    const LV2_Descriptor *descriptor = lv2_descriptor(0);
+    if (descriptor == NULL) {
+        fprintf(stderr, "The plugin has no descriptor.\n");
+        return(1);
+    }
+    LV2_Handle plugin = descriptor->instantiate(descriptor, CHECK_RATE, ".",
+                                                NULL);
+    if (plugin == NULL) {
+        fprintf(stderr, "The plugin failed to instantiate.\n");
+        return(1);
+    }
+    float input[CHECK_BLOCK_FRAMES];
+    float output[CHECK_BLOCK_FRAMES];
+    float controls[PORT_COUNT];
+    memset(controls, 0, sizeof(controls));
+    controls[PortReference] = 440.0f;
+    descriptor->connect_port(plugin, PortInput, input);
+    descriptor->connect_port(plugin, PortOutput, output);
+    for (int p = PortReference; p < PORT_COUNT; p++) {
+        descriptor->connect_port(plugin, p, &controls[p]);
+    }
+    descriptor->activate(plugin);
+    // a slightly sharp A4 and A2, the same A4 with the reference moving
+    //  between its ends and then holding at 432 Hz, and then silence
+    const CheckStage stages[] = {
+        { "A4 at 441 Hz", 441.0f, false },
+        { "A2 at 110.2 Hz", 110.2f, false },
+        { "A4, moving reference", 441.0f, true },
+        { "silence", 0.0f, false }
+    };
+    const float references[] = { 400.0f, 480.0f, 440.0f, 450.0f, 432.0f };
+    int stageCount = sizeof(stages) / sizeof(stages[0]);
+    unsigned long total = 0;
+    double phase = 0.0;
+    printf("%d run() calls of %d frames at %.0f Hz for each stage\n",
+        CHECK_STAGE_RUNS, CHECK_BLOCK_FRAMES, CHECK_RATE);
+    printf("%-22s %6s %10s %8s %12s %12s\n", "stage", "note", "frequency",
+        "cents", "instability", "allocations");
+    for (int s = 0; s < stageCount; s++) {
+        const CheckStage *stage = &stages[s];
+        unsigned long made = 0;
+        controls[PortReference] = 440.0f;
+        for (int r = 0; r < CHECK_STAGE_RUNS; r++) {
+            if ((stage->moveReference) && (r % CHECK_REFERENCE_RUNS == 0) &&
+                (r < CHECK_STAGE_RUNS / 2)) {
+                controls[PortReference] = references[r / CHECK_REFERENCE_RUNS];
+            }
+            if (stage->frequency > 0.0f) {
+                makeTone(stage->frequency, input, CHECK_BLOCK_FRAMES, &phase);
+            }
+            else memset(input, 0, sizeof(input));
+            unsigned long start = allocations();
+            descriptor->run(plugin, CHECK_BLOCK_FRAMES);
+            made += allocations() - start;
+        }
+        printf("%-22s %6.0f %10.2f %8.1f %12.3f %12lu\n", stage->name,
+            controls[PortNote], controls[PortFrequency], controls[PortCents],
+            controls[PortInstability], made);
+        total += made;
+    }
+    if (memcmp(input, output, sizeof(input)) != 0) {
+        printf("the audio wasn't passed through unchanged\n");
+        total++;
+    }
+    if (descriptor->deactivate != NULL) descriptor->deactivate(plugin);
+    descriptor->cleanup(plugin);
+    printf("%s\n", (total == 0) ? "ok" : "FAILED");
+    return((total == 0) ? 0 : 1);
+}
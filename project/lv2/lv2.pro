@@ -0,0 +1,45 @@
+#-------------------------------------------------
+#
+# The strobe engine as an LV2 plugin
+#
+#-------------------------------------------------
+
+CONFIG += c++11 plugin no_plugin_name_prefix thread
+CONFIG -= qt
+
+TARGET = jackstrobe
+TEMPLATE = lib
+
+INCLUDEPATH += ..
+
+# the host's audio thread has no use for the profiler's timers
+DEFINES += NO_PROFILING
+
+SOURCES += strobeplugin.cpp \
+    ../arena.cpp \
+    ../strobeengine.cpp \
+    ../strobekernel.cpp \
+    ../fft.cpp \
+    ../driftestimator.cpp \
+    ../pitchdetector.cpp \
+    ../octavebank.cpp \
+    ../preprocessor.cpp
+
+HEADERS += ../arena.h \
+    ../strobeengine.h \
+    ../strobekernel.h \
+    ../fft.h \
+    ../driftestimator.h \
+    ../pitchdetector.h \
+    ../octavebank.h \
+    ../preprocessor.h
+
+DISTFILES += manifest.ttl \
+    jackstrobe.ttl
+
+# install as a bundle where hosts look for plugins
+isEmpty(LV2DIR): LV2DIR = /usr/lib/lv2
+target.path = $$LV2DIR/jackstrobe.lv2
+bundle.files = manifest.ttl jackstrobe.ttl
+bundle.path = $$LV2DIR/jackstrobe.lv2
+INSTALLS += target bundle
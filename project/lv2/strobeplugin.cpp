@@ -0,0 +1,220 @@
+// An LV2 plugin that runs a strobe engine inside a host's audio callback
+//  and reports the detected wheel on control output ports, so the tuner
+//  can sit in a DAW or live rig instead of running as its own JACK client.
+//  Everything the engine needs is allocated when the plugin is
+//  instantiated, so run() never touches the heap.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lv2/core/lv2.h>
+
+#include "strobeengine.h"
+
+#define STROBE_URI "https://github.com/jessecrossen/jackstrobe"
+
+// the wheels cover every pitch from C0 through B8, gated by the pitch
+//  detector like the "Auto-range" scale
+#define STROBE_FIRST_NOTE 12
+#define STROBE_NOTES 108
+// the length of an analysis window in seconds
+#define STROBE_WINDOW_SECONDS 0.05
+// the fixed number of bins per revolution, which keeps retuning from
+//  ever resizing a wheel
+#define STROBE_RESOLUTION 64
+// the range of the reference frequency for A4, matching the port's range
+//  in the plugin description
+#define STROBE_MIN_REFERENCE 400.0f
+#define STROBE_MAX_REFERENCE 480.0f
+#define STROBE_DEFAULT_REFERENCE 440.0f
+
+typedef enum {
+    PortInput,
+    PortOutput,
+    PortReference,
+    PortNote,
+    PortFrequency,
+    PortCents,
+    PortInstability,
+    PortAmplitude,
+    PortTracking,
+    PORT_COUNT
+} PortIndex;
+
+typedef struct {
+    StrobeEngine *engine;
+    // the host's buffers for each port
+    const float *input;
+    float *output;
+    const float *reference;
+    float *note;
+    float *frequency;
+    float *cents;
+    float *instability;
+    float *amplitude;
+    float *tracking;
+    // the reference the wheels are tuned to and their frequencies
+    float tunedReference;
+    float frequencies[STROBE_NOTES];
+    // what was reported for the last finished window, held until the next
+    //  one finishes
+    float lastNote;
+    float lastFrequency;
+    float lastCents;
+    float lastInstability;
+    float lastAmplitude;
+    float lastTracking;
+} StrobePlugin;
+
+// get the equal-tempered frequency of each wheel for a reference A4
+static void planFrequencies(StrobePlugin *plugin, float reference)
+{
+    for (int i = 0; i < STROBE_NOTES; i++) {
+        plugin->frequencies[i] = reference *
+            powf(2.0f, (float)(STROBE_FIRST_NOTE + i - 69) / 12.0f);
+    }
+    plugin->tunedReference = reference;
+}
+
+static float clampReference(float reference)
+{
+    if (! (reference >= STROBE_MIN_REFERENCE)) return(STROBE_MIN_REFERENCE);
+    if (reference > STROBE_MAX_REFERENCE) return(STROBE_MAX_REFERENCE);
+    return(reference);
+}
+
+static void reportWheel(StrobePlugin *plugin)
+{
+    int best = plugin->engine->getBestWheel();
+    if (best < 0) {
+        plugin->lastNote = -1.0f;
+        plugin->lastFrequency = 0.0f;
+        plugin->lastCents = 0.0f;
+        plugin->lastInstability = 1.0f;
+        plugin->lastAmplitude = 0.0f;
+        plugin->lastTracking = 0.0f;
+        return;
+    }
+    const Wheel *wheel = &plugin->engine->getWheels()[best];
+    plugin->lastNote = (float)(STROBE_FIRST_NOTE + best);
+    plugin->lastFrequency = wheel->frequency;
+    plugin->lastCents = wheel->hasOffset ? wheel->cents : 0.0f;
+    plugin->lastInstability = wheel->instability;
+    plugin->lastAmplitude = wheel->maxAmplitude;
+    plugin->lastTracking = wheel->hasOffset ? 1.0f : 0.0f;
+}
+
+static LV2_Handle instantiate(const LV2_Descriptor *descriptor, double rate,
+                              const char *bundlePath,
+                              const LV2_Feature * const *features)
+{
+    (void)descriptor;
+    (void)bundlePath;
+    (void)features;
+    StrobePlugin *plugin = new StrobePlugin;
+    memset(plugin, 0, sizeof(StrobePlugin));
+    StrobeEngine *engine = new StrobeEngine;
+    plugin->engine = engine;
+    engine->autoselect = true;
+    engine->setResolution(STROBE_RESOLUTION);
+    engine->setGating(true);
+    engine->setWindowFrames((int)(STROBE_WINDOW_SECONDS * rate));
+    // plan the wheels for the lowest reference first, which gives them
+    //  the deepest decimation they'll ever need, so retuning from run()
+    //  never has to add a level
+    planFrequencies(plugin, STROBE_MIN_REFERENCE);
+    engine->initWheels(plugin->frequencies, STROBE_NOTES, (float)rate);
+    planFrequencies(plugin, STROBE_DEFAULT_REFERENCE);
+    engine->retuneWheels(plugin->frequencies, STROBE_NOTES);
+    plugin->lastNote = -1.0f;
+    plugin->lastInstability = 1.0f;
+    return((LV2_Handle)plugin);
+}
+
+static void connectPort(LV2_Handle instance, uint32_t port, void *data)
+{
+    StrobePlugin *plugin = (StrobePlugin *)instance;
+    switch ((PortIndex)port) {
+        case PortInput: plugin->input = (const float *)data; break;
+        case PortOutput: plugin->output = (float *)data; break;
+        case PortReference: plugin->reference = (const float *)data; break;
+        case PortNote: plugin->note = (float *)data; break;
+        case PortFrequency: plugin->frequency = (float *)data; break;
+        case PortCents: plugin->cents = (float *)data; break;
+        case PortInstability: plugin->instability = (float *)data; break;
+        case PortAmplitude: plugin->amplitude = (float *)data; break;
+        case PortTracking: plugin->tracking = (float *)data; break;
+        default: break;
+    }
+}
+
+static void activate(LV2_Handle instance)
+{
+    StrobePlugin *plugin = (StrobePlugin *)instance;
+    plugin->engine->clearWheels();
+}
+
+static void run(LV2_Handle instance, uint32_t sampleCount)
+{
+    StrobePlugin *plugin = (StrobePlugin *)instance;
+    StrobeEngine *engine = plugin->engine;
+    // follow the reference, which only moves the wheels since their bin
+    //  counts are fixed
+    if (plugin->reference != NULL) {
+        float reference = clampReference(*plugin->reference);
+        if (reference != plugin->tunedReference) {
+            planFrequencies(plugin, reference);
+            engine->retuneWheels(plugin->frequencies, STROBE_NOTES);
+        }
+    }
+    // analyze the block, finishing as many windows as it completes
+    const float *samples = plugin->input;
+    int count = (int)sampleCount;
+    int n;
+    while ((samples != NULL) && (count > 0)) {
+        n = engine->fillWindow(samples, count);
+        samples += n;
+        count -= n;
+        if (engine->windowFull()) {
+            engine->finishWindow();
+            reportWheel(plugin);
+        }
+    }
+    // pass the audio through so the plugin can go inline
+    if ((plugin->output != NULL) && (plugin->input != NULL) &&
+        (plugin->output != plugin->input)) {
+        memcpy(plugin->output, plugin->input, sampleCount * sizeof(float));
+    }
+    if (plugin->note != NULL) *plugin->note = plugin->lastNote;
+    if (plugin->frequency != NULL) *plugin->frequency = plugin->lastFrequency;
+    if (plugin->cents != NULL) *plugin->cents = plugin->lastCents;
+    if (plugin->instability != NULL) {
+        *plugin->instability = plugin->lastInstability;
+    }
+    if (plugin->amplitude != NULL) *plugin->amplitude = plugin->lastAmplitude;
+    if (plugin->tracking != NULL) *plugin->tracking = plugin->lastTracking;
+}
+
+static void cleanup(LV2_Handle instance)
+{
+    StrobePlugin *plugin = (StrobePlugin *)instance;
+    delete plugin->engine;
+    delete plugin;
+}
+
+static const LV2_Descriptor descriptor = {
+    STROBE_URI,
+    instantiate,
+    connectPort,
+    activate,
+    run,
+    NULL,
+    cleanup,
+    NULL
+};
+
+LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index)
+{
+    return((index == 0) ? &descriptor : NULL);
+}
@@ -1,11 +1,172 @@
 #include "widget.h"
+#include "offline.h"
+#include "profiler.h"
+#include "tuninglibrary.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include <stdio.h>
+#include <string.h>
 
 int main(int argc, char *argv[])
 {
+    // analyze recordings without a GUI if asked to
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--analyze") == 0) {
+            QCoreApplication a(argc, argv);
+            return(runOffline(a.arguments()));
+        }
+    }
+
     QApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("A strobe tuner for JACK.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("analyze",
+        "Analyze recordings without a GUI (see --analyze --help)."));
+    parser.addOption(QCommandLineOption("overflow",
+        "What to drop when analysis falls behind the input: newest or oldest.",
+        "policy", "newest"));
+    parser.addOption(QCommandLineOption("telemetry",
+        "Append the health of the input as a line of JSON each second to "
+        "this file, or - for standard output.", "file"));
+    parser.addOption(QCommandLineOption("channels",
+        "The number of input ports to analyze, each with its own wheels.",
+        "count", "1"));
+    parser.addOption(QCommandLineOption("channel-scales",
+        "A comma-separated list of the scale for each channel, by name or "
+        "index, where channels left out or empty use the selected scale.",
+        "scales"));
+    parser.addOption(QCommandLineOption("bins",
+        "Give every wheel this many bins per revolution, a power of two from "
+        "16 to 1024, where 0 sizes each wheel to its period at its sample "
+        "rate.", "count", "0"));
+    parser.addOption(QCommandLineOption("noise-gate",
+        "Silence the input while it's quieter than this many dB below full "
+        "scale, so noise between notes stays out of the wheels.", "db"));
+    parser.addOption(QCommandLineOption("no-filter",
+        "Don't band-limit the input to the range of the wheels."));
+    parser.addOption(QCommandLineOption("window",
+        "The length of an analysis window in seconds, which sets how often "
+        "the wheels are shown and sent as OSC.", "seconds", "0.05"));
+    parser.addOption(QCommandLineOption("osc",
+        "Stream the state of the wheels as OSC messages over UDP to a port, "
+        "given as host:port or just a port on this machine.", "address"));
+    parser.addOption(QCommandLineOption("capture",
+        "Record the JACK input to this file, with when each block arrived, "
+        "so it can be replayed.", "file"));
+    parser.addOption(QCommandLineOption("replay",
+        "Replay a recording made with --capture instead of using JACK.",
+        "file"));
+    parser.addOption(QCommandLineOption("replay-speed",
+        "How fast to replay: realtime for the original timing or fast for "
+        "as fast as the analyzer can take it.", "speed", "realtime"));
+    parser.addOption(QCommandLineOption("profile",
+        "Show how long each stage of the pipeline takes over the wheels."));
+    parser.addOption(QCommandLineOption("trace",
+        "Time each stage of the pipeline and write the timings to this file "
+        "on exit as a Chrome trace, which Perfetto can open.", "file"));
+    parser.addOption(QCommandLineOption("split-strings",
+        "Give each channel one string of its scale, as from a hex pickup."));
+    parser.addOption(QCommandLineOption("tunings",
+        "Load Scala scales and instrument presets from this directory.",
+        "directory", TuningLibrary::defaultDirectory()));
+    parser.process(a);
+    ReplaySpeed replaySpeed;
+    QString speed = parser.value("replay-speed");
+    if (speed == "realtime") replaySpeed = ReplayRealTime;
+    else if (speed == "fast") replaySpeed = ReplayFast;
+    else {
+        fprintf(stderr, "Unknown replay speed: %s\n",
+            speed.toUtf8().constData());
+        return(1);
+    }
+    OverflowPolicy overflow;
+    QString policy = parser.value("overflow");
+    if (policy == "newest") overflow = DropNewest;
+    else if (policy == "oldest") overflow = DropOldest;
+    else {
+        fprintf(stderr, "Unknown overflow policy: %s\n",
+            policy.toUtf8().constData());
+        return(1);
+    }
+    float gateDb = PRE_GATE_OFF;
+    if (parser.isSet("noise-gate")) {
+        bool ok;
+        gateDb = parser.value("noise-gate").toFloat(&ok);
+        if (! ok) {
+            fprintf(stderr, "Invalid noise gate level: %s\n",
+                parser.value("noise-gate").toUtf8().constData());
+            return(1);
+        }
+    }
+    bool windowOk;
+    float windowSeconds = parser.value("window").toFloat(&windowOk);
+    if ((! windowOk) || (windowSeconds <= 0.0)) {
+        fprintf(stderr, "The window length must be positive.\n");
+        return(1);
+    }
+    // find the scale for each channel
+    TuningLibrary::setDefaultDirectory(parser.value("tunings"));
+    FrequencyMap freqs;
+    QVector<int> channelScales;
+    QStringList scales = parser.value("channel-scales").split(",");
+    for (int i = 0; i < scales.length(); i++) {
+        QString name = scales.at(i).trimmed();
+        if (name.isEmpty()) {
+            channelScales.append(-1);
+            continue;
+        }
+        channelScales.append(freqs.findScale(name));
+        if (channelScales.last() < 0) {
+            fprintf(stderr, "Unknown scale: %s\n", name.toUtf8().constData());
+            return(1);
+        }
+    }
+    // start timing before any of the threads do work
+    if (parser.isSet("trace")) Profiler::enable();
     Widget w;
+    w.setProfileOverlay(parser.isSet("profile"));
+    w.setOverflowPolicy(overflow);
+    w.setResolution(parser.value("bins").toInt());
+    w.setPreprocessing(! parser.isSet("no-filter"), gateDb);
+    w.setWindowSeconds(windowSeconds);
+    w.setChannels(parser.value("channels").toInt(), channelScales);
+    if (parser.isSet("capture")) w.setCapturePath(parser.value("capture"));
+    if (parser.isSet("replay")) {
+        w.setReplay(parser.value("replay"), replaySpeed);
+    }
+    if (parser.isSet("split-strings")) w.toggleSplit(true);
+    if ((parser.isSet("telemetry")) &&
+        (! w.setTelemetryPath(parser.value("telemetry")))) {
+        fprintf(stderr, "Failed to open telemetry file: %s\n",
+            parser.value("telemetry").toUtf8().constData());
+        return(1);
+    }
+    if (parser.isSet("osc")) {
+        QString address = parser.value("osc");
+        QString host = "localhost";
+        int colon = address.lastIndexOf(':');
+        if (colon >= 0) {
+            host = address.left(colon);
+            address = address.mid(colon + 1);
+        }
+        bool ok;
+        int port = address.toInt(&ok);
+        if ((! ok) || (port <= 0) || (port > 65535) || (! w.setOsc(host, port))) {
+            fprintf(stderr, "Can't send OSC to: %s\n",
+                parser.value("osc").toUtf8().constData());
+            return(1);
+        }
+    }
     w.show();
 
-    return a.exec();
+    int result = a.exec();
+    if ((parser.isSet("trace")) &&
+        (! Profiler::writeTrace(parser.value("trace").toUtf8().constData()))) {
+        fprintf(stderr, "Failed to write trace: %s\n",
+            parser.value("trace").toUtf8().constData());
+    }
+    return(result);
 }
@@ -0,0 +1,180 @@
+#include "octavebank.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#define BANK_SSE 1
+#include <emmintrin.h>
+#endif
+
+// the length of filter history kept between blocks
+#define BANK_HISTORY (BANK_TAPS - 1)
+// the shape of the filter's window, which trades the width of its
+//  transition band for attenuation in its stopband (about 60 dB here)
+#define BANK_KAISER_BETA 5.65
+
+// the zeroth-order modified Bessel function of the first kind, for the
+//  Kaiser window
+static float besselI0(float x)
+{
+    float sum = 1.0, term = 1.0;
+    for (int k = 1; k < 20; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return(sum);
+}
+
+OctaveBank::OctaveBank()
+{
+    levels = 0;
+    for (int l = 0; l < BANK_MAX_LEVELS; l++) {
+        samples[l] = NULL;
+        counts[l] = 0;
+        history[l] = NULL;
+        outputs[l] = NULL;
+        skip[l] = 0;
+    }
+    scratch = NULL;
+    // design a half-band lowpass as a Kaiser-windowed sinc, where every
+    //  other tap is zero except the center one, which is always one half
+    float half = (float)(BANK_TAPS / 2) + 1.0f;
+    float n, x, sum = 0.0;
+    int k;
+    for (k = 0; k < (BANK_TAPS + 1) / 4; k++) {
+        n = (float)((2 * k) + 1);
+        x = n / half;
+        coeffs[k] = sinf(M_PI * n / 2.0) / (M_PI * n) *
+            besselI0(BANK_KAISER_BETA * sqrtf(1.0f - (x * x))) /
+            besselI0(BANK_KAISER_BETA);
+        sum += coeffs[k];
+    }
+    // scale for unity gain at DC
+    for (k = 0; k < (BANK_TAPS + 1) / 4; k++) {
+        coeffs[k] *= 0.25 / sum;
+    }
+}
+
+void OctaveBank::init(int newLevels)
+{
+    if (newLevels < 1) newLevels = 1;
+    if (newLevels > BANK_MAX_LEVELS) newLevels = BANK_MAX_LEVELS;
+    // keep the buffers if there are as many levels as before
+    if ((scratch != NULL) && (newLevels == levels)) {
+        reset();
+        return;
+    }
+    destroy();
+    levels = newLevels;
+    for (int l = 1; l < levels; l++) {
+        history[l] = new float[BANK_HISTORY + (BANK_CHUNK >> (l - 1)) + 1];
+        outputs[l] = new float[(BANK_CHUNK >> l) + 1 + BANK_PENDING];
+        samples[l] = outputs[l];
+    }
+    scratch = new float[(BANK_CHUNK / 2) + 1 + (BANK_HISTORY / 2)];
+    reset();
+}
+
+void OctaveBank::reset()
+{
+    for (int l = 1; l < levels; l++) {
+        memset(history[l], 0, BANK_HISTORY * sizeof(float));
+        skip[l] = 0;
+        counts[l] = 0;
+    }
+}
+
+void OctaveBank::process(const float *input, int count)
+{
+    if (count > BANK_CHUNK) count = BANK_CHUNK;
+    samples[0] = input;
+    counts[0] = count;
+    const float *center, *before, *after;
+    const float *fresh = input;
+    float *buffer, *out;
+    int n = count;
+    int first, outCount, i, k, m;
+    for (int l = 1; l < levels; l++) {
+        // append what the level above just produced to the history
+        buffer = history[l];
+        memcpy(buffer + BANK_HISTORY, fresh, n * sizeof(float));
+        // outputs are centered half the filter length behind the newest
+        //  sample they cover, at every other sample
+        first = BANK_HISTORY + skip[l];
+        outCount = (first < BANK_HISTORY + n) ?
+            ((BANK_HISTORY + n - first + 1) / 2) : 0;
+        center = buffer + first - (BANK_HISTORY / 2);
+        // all nonzero taps other than the center fall on samples between
+        //  the centers, so gather those into a contiguous run, which lets
+        //  each tap be applied to a vector of outputs at once
+        for (i = 0; i < outCount + (BANK_HISTORY / 2); i++) {
+            scratch[i] = center[(2 * i) - (BANK_HISTORY / 2)];
+        }
+        out = outputs[l] + counts[l];
+        for (m = 0; m < outCount; m++) {
+            out[m] = 0.5f * center[2 * m];
+        }
+        // apply the taps to eight outputs at a time, keeping two sets of
+        //  sums so they don't wait on each other
+        m = 0;
+#ifdef BANK_SSE
+        __m128 vc, sum0, sum1;
+        for (; m + 8 <= outCount; m += 8) {
+            sum0 = _mm_loadu_ps(out + m);
+            sum1 = _mm_loadu_ps(out + m + 4);
+            before = scratch + ((BANK_TAPS - 3) / 4) + m;
+            after = scratch + ((BANK_TAPS + 1) / 4) + m;
+            for (k = 0; k < (BANK_TAPS + 1) / 4; k++) {
+                vc = _mm_set1_ps(coeffs[k]);
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(vc,
+                    _mm_add_ps(_mm_loadu_ps(before), _mm_loadu_ps(after))));
+                sum1 = _mm_add_ps(sum1, _mm_mul_ps(vc,
+                    _mm_add_ps(_mm_loadu_ps(before + 4), _mm_loadu_ps(after + 4))));
+                before--;
+                after++;
+            }
+            _mm_storeu_ps(out + m, sum0);
+            _mm_storeu_ps(out + m + 4, sum1);
+        }
+#endif
+        for (; m < outCount; m++) {
+            before = scratch + ((BANK_TAPS - 3) / 4) + m;
+            after = scratch + ((BANK_TAPS + 1) / 4) + m;
+            for (k = 0; k < (BANK_TAPS + 1) / 4; k++) {
+                out[m] += coeffs[k] * (*before + *after);
+                before--;
+                after++;
+            }
+        }
+        // remember where the next block's first output falls and keep the
+        //  end of this block for the next one
+        skip[l] = first + (2 * outCount) - (BANK_HISTORY + n);
+        memmove(buffer, buffer + n, BANK_HISTORY * sizeof(float));
+        // add the new samples to the ones not yet consumed, and feed them
+        //  to the next level
+        counts[l] += outCount;
+        fresh = out;
+        n = outCount;
+    }
+}
+
+void OctaveBank::destroy()
+{
+    for (int l = 1; l < BANK_MAX_LEVELS; l++) {
+        delete[] history[l];
+        delete[] outputs[l];
+        history[l] = NULL;
+        outputs[l] = NULL;
+        samples[l] = NULL;
+        counts[l] = 0;
+    }
+    delete[] scratch;
+    scratch = NULL;
+    levels = 0;
+}
+
+OctaveBank::~OctaveBank()
+{
+    destroy();
+}
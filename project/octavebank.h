@@ -0,0 +1,64 @@
+#ifndef OCTAVEBANK_H
+#define OCTAVEBANK_H
+
+// the most octaves the input can be decimated by
+#define BANK_MAX_LEVELS 10
+// the length of each half-band filter, which must be 4n+3
+#define BANK_TAPS 31
+// the fraction of a level's sample rate that's free of aliasing
+#define BANK_PASSBAND 0.375
+// the most input frames the bank processes at once
+#define BANK_CHUNK 4096
+// the number of samples a level collects before its consumer should take
+//  them, which keeps runs long for levels that get only a few samples from
+//  each block
+#define BANK_PENDING 128
+
+// a cascade of half-band decimators that produces a copy of the input at
+//  each octave below the input rate, so wheels for low notes can process
+//  far fewer samples; level 0 is the input itself and each level after it
+//  has half the sample rate of the one before
+class OctaveBank
+{
+public:
+    OctaveBank();
+    ~OctaveBank();
+    // allocate state for the given number of levels including the input,
+    //  or just clear it if the number hasn't changed
+    void init(int levels);
+    // release all state
+    void destroy();
+    // clear the filter history
+    void reset();
+    // decimate a block of at most BANK_CHUNK input frames into each level,
+    //  where level 0 is always just the block
+    void process(const float *input, int count);
+    // the samples a level has produced since it was last consumed, which
+    //  must happen before it collects more than BANK_PENDING of them
+    const float *levelSamples(int level) { return(samples[level]); }
+    int levelCount(int level) { return(counts[level]); }
+    // mark a level's samples as used
+    void consume(int level) { counts[level] = 0; }
+    // the number of levels including the input
+    int getLevels() { return(levels); }
+
+private:
+    // the number of levels including the input
+    int levels;
+    // the unconsumed output of each level
+    const float *samples[BANK_MAX_LEVELS];
+    int counts[BANK_MAX_LEVELS];
+    // for each level after the input, the filter history followed by the
+    //  block of input from the level above
+    float *history[BANK_MAX_LEVELS];
+    // whether the next output of each level is one sample into its block
+    int skip[BANK_MAX_LEVELS];
+    // output buffers for each level after the input
+    float *outputs[BANK_MAX_LEVELS];
+    // space to gather the samples between filter centers
+    float *scratch;
+    // the nonzero coefficients on one side of the filter's center tap
+    float coeffs[(BANK_TAPS + 1) / 4];
+};
+
+#endif // OCTAVEBANK_H
@@ -0,0 +1,297 @@
+#include "offline.h"
+
+#include <stdio.h>
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+
+#include "audiofile.h"
+#include "strobeengine.h"
+#include "tuninglibrary.h"
+
+// the number of frames to decode at a time
+#define OFFLINE_BLOCK_FRAMES 4096
+
+// quote a string for CSV or JSON output
+static QByteArray quoted(const QString &s, bool json)
+{
+    QByteArray out = s.toUtf8();
+    if (json) {
+        out.replace("\\", "\\\\");
+        out.replace("\"", "\\\"");
+    }
+    else {
+        out.replace("\"", "\"\"");
+    }
+    return("\"" + out + "\"");
+}
+
+OfflineJob::OfflineJob(const QString &inPath, const OfflineOptions *inOptions)
+{
+    path = inPath;
+    options = inOptions;
+    // the caller collects results after the pool is done
+    setAutoDelete(false);
+}
+
+void OfflineJob::run()
+{
+    AudioFile file;
+    if (! file.open(path, options->rawSampleRate)) {
+        error = file.getError();
+        return;
+    }
+    // build wheels for the file's sample rate
+    int wheelCount = options->wheels.length();
+    if (wheelCount == 0) return;
+    float *frequencies = new float[wheelCount];
+    for (int i = 0; i < wheelCount; i++) {
+        frequencies[i] = options->wheels.at(i).frequency;
+    }
+    StrobeEngine engine;
+    engine.autoselect = options->autoselect;
+    engine.setHarmonics(options->harmonics);
+    engine.setResolution(options->resolution);
+    engine.setGating(options->gated);
+    engine.setFolding(options->foldOctaves);
+    engine.setFiltering(options->filtering);
+    engine.setNoiseGate(options->noiseGate);
+    engine.setIntegration(options->integration, options->integrationCycles);
+    int windowFrames = (int)(options->windowSeconds * file.getSampleRate());
+    engine.setWindowFrames(windowFrames);
+    engine.initWheels(frequencies, wheelCount, (float)file.getSampleRate());
+    delete[] frequencies;
+    // pre-format things that don't change between windows
+    QByteArray fileName = quoted(path, options->json);
+    QList<QByteArray> labels;
+    for (int i = 0; i < wheelCount; i++) {
+        labels.append(quoted(options->wheels.at(i).label, options->json));
+    }
+    // decode and analyze the file a block at a time
+    float *block = new float[OFFLINE_BLOCK_FRAMES];
+    qint64 windowIndex = 0;
+    int count, n, best;
+    float *sample;
+    Wheel *wheels;
+    double time;
+    while ((count = file.read(block, OFFLINE_BLOCK_FRAMES)) > 0) {
+        sample = block;
+        while (count > 0) {
+            n = engine.fillWindow(sample, count);
+            sample += n;
+            count -= n;
+            if (! engine.windowFull()) continue;
+            engine.finishWindow();
+            // report the most stable of the selected wheels
+            wheels = engine.getWheels();
+            best = engine.getBestWheel();
+            windowIndex++;
+            time = (double)(windowIndex * windowFrames) /
+                (double)file.getSampleRate();
+            if (best >= 0) {
+                if (options->json) {
+                    if (! result.isEmpty()) result.append(",");
+                    result.append("\n    {\"time\": ");
+                    result.append(QByteArray::number(time, 'f', 4));
+                    result.append(", \"wheel\": ");
+                    result.append(labels.at(best));
+                    result.append(", \"frequency\": ");
+                    result.append(QByteArray::number(wheels[best].frequency, 'g', 7));
+                    result.append(", \"instability\": ");
+                    result.append(QByteArray::number(wheels[best].instability, 'g', 6));
+                    result.append(", \"amplitude\": ");
+                    result.append(QByteArray::number(wheels[best].maxAmplitude, 'g', 6));
+                    if (wheels[best].hasOffset) {
+                        result.append(", \"cents\": ");
+                        result.append(QByteArray::number(wheels[best].cents, 'f', 2));
+                    }
+                    result.append("}");
+                }
+                else {
+                    result.append(fileName);
+                    result.append(",");
+                    result.append(QByteArray::number(time, 'f', 4));
+                    result.append(",");
+                    result.append(labels.at(best));
+                    result.append(",");
+                    result.append(QByteArray::number(wheels[best].frequency, 'g', 7));
+                    result.append(",");
+                    result.append(QByteArray::number(wheels[best].instability, 'g', 6));
+                    result.append(",");
+                    result.append(QByteArray::number(wheels[best].maxAmplitude, 'g', 6));
+                    result.append(",");
+                    if (wheels[best].hasOffset) {
+                        result.append(QByteArray::number(wheels[best].cents, 'f', 2));
+                    }
+                    result.append("\n");
+                }
+            }
+        }
+    }
+    delete[] block;
+    if (options->json) {
+        result.prepend(QByteArray("  {\"file\": ") + fileName +
+            ", \"sampleRate\": " + QByteArray::number(file.getSampleRate()) +
+            ", \"windows\": [");
+        result.append("\n  ]}");
+    }
+}
+
+int runOffline(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Analyze recordings with the strobe tuner without JACK or a GUI.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("analyze",
+        "Analyze files instead of showing the tuner."));
+    parser.addOption(QCommandLineOption(QStringList() << "s" << "scale",
+        "The scale (instrument) to analyze with, by name or index.", "scale", "0"));
+    parser.addOption(QCommandLineOption(QStringList() << "t" << "temperament",
+        "The temperament to use, by name or index.", "temperament", "0"));
+    parser.addOption(QCommandLineOption("ref-pitch",
+        "The reference pitch.", "pitch", "A4"));
+    parser.addOption(QCommandLineOption("ref-freq",
+        "The frequency of the reference pitch in Hz.", "hz", "440"));
+    parser.addOption(QCommandLineOption("window",
+        "The length of an analysis window in seconds.", "seconds", "0.05"));
+    parser.addOption(QCommandLineOption("harmonics",
+        "How many harmonics of each note to analyze, where 0 analyzes every "
+        "note at the file's full sample rate.", "count",
+        QString::number(DEFAULT_HARMONICS)));
+    parser.addOption(QCommandLineOption("bins",
+        "Give every wheel this many bins per revolution, a power of two from "
+        "16 to 1024, where 0 sizes each wheel to its period at its sample "
+        "rate.", "count", "0"));
+    parser.addOption(QCommandLineOption("noise-gate",
+        "Silence the input while it's quieter than this many dB below full "
+        "scale.", "db", QString::number(PRE_GATE_OFF)));
+    parser.addOption(QCommandLineOption("no-filter",
+        "Don't band-limit the input to the range of the wheels."));
+    parser.addOption(QCommandLineOption("integration",
+        "How wheels combine successive windows: window (none), leaky or "
+        "sliding.", "mode", "leaky"));
+    parser.addOption(QCommandLineOption("integration-cycles",
+        "How many cycles of each note to integrate over, up to one second.",
+        "cycles", QString::number(DEFAULT_INTEGRATION_CYCLES)));
+    parser.addOption(QCommandLineOption("raw-rate",
+        "The sample rate of raw float files.", "hz", "48000"));
+    parser.addOption(QCommandLineOption("format",
+        "The output format: csv or json.", "format", "csv"));
+    parser.addOption(QCommandLineOption("no-detect",
+        "Don't detect the closest pitch; report the most stable wheel."));
+    parser.addOption(QCommandLineOption(QStringList() << "o" << "output",
+        "Write results for each file into this directory instead of standard output.",
+        "directory"));
+    parser.addOption(QCommandLineOption(QStringList() << "j" << "jobs",
+        "The number of files to analyze at once (default: all cores).", "count"));
+    parser.addOption(QCommandLineOption("tunings",
+        "Load Scala scales and instrument presets from this directory.",
+        "directory", TuningLibrary::defaultDirectory()));
+    parser.addPositionalArgument("files", "WAV or raw float files to analyze.",
+        "files...");
+    parser.process(arguments);
+    QStringList paths = parser.positionalArguments();
+    if (paths.isEmpty()) {
+        fprintf(stderr, "No files to analyze.\n");
+        return(1);
+    }
+    // configure frequencies
+    TuningLibrary::setDefaultDirectory(parser.value("tunings"));
+    FrequencyMap freqs;
+    int temperament = freqs.findTemperament(parser.value("temperament"));
+    int scale = freqs.findScale(parser.value("scale"));
+    QString refPitch = parser.value("ref-pitch");
+    if (temperament < 0) {
+        fprintf(stderr, "Unknown temperament: %s\n",
+            parser.value("temperament").toUtf8().constData());
+        return(1);
+    }
+    if (scale < 0) {
+        fprintf(stderr, "Unknown scale: %s\n",
+            parser.value("scale").toUtf8().constData());
+        return(1);
+    }
+    if (! freqs.pitches.contains(refPitch)) {
+        fprintf(stderr, "Unknown pitch: %s\n", refPitch.toUtf8().constData());
+        return(1);
+    }
+    freqs.temperamentIndex = temperament;
+    freqs.refPitch = freqs.pitches[refPitch];
+    freqs.refFreq = parser.value("ref-freq").toFloat();
+    freqs.updateFrequencies();
+    OfflineOptions options;
+    Scale chosen = freqs.scale(scale);
+    options.wheels = freqs.wheelsForScale(chosen);
+    options.gated = chosen.autoRange;
+    options.foldOctaves = chosen.foldOctaves;
+    options.autoselect = ! parser.isSet("no-detect");
+    options.windowSeconds = parser.value("window").toFloat();
+    options.rawSampleRate = parser.value("raw-rate").toInt();
+    options.harmonics = parser.value("harmonics").toInt();
+    options.resolution = parser.value("bins").toInt();
+    options.filtering = ! parser.isSet("no-filter");
+    options.noiseGate = parser.value("noise-gate").toFloat();
+    QString integration = parser.value("integration");
+    if (integration == "window") options.integration = IntegrateWindow;
+    else if (integration == "leaky") options.integration = IntegrateLeaky;
+    else if (integration == "sliding") options.integration = IntegrateSliding;
+    else {
+        fprintf(stderr, "Unknown integration mode: %s\n",
+            integration.toUtf8().constData());
+        return(1);
+    }
+    options.integrationCycles = parser.value("integration-cycles").toFloat();
+    options.json = (parser.value("format") == "json");
+    if (options.windowSeconds <= 0.0) {
+        fprintf(stderr, "The window length must be positive.\n");
+        return(1);
+    }
+    // analyze all files in parallel
+    QThreadPool *pool = QThreadPool::globalInstance();
+    if (parser.isSet("jobs")) pool->setMaxThreadCount(parser.value("jobs").toInt());
+    QList<OfflineJob *> jobs;
+    for (int i = 0; i < paths.length(); i++) {
+        jobs.append(new OfflineJob(paths.at(i), &options));
+        pool->start(jobs.last());
+    }
+    pool->waitForDone();
+    // write out results in the order given
+    QString outputDir = parser.value("output");
+    QByteArray header = options.json ? "[\n" :
+        "file,time,wheel,frequency,instability,amplitude,cents\n";
+    QByteArray footer = options.json ? "\n]\n" : "";
+    int status = 0;
+    bool first = true;
+    OfflineJob *job;
+    if (outputDir.isEmpty()) fputs(header.constData(), stdout);
+    for (int i = 0; i < jobs.length(); i++) {
+        job = jobs.at(i);
+        if (! job->error.isEmpty()) {
+            fprintf(stderr, "%s: %s\n", job->path.toUtf8().constData(),
+                job->error.toUtf8().constData());
+            status = 1;
+        }
+        else if (outputDir.isEmpty()) {
+            if ((options.json) && (! first)) fputs(",\n", stdout);
+            fwrite(job->result.constData(), 1, job->result.size(), stdout);
+            first = false;
+        }
+        else {
+            QFile out(QDir(outputDir).filePath(QFileInfo(job->path).completeBaseName() +
+                (options.json ? ".json" : ".csv")));
+            if ((! out.open(QIODevice::WriteOnly)) ||
+                (out.write(header + job->result + footer) < 0)) {
+                fprintf(stderr, "%s: %s\n", out.fileName().toUtf8().constData(),
+                    out.errorString().toUtf8().constData());
+                status = 1;
+            }
+        }
+        delete job;
+    }
+    if (outputDir.isEmpty()) fputs(footer.constData(), stdout);
+    return(status);
+}
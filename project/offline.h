@@ -0,0 +1,63 @@
+#ifndef OFFLINE_H
+#define OFFLINE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QRunnable>
+#include <QString>
+#include <QStringList>
+
+#include "frequencymap.h"
+#include "strobeengine.h"
+
+// settings shared by all files in an offline analysis
+typedef struct {
+    // the wheels to analyze
+    QList<WheelSpec> wheels;
+    // whether to detect the fundamental frequency
+    bool autoselect;
+    // the length of an analysis window in seconds
+    float windowSeconds;
+    // the sample rate of files without a header
+    int rawSampleRate;
+    // how many harmonics of each wheel's frequency to keep when decimating
+    int harmonics;
+    // the fixed number of bins per revolution of every wheel, or 0
+    int resolution;
+    // how wheels combine analysis windows and over how many cycles
+    IntegrationMode integration;
+    float integrationCycles;
+    // whether to only run the wheels near the detected pitch
+    bool gated;
+    // the number of octaves to fold onto each wheel, or zero for none
+    int foldOctaves;
+    // whether to band-limit the input to the range of the wheels and the
+    //  level in dB below which to silence it
+    bool filtering;
+    float noiseGate;
+    // whether to write JSON instead of CSV
+    bool json;
+} OfflineOptions;
+
+// analyzes one recording on a worker thread, collecting the results
+class OfflineJob : public QRunnable
+{
+public:
+    OfflineJob(const QString &inPath, const OfflineOptions *inOptions);
+    // analyze the file
+    void run();
+    // the file to analyze
+    QString path;
+    // the formatted results, without a CSV header or enclosing JSON array
+    QByteArray result;
+    // a description of any error encountered
+    QString error;
+private:
+    const OfflineOptions *options;
+};
+
+// analyze recordings given on the command line without JACK or a GUI,
+//  returning an exit status for the process
+int runOffline(const QStringList &arguments);
+
+#endif // OFFLINE_H
@@ -0,0 +1,270 @@
+#include "oscpublisher.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+// the number of bytes a string takes in an OSC message, which is null
+//  terminated and padded to a multiple of four bytes
+static int oscStringSize(int length)
+{
+    return((length + 4) & ~3);
+}
+
+// write a big-endian 32-bit integer, returning the position after it
+static char *oscInt(char *p, uint32_t value)
+{
+    value = htonl(value);
+    memcpy(p, &value, sizeof(value));
+    return(p + sizeof(value));
+}
+
+static char *oscFloat(char *p, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return(oscInt(p, bits));
+}
+
+// write a padded string, returning the position after it
+static char *oscString(char *p, const char *s, int length)
+{
+    int size = oscStringSize(length);
+    memcpy(p, s, length);
+    memset(p + length, 0, size - length);
+    return(p + size);
+}
+
+// the type tags of a wheel message, where the selected flag and the cents
+//  get filled in for each window
+static const char oscWheelTags[] = ",iisfTfff";
+#define OSC_SELECTED_TAG 5
+#define OSC_CENTS_TAG 8
+
+OscPublisher::OscPublisher()
+{
+    fd = -1;
+    addressLength = 0;
+    sem_init(&ready, 0, 0);
+    stopping = false;
+    for (int i = 0; i < 3; i++) {
+        OscPackets *p = packets.buffer(i);
+        p->data = NULL;
+        p->ends = NULL;
+        p->count = 0;
+    }
+    capacity = 0;
+    headers = NULL;
+    headerStarts = NULL;
+    headerLengths = NULL;
+    groupStarts = NULL;
+    groupCount = 0;
+    wheelCount = 0;
+    current = NULL;
+    position = 0;
+    bundleStart = -1;
+}
+
+bool OscPublisher::open(const char *host, int port)
+{
+    close();
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints, *found;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, service, &hints, &found) != 0) return(false);
+    fd = socket(found->ai_family, SOCK_DGRAM, 0);
+    if (fd >= 0) {
+        memcpy(&address, found->ai_addr, found->ai_addrlen);
+        addressLength = found->ai_addrlen;
+    }
+    freeaddrinfo(found);
+    if (fd < 0) return(false);
+    stopping = false;
+    sender = std::thread(threadMain, this);
+    return(true);
+}
+
+void OscPublisher::close()
+{
+    if (sender.joinable()) {
+        stopping = true;
+        sem_post(&ready);
+        sender.join();
+    }
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+void OscPublisher::plan(int newGroupCount, const int *wheelCounts,
+                        const char * const *labels)
+{
+    std::lock_guard<std::mutex> lock(layoutMutex);
+    destroyPlan();
+    groupCount = newGroupCount;
+    groupStarts = new int[groupCount + 1];
+    wheelCount = 0;
+    for (int g = 0; g < groupCount; g++) {
+        groupStarts[g] = wheelCount;
+        wheelCount += wheelCounts[g];
+    }
+    groupStarts[groupCount] = wheelCount;
+    // measure the part of each message that stays the same
+    int addressSize = oscStringSize(strlen(OSC_WHEEL_ADDRESS));
+    int tagsSize = oscStringSize(strlen(oscWheelTags));
+    int *labelLengths = new int[wheelCount];
+    headerStarts = new int[wheelCount];
+    headerLengths = new int[wheelCount];
+    int i, length, total = 0;
+    for (i = 0; i < wheelCount; i++) {
+        length = strlen(labels[i]);
+        if (length > OSC_MAX_LABEL) {
+            length = OSC_MAX_LABEL;
+            // don't split a UTF-8 character
+            while ((length > 0) && ((labels[i][length] & 0xC0) == 0x80)) length--;
+        }
+        labelLengths[i] = length;
+        headerStarts[i] = total;
+        headerLengths[i] = addressSize + tagsSize + 8 + oscStringSize(length);
+        total += headerLengths[i];
+    }
+    // build them
+    headers = new char[total];
+    char *p = headers;
+    int g;
+    for (g = 0; g < groupCount; g++) {
+        for (i = groupStarts[g]; i < groupStarts[g + 1]; i++) {
+            p = oscString(p, OSC_WHEEL_ADDRESS, strlen(OSC_WHEEL_ADDRESS));
+            p = oscString(p, oscWheelTags, strlen(oscWheelTags));
+            p = oscInt(p, g);
+            p = oscInt(p, i - groupStarts[g]);
+            p = oscString(p, labels[i], labelLengths[i]);
+        }
+    }
+    delete[] labelLengths;
+    // leave room for every message with its size and all of its arguments,
+    //  plus a bundle header for each in case every one needs its own bundle
+    capacity = total + (wheelCount * (4 + 16 + 16));
+    for (i = 0; i < 3; i++) {
+        OscPackets *packet = packets.buffer(i);
+        packet->data = new char[capacity];
+        packet->ends = new int[wheelCount];
+        packet->count = 0;
+    }
+    current = NULL;
+}
+
+void OscPublisher::destroyPlan()
+{
+    for (int i = 0; i < 3; i++) {
+        OscPackets *packet = packets.buffer(i);
+        delete[] packet->data;
+        delete[] packet->ends;
+        packet->data = NULL;
+        packet->ends = NULL;
+        packet->count = 0;
+    }
+    delete[] headers;
+    delete[] headerStarts;
+    delete[] headerLengths;
+    delete[] groupStarts;
+    headers = NULL;
+    headerStarts = NULL;
+    headerLengths = NULL;
+    groupStarts = NULL;
+    groupCount = 0;
+    wheelCount = 0;
+    capacity = 0;
+    current = NULL;
+}
+
+void OscPublisher::begin()
+{
+    current = (headers != NULL) ? packets.writeBuffer() : NULL;
+    if (current == NULL) return;
+    current->count = 0;
+    position = 0;
+    bundleStart = -1;
+}
+
+void OscPublisher::addWheel(int group, int index, float frequency,
+                            bool selected, float instability,
+                            float maxAmplitude, float cents, bool hasOffset)
+{
+    if ((current == NULL) || (group < 0) || (group >= groupCount)) return;
+    int wheel = groupStarts[group] + index;
+    if ((index < 0) || (wheel >= groupStarts[group + 1])) return;
+    int headerLength = headerLengths[wheel];
+    int messageLength = headerLength + (hasOffset ? 16 : 12);
+    // start a new bundle when this one would get too big to send whole
+    if ((bundleStart >= 0) &&
+        (position - bundleStart + 4 + messageLength > OSC_MAX_PACKET)) {
+        endBundle();
+    }
+    char *p = current->data + position;
+    if (bundleStart < 0) {
+        bundleStart = position;
+        memcpy(p, "#bundle", 8);
+        // a time tag of 1 means to act on the bundle immediately
+        p = oscInt(p + 8, 0);
+        p = oscInt(p, 1);
+    }
+    p = oscInt(p, messageLength);
+    memcpy(p, headers + headerStarts[wheel], headerLength);
+    char *tags = p + oscStringSize(strlen(OSC_WHEEL_ADDRESS));
+    tags[OSC_SELECTED_TAG] = selected ? 'T' : 'F';
+    tags[OSC_CENTS_TAG] = hasOffset ? 'f' : 'N';
+    p = oscFloat(p + headerLength, frequency);
+    p = oscFloat(p, instability);
+    p = oscFloat(p, maxAmplitude);
+    if (hasOffset) p = oscFloat(p, cents);
+    position = p - current->data;
+}
+
+void OscPublisher::endBundle()
+{
+    if (bundleStart < 0) return;
+    current->ends[current->count++] = position;
+    bundleStart = -1;
+}
+
+void OscPublisher::publish()
+{
+    if (current == NULL) return;
+    endBundle();
+    packets.publish();
+    current = NULL;
+    if (fd >= 0) sem_post(&ready);
+}
+
+void OscPublisher::threadMain(OscPublisher *publisher)
+{
+    while (true) {
+        while (sem_wait(&publisher->ready) != 0) { }
+        if (publisher->stopping) return;
+        std::lock_guard<std::mutex> lock(publisher->layoutMutex);
+        if (! publisher->packets.hasUpdate()) continue;
+        OscPackets *out = publisher->packets.readBuffer();
+        int start = 0;
+        for (int i = 0; i < out->count; i++) {
+            // if the socket's buffer is full the bundle is dropped, since
+            //  there'll be a fresher one soon
+            sendto(publisher->fd, out->data + start, out->ends[i] - start,
+                   MSG_DONTWAIT | MSG_NOSIGNAL,
+                   (const struct sockaddr *)&publisher->address,
+                   publisher->addressLength);
+            start = out->ends[i];
+        }
+    }
+}
+
+OscPublisher::~OscPublisher()
+{
+    close();
+    destroyPlan();
+    sem_destroy(&ready);
+}
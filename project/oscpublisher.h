@@ -0,0 +1,105 @@
+#ifndef OSCPUBLISHER_H
+#define OSCPUBLISHER_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <semaphore.h>
+#include <sys/socket.h>
+
+#include "triplebuffer.h"
+
+// the OSC address each wheel's state is sent to
+#define OSC_WHEEL_ADDRESS "/jackstrobe/wheel"
+// the largest bundle to send, which fits in one ethernet frame so bundles
+//  don't get fragmented on their way across a network
+#define OSC_MAX_PACKET 1472
+// the longest label to send, in bytes
+#define OSC_MAX_LABEL 64
+
+// a set of encoded OSC bundles, packed end to end
+typedef struct {
+    char *data;
+    // where each bundle ends in the data and how many there are
+    int *ends;
+    int count;
+} OscPackets;
+
+// streams the state of wheels to another program as OSC messages over UDP,
+//  one message per active wheel gathered into bundles; messages are encoded
+//  into buffers laid out ahead of time and sent from a thread of its own,
+//  so publishing never allocates or waits on the network
+//
+// each message is sent to OSC_WHEEL_ADDRESS with the arguments:
+//  i group, i index, s label, f frequency, T/F selected, f instability,
+//  f maxAmplitude, then f cents if there's an offset or N if not
+class OscPublisher
+{
+public:
+    OscPublisher();
+    ~OscPublisher();
+    // start sending to the given host and UDP port, returning false if the
+    //  host can't be found or a socket can't be made
+    bool open(const char *host, int port);
+    // stop sending and close the socket
+    void close();
+    // whether the publisher is sending
+    bool isOpen() { return(fd >= 0); }
+    // lay out messages for a number of groups with the given number of
+    //  wheels each, where labels has the label of every wheel of every
+    //  group in order; this allocates, so call it when the wheels change
+    //  and only from the thread that publishes
+    void plan(int groupCount, const int *wheelCounts,
+              const char * const *labels);
+    // start encoding a new set of messages
+    void begin();
+    // encode the state of a wheel
+    void addWheel(int group, int index, float frequency, bool selected,
+                  float instability, float maxAmplitude,
+                  float cents, bool hasOffset);
+    // hand the encoded messages to the sending thread
+    void publish();
+
+private:
+    // send the latest messages whenever they're published, until closed
+    static void threadMain(OscPublisher *publisher);
+    // release the layout
+    void destroyPlan();
+    // finish the bundle being encoded, if any
+    void endBundle();
+    // the socket to send on, or -1 if closed
+    int fd;
+    // the address to send to
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    // the thread doing the sending, posted to when there's something to
+    //  send, and whether it should exit
+    std::thread sender;
+    sem_t ready;
+    std::atomic<bool> stopping;
+    // held by the sender while it reads a buffer and by plan while it
+    //  replaces them
+    std::mutex layoutMutex;
+    // encoded messages passed to the sender
+    TripleBuffer<OscPackets> packets;
+    // the size of each packet buffer
+    int capacity;
+    // the start of each wheel's message up to its label, which doesn't
+    //  change between windows, with its offset and length
+    char *headers;
+    int *headerStarts;
+    int *headerLengths;
+    // the index of the first wheel of each group, and the numbers of
+    //  groups and wheels
+    int *groupStarts;
+    int groupCount;
+    int wheelCount;
+    // the buffer being encoded, the write position in it, and the start of
+    //  the bundle being encoded or -1 if there isn't one
+    OscPackets *current;
+    int position;
+    int bundleStart;
+};
+
+#endif // OSCPUBLISHER_H
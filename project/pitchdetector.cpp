@@ -0,0 +1,170 @@
+#include "pitchdetector.h"
+
+#include <math.h>
+#include <string.h>
+
+PitchDetector::PitchDetector()
+{
+    rate = 0.0;
+    minLag = 0;
+    maxLag = 0;
+    history = NULL;
+    historySize = 0;
+    writeIndex = 0;
+    filled = 0;
+    fft = NULL;
+    re = NULL;
+    im = NULL;
+    windowRe = NULL;
+    windowIm = NULL;
+    differences = NULL;
+}
+
+void PitchDetector::init(float sampleRate)
+{
+    // keep the buffers if the rate hasn't changed
+    if ((history != NULL) && (sampleRate == rate)) {
+        reset();
+        return;
+    }
+    destroy();
+    rate = sampleRate;
+    minLag = (int)floor(rate / PITCH_MAX_HZ);
+    if (minLag < 2) minLag = 2;
+    maxLag = (int)ceil(rate / PITCH_MIN_HZ);
+    // compare a window as long as the longest period with every lag of it
+    historySize = maxLag * 2;
+    history = new float[historySize];
+    int log2Size = 0;
+    while ((1 << log2Size) < historySize) log2Size++;
+    fft = new FFT(log2Size);
+    int size = fft->getSize();
+    re = new float[size];
+    im = new float[size];
+    windowRe = new float[size];
+    windowIm = new float[size];
+    differences = new float[maxLag + 1];
+    reset();
+}
+
+void PitchDetector::destroy()
+{
+    delete[] history;
+    delete fft;
+    delete[] re;
+    delete[] im;
+    delete[] windowRe;
+    delete[] windowIm;
+    delete[] differences;
+    history = NULL;
+    fft = NULL;
+    re = NULL;
+    im = NULL;
+    windowRe = NULL;
+    windowIm = NULL;
+    differences = NULL;
+    historySize = 0;
+}
+
+void PitchDetector::reset()
+{
+    writeIndex = 0;
+    filled = 0;
+}
+
+void PitchDetector::addSamples(const float *samples, int count)
+{
+    if (historySize == 0) return;
+    // only the end of a long block matters
+    if (count > historySize) {
+        samples += count - historySize;
+        count = historySize;
+    }
+    int n;
+    while (count > 0) {
+        n = historySize - writeIndex;
+        if (n > count) n = count;
+        memcpy(history + writeIndex, samples, n * sizeof(float));
+        writeIndex += n;
+        if (writeIndex >= historySize) writeIndex = 0;
+        samples += n;
+        count -= n;
+        filled += n;
+    }
+    if (filled > historySize) filled = historySize;
+}
+
+float PitchDetector::estimate()
+{
+    if ((historySize == 0) || (filled < historySize)) return(0.0);
+    int size = fft->getSize();
+    int window = maxLag;
+    int lag, i;
+    // unroll the history with the oldest sample first
+    int tail = historySize - writeIndex;
+    memcpy(re, history + writeIndex, tail * sizeof(float));
+    memcpy(re + tail, history, writeIndex * sizeof(float));
+    memset(re + historySize, 0, (size - historySize) * sizeof(float));
+    // there's no pitch in silence
+    float energy = 0.0;
+    for (i = 0; i < historySize; i++) energy += re[i] * re[i];
+    if (energy < PITCH_MIN_RMS * PITCH_MIN_RMS * (float)historySize) return(0.0);
+    // get the energy of the window starting at each lag
+    float windowEnergy = 0.0;
+    for (i = 0; i < window; i++) windowEnergy += re[i] * re[i];
+    differences[0] = windowEnergy;
+    for (lag = 1; lag <= maxLag; lag++) {
+        differences[lag] = differences[lag - 1] -
+            (re[lag - 1] * re[lag - 1]) +
+            (re[lag + window - 1] * re[lag + window - 1]);
+    }
+    // correlate the first window with the whole history, transforming
+    //  both at once as the real and imaginary parts of one signal
+    memcpy(im, re, window * sizeof(float));
+    memset(im + window, 0, (size - window) * sizeof(float));
+    fft->transform(re, im, false);
+    float ar, ai, br, bi;
+    int mirror;
+    for (i = 0; i < size; i++) {
+        // separate the spectra using their conjugate symmetry
+        mirror = (size - i) & (size - 1);
+        ar = 0.5f * (im[i] + im[mirror]);
+        ai = 0.5f * (re[mirror] - re[i]);
+        br = 0.5f * (re[i] + re[mirror]);
+        bi = 0.5f * (im[i] - im[mirror]);
+        windowRe[i] = (ar * br) + (ai * bi);
+        windowIm[i] = (ar * bi) - (ai * br);
+    }
+    fft->transform(windowRe, windowIm, true);
+    // turn the energies into the cumulative mean normalized difference
+    float scale = 1.0 / (float)size;
+    float difference, total = 0.0;
+    differences[0] = 1.0;
+    for (lag = 1; lag <= maxLag; lag++) {
+        difference = windowEnergy + differences[lag] -
+            (2.0f * windowRe[lag] * scale);
+        if (difference < 0.0f) difference = 0.0f;
+        total += difference;
+        differences[lag] = (total > 0.0f) ?
+            difference * (float)lag / total : 1.0f;
+    }
+    // take the first dip below the threshold, which favors the fundamental
+    //  over its subharmonics, and follow it to the bottom
+    for (lag = minLag; lag < maxLag; lag++) {
+        if (differences[lag] < PITCH_THRESHOLD) break;
+    }
+    if (lag >= maxLag) return(0.0);
+    while ((lag + 1 < maxLag) && (differences[lag + 1] < differences[lag])) lag++;
+    // refine the period between samples with a parabola
+    float period = (float)lag;
+    float before = differences[lag - 1];
+    float after = differences[lag + 1];
+    float curve = before - (2.0f * differences[lag]) + after;
+    if (curve > 0.0f) period += 0.5f * (before - after) / curve;
+    return(rate / period);
+}
+
+PitchDetector::~PitchDetector()
+{
+    destroy();
+}
@@ -0,0 +1,61 @@
+#ifndef PITCHDETECTOR_H
+#define PITCHDETECTOR_H
+
+#include "fft.h"
+
+// the range of fundamentals the detector looks for, which covers C0 to B8
+#define PITCH_MIN_HZ 15.0
+#define PITCH_MAX_HZ 8000.0
+// how far the normalized difference must dip at a period to count as a
+//  pitch, where lower is stricter
+#define PITCH_THRESHOLD 0.15
+// the quietest RMS level the detector will find a pitch in
+#define PITCH_MIN_RMS 0.0005
+
+// a coarse estimator of the fundamental frequency of recent input using the
+//  YIN difference function, with the autocorrelation it needs computed by
+//  FFT so an estimate costs two transforms no matter how low the pitch;
+//  it's meant to pick which wheels to run, not to tune with
+class PitchDetector
+{
+public:
+    PitchDetector();
+    ~PitchDetector();
+    // allocate state for input at the given sample rate, or just clear it
+    //  if the rate hasn't changed
+    void init(float sampleRate);
+    // release all state
+    void destroy();
+    // forget all input
+    void reset();
+    // add input samples to the history
+    void addSamples(const float *samples, int count);
+    // estimate the fundamental of the most recent input in Hz, returning
+    //  0 if there's no clear pitch
+    float estimate();
+
+private:
+    // the sample rate of the input
+    float rate;
+    // the range of periods to look for in samples
+    int minLag;
+    int maxLag;
+    // the most recent input, as a ring of maxLag * 2 samples, the next
+    //  position to write to and how much of it has been filled
+    float *history;
+    int historySize;
+    int writeIndex;
+    int filled;
+    // a transform big enough to correlate the whole history, buffers for
+    //  the history and the window being compared with it, and buffers for
+    //  their correlation
+    FFT *fft;
+    float *re;
+    float *im;
+    float *windowRe;
+    float *windowIm;
+    // the cumulative mean normalized difference at each lag
+    float *differences;
+};
+
+#endif // PITCHDETECTOR_H
@@ -0,0 +1,250 @@
+#include "preprocessor.h"
+#include "octavebank.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#define PRE_SSE 1
+#include <emmintrin.h>
+#endif
+
+// the Q of each section of a fourth-order Butterworth filter
+#define PRE_BUTTERWORTH_Q0 0.54119610f
+#define PRE_BUTTERWORTH_Q1 1.30656296f
+// the highest cutoff that's still usable, as a fraction of the sample rate
+#define PRE_MAX_CUTOFF 0.45f
+// filter state smaller than this is flushed to zero between blocks so a
+//  decaying filter never slows down on denormals
+#define PRE_DENORMAL 1.0e-15f
+
+Preprocessor::Preprocessor()
+{
+    plannedRate = 0.0;
+    plannedLow = 0.0;
+    plannedHigh = 0.0;
+    bandLimited = false;
+    filtering = true;
+    gateDb = PRE_GATE_OFF;
+    openPower = 0.0;
+    closePower = 0.0;
+    holdFrames = 0;
+    for (int i = 0; i < PRE_SECTIONS; i++) passSection(i);
+    output = new float[BANK_CHUNK];
+    reset();
+}
+
+void Preprocessor::plan(float sampleRate, float lowCutoff, float highCutoff)
+{
+    if ((lowCutoff <= 0.0) || (lowCutoff >= PRE_MAX_CUTOFF * sampleRate)) {
+        lowCutoff = 0.0;
+    }
+    if ((highCutoff <= 0.0) || (highCutoff >= PRE_MAX_CUTOFF * sampleRate)) {
+        highCutoff = 0.0;
+    }
+    holdFrames = (int)(PRE_GATE_HOLD * sampleRate);
+    if ((sampleRate == plannedRate) && (lowCutoff == plannedLow) &&
+        (highCutoff == plannedHigh)) return;
+    // state from another sample rate means nothing, but when the band
+    //  only moves, as when the wheels are retuned, the sections carry on
+    //  from their state with the new coefficients so the input doesn't
+    //  drop out
+    bool rateChanged = (sampleRate != plannedRate);
+    plannedRate = sampleRate;
+    plannedLow = lowCutoff;
+    plannedHigh = highCutoff;
+    // two sections for each side of the band
+    if (lowCutoff > 0.0) {
+        designSection(0, true, lowCutoff / sampleRate, PRE_BUTTERWORTH_Q0);
+        designSection(1, true, lowCutoff / sampleRate, PRE_BUTTERWORTH_Q1);
+    }
+    else {
+        passSection(0);
+        passSection(1);
+    }
+    if (highCutoff > 0.0) {
+        designSection(2, false, highCutoff / sampleRate, PRE_BUTTERWORTH_Q0);
+        designSection(3, false, highCutoff / sampleRate, PRE_BUTTERWORTH_Q1);
+    }
+    else {
+        passSection(2);
+        passSection(3);
+    }
+    bandLimited = (lowCutoff > 0.0) || (highCutoff > 0.0);
+    if (rateChanged) clearFilter();
+}
+
+void Preprocessor::designSection(int section, bool highpass, float cutoff,
+                                 float q)
+{
+    // from the Audio EQ Cookbook, with the cutoff as a fraction of the
+    //  sample rate
+    float w0 = 2.0f * (float)M_PI * cutoff;
+    float cosine = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+    if (highpass) {
+        b0[section] = 0.5f * (1.0f + cosine) / a0;
+        b1[section] = - (1.0f + cosine) / a0;
+    }
+    else {
+        b0[section] = 0.5f * (1.0f - cosine) / a0;
+        b1[section] = (1.0f - cosine) / a0;
+    }
+    b2[section] = b0[section];
+    a1[section] = -2.0f * cosine / a0;
+    a2[section] = (1.0f - alpha) / a0;
+}
+
+void Preprocessor::passSection(int section)
+{
+    b0[section] = 1.0;
+    b1[section] = 0.0;
+    b2[section] = 0.0;
+    a1[section] = 0.0;
+    a2[section] = 0.0;
+}
+
+void Preprocessor::setFiltering(bool value)
+{
+    if (value != filtering) clearFilter();
+    filtering = value;
+}
+
+void Preprocessor::setGate(float thresholdDb)
+{
+    if (thresholdDb < PRE_GATE_OFF) thresholdDb = PRE_GATE_OFF;
+    gateDb = thresholdDb;
+    // compare mean squares so the gate never needs a square root
+    openPower = powf(10.0f, thresholdDb / 10.0f);
+    closePower = powf(10.0f, (thresholdDb - PRE_GATE_HYSTERESIS) / 10.0f);
+}
+
+void Preprocessor::reset()
+{
+    clearFilter();
+    gateOpen = false;
+    gain = 0.0;
+    holdLeft = 0;
+}
+
+void Preprocessor::clearFilter()
+{
+    for (int i = 0; i < PRE_SECTIONS; i++) {
+        s1[i] = 0.0;
+        s2[i] = 0.0;
+        y[i] = 0.0;
+    }
+}
+
+const float *Preprocessor::process(const float *input, int count)
+{
+    if (! isActive()) return(input);
+    PROFILE_SCOPE(ProfilePreprocess);
+    if (count > BANK_CHUNK) count = BANK_CHUNK;
+    if ((filtering) && (bandLimited)) filter(input, output, count);
+    else memcpy(output, input, count * sizeof(float));
+    if (gateDb > PRE_GATE_OFF) gate(output, count);
+    return(output);
+}
+
+void Preprocessor::filter(const float *input, float *out, int count)
+{
+    int i;
+#ifdef PRE_SSE
+    __m128 vb0 = _mm_loadu_ps(b0);
+    __m128 vb1 = _mm_loadu_ps(b1);
+    __m128 vb2 = _mm_loadu_ps(b2);
+    __m128 va1 = _mm_loadu_ps(a1);
+    __m128 va2 = _mm_loadu_ps(a2);
+    __m128 vs1 = _mm_loadu_ps(s1);
+    __m128 vs2 = _mm_loadu_ps(s2);
+    __m128 vy = _mm_loadu_ps(y);
+    __m128 x;
+    for (i = 0; i < count; i++) {
+        // each section takes the last output of the one before it, and the
+        //  first takes the new sample, so all of them run at once
+        x = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(vy), 4));
+        x = _mm_move_ss(x, _mm_load_ss(input + i));
+        vy = _mm_add_ps(_mm_mul_ps(vb0, x), vs1);
+        vs1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vb1, x), _mm_mul_ps(va1, vy)),
+                         vs2);
+        vs2 = _mm_sub_ps(_mm_mul_ps(vb2, x), _mm_mul_ps(va2, vy));
+        _mm_store_ss(out + i, _mm_shuffle_ps(vy, vy, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+    _mm_storeu_ps(s1, vs1);
+    _mm_storeu_ps(s2, vs2);
+    _mm_storeu_ps(y, vy);
+#else
+    float x[PRE_SECTIONS];
+    int k;
+    for (i = 0; i < count; i++) {
+        // the same staggering as the vector version, so both give the same
+        //  output
+        x[0] = input[i];
+        for (k = 1; k < PRE_SECTIONS; k++) x[k] = y[k - 1];
+        for (k = 0; k < PRE_SECTIONS; k++) {
+            y[k] = (b0[k] * x[k]) + s1[k];
+            s1[k] = (b1[k] * x[k]) - (a1[k] * y[k]) + s2[k];
+            s2[k] = (b2[k] * x[k]) - (a2[k] * y[k]);
+        }
+        out[i] = y[PRE_SECTIONS - 1];
+    }
+#endif
+    for (i = 0; i < PRE_SECTIONS; i++) {
+        if (fabsf(s1[i]) < PRE_DENORMAL) s1[i] = 0.0;
+        if (fabsf(s2[i]) < PRE_DENORMAL) s2[i] = 0.0;
+        if (fabsf(y[i]) < PRE_DENORMAL) y[i] = 0.0;
+    }
+}
+
+void Preprocessor::gate(float *samples, int count)
+{
+    int i, k, n;
+    float power, target, step;
+    for (i = 0; i < count; i += n) {
+        n = (count - i < PRE_GATE_FRAMES) ? count - i : PRE_GATE_FRAMES;
+        // measure the run
+        k = 0;
+        power = 0.0;
+#ifdef PRE_SSE
+        __m128 sum = _mm_setzero_ps();
+        __m128 v;
+        for (; k + 4 <= n; k += 4) {
+            v = _mm_loadu_ps(samples + i + k);
+            sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+        }
+        float sums[4];
+        _mm_storeu_ps(sums, sum);
+        power = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+        for (; k < n; k++) power += samples[i + k] * samples[i + k];
+        power /= (float)n;
+        // open above the threshold and stay open until the signal has been
+        //  below the lower threshold for the hold time
+        if (power >= (gateOpen ? closePower : openPower)) {
+            gateOpen = true;
+            holdLeft = holdFrames;
+        }
+        else if (holdLeft > 0) holdLeft -= n;
+        else gateOpen = false;
+        target = gateOpen ? 1.0f : 0.0f;
+        if (gain == target) {
+            if (target == 0.0f) memset(samples + i, 0, n * sizeof(float));
+            continue;
+        }
+        // fade across the run so opening and closing don't click
+        step = (target - gain) / (float)n;
+        for (k = 0; k < n; k++) {
+            gain += step;
+            samples[i + k] *= gain;
+        }
+        gain = target;
+    }
+}
+
+Preprocessor::~Preprocessor()
+{
+    delete[] output;
+}
@@ -0,0 +1,97 @@
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+// the number of biquad sections in the band-limiting cascade, one for
+//  each lane of a vector
+#define PRE_SECTIONS 4
+// the number of frames the noise gate measures at a time
+#define PRE_GATE_FRAMES 64
+// gate thresholds at or below this many dB turn the gate off
+#define PRE_GATE_OFF -120.0f
+// how far below its threshold in dB the gate closes once it's open
+#define PRE_GATE_HYSTERESIS 6.0f
+// how long the gate stays open after the signal drops, in seconds
+#define PRE_GATE_HOLD 0.1f
+
+// cleans up the input once per block before it's decimated for the wheels:
+//  a cascade of biquads removes DC, rumble and hum below the lowest wheel
+//  and noise above the harmonics of the highest one, and a noise gate
+//  silences the input between notes so noise doesn't build up in the bins;
+//  the sections of the cascade run in the lanes of a vector, each a sample
+//  behind the one before it, which delays the output by PRE_SECTIONS - 1
+//  frames
+class Preprocessor
+{
+public:
+    Preprocessor();
+    ~Preprocessor();
+    // design the cascade to pass the band between two frequencies in Hz,
+    //  where a cutoff of 0 or one past the usable band leaves that side
+    //  open; the filter state is only cleared if the sample rate changes,
+    //  and the gate state is kept
+    void plan(float sampleRate, float lowCutoff, float highCutoff);
+    // set whether to band-limit the input at all
+    void setFiltering(bool value);
+    bool getFiltering() { return(filtering); }
+    // set the level in dB relative to full scale below which the gate
+    //  closes, or PRE_GATE_OFF to pass everything
+    void setGate(float thresholdDb);
+    float getGate() { return(gateDb); }
+    // clear the filter and gate state
+    void reset();
+    // whether there's anything for process to do
+    bool isActive() {
+        return(((filtering) && (bandLimited)) || (gateDb > PRE_GATE_OFF));
+    }
+    // whether the gate is passing the input
+    bool isGateOpen() { return(gateOpen); }
+    // clean up a block of at most BANK_CHUNK frames, returning the cleaned
+    //  copy, which stays valid until the next call
+    const float *process(const float *input, int count);
+
+private:
+    // design one section of the cascade as a Butterworth highpass or
+    //  lowpass with the given Q, or pass it straight through
+    void designSection(int section, bool highpass, float cutoff, float q);
+    void passSection(int section);
+    // clear the filter state without touching the gate
+    void clearFilter();
+    // run the cascade over a block from input to output
+    void filter(const float *input, float *output, int count);
+    // open or close the gate for each run of PRE_GATE_FRAMES frames and
+    //  apply its gain in place
+    void gate(float *samples, int count);
+    // the coefficients of each section, normalized so a0 is 1, arranged so
+    //  section i sits in lane i
+    float b0[PRE_SECTIONS];
+    float b1[PRE_SECTIONS];
+    float b2[PRE_SECTIONS];
+    float a1[PRE_SECTIONS];
+    float a2[PRE_SECTIONS];
+    // the state of each section in transposed direct form II and its most
+    //  recent output, which feeds the next section
+    float s1[PRE_SECTIONS];
+    float s2[PRE_SECTIONS];
+    float y[PRE_SECTIONS];
+    // the design the cascade has, whether any section does anything, and
+    //  whether to use it
+    float plannedRate;
+    float plannedLow;
+    float plannedHigh;
+    bool bandLimited;
+    bool filtering;
+    // the gate threshold in dB and as mean squares to open and close at,
+    //  whether the gate is open, its gain at the end of the last run, and
+    //  how many more frames to hold it open
+    float gateDb;
+    float openPower;
+    float closePower;
+    bool gateOpen;
+    float gain;
+    int holdFrames;
+    int holdLeft;
+    // the cleaned block
+    float *output;
+};
+
+#endif // PREPROCESSOR_H
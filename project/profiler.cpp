@@ -0,0 +1,213 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+std::atomic<bool> Profiler::enabled(false);
+ProfileRing *Profiler::rings = NULL;
+std::atomic<int> Profiler::ringsClaimed(0);
+
+// releases each thread's ring when it exits, so threads started later
+//  (e.g. when JACK reconnects) can reuse it; a key is used rather than a
+//  thread_local with a destructor because setting one doesn't allocate
+static pthread_key_t ringKey;
+
+// the calling thread's ring, whether it's tried to claim one, and its name
+static thread_local ProfileRing *ownRing = NULL;
+static thread_local bool ownRingClaimed = false;
+static thread_local const char *ownName = NULL;
+
+static const char *stageNames[PROFILE_STAGES] = {
+    "jack process",
+    "jack read",
+    "preprocess",
+    "accumulate",
+    "integrate",
+    "normalize",
+    "drift",
+    "stats",
+    "select",
+    "gate",
+    "publish",
+    "paint",
+    "draw wheel"
+};
+
+void Profiler::enable()
+{
+    if (rings == NULL) {
+        rings = new ProfileRing[PROFILE_MAX_THREADS];
+        for (int i = 0; i < PROFILE_MAX_THREADS; i++) {
+            rings[i].written = 0;
+            rings[i].claimedAt = 0;
+            rings[i].inUse = false;
+            rings[i].tid = 0;
+            rings[i].name = NULL;
+        }
+        pthread_key_create(&ringKey, releaseRing);
+    }
+    enabled.store(true, std::memory_order_release);
+}
+
+int64_t Profiler::now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return(((int64_t)t.tv_sec * 1000000000) + t.tv_nsec);
+}
+
+ProfileRing *Profiler::threadRing()
+{
+    if (ownRingClaimed) return(ownRing);
+    if (! enabled.load(std::memory_order_acquire)) return(NULL);
+    ownRingClaimed = true;
+    int index;
+    bool expected;
+    for (index = 0; index < PROFILE_MAX_THREADS; index++) {
+        expected = false;
+        if (rings[index].inUse.compare_exchange_strong(expected, true,
+                std::memory_order_acq_rel)) break;
+    }
+    if (index >= PROFILE_MAX_THREADS) return(NULL);
+    int claimed = ringsClaimed.load(std::memory_order_acquire);
+    while ((claimed <= index) &&
+           (! ringsClaimed.compare_exchange_weak(claimed, index + 1,
+                std::memory_order_acq_rel))) { }
+    ownRing = &rings[index];
+    // hide what an earlier thread left in the ring from this one's track
+    ownRing->claimedAt.store(ownRing->written.load(std::memory_order_relaxed),
+                             std::memory_order_release);
+    ownRing->tid = (int)syscall(SYS_gettid);
+    ownRing->name = ownName;
+    pthread_setspecific(ringKey, ownRing);
+    return(ownRing);
+}
+
+void Profiler::releaseRing(void *ring)
+{
+    // the events stay readable until another thread claims the ring
+    ((ProfileRing *)ring)->inUse.store(false, std::memory_order_release);
+}
+
+void Profiler::record(ProfileStage stage, int64_t start, int64_t end)
+{
+    ProfileRing *ring = threadRing();
+    if (ring == NULL) return;
+    uint64_t n = ring->written.load(std::memory_order_relaxed);
+    ProfileEvent *event = &ring->events[n & (PROFILE_RING_EVENTS - 1)];
+    event->start = start;
+    event->duration = (int32_t)(end - start);
+    event->stage = stage;
+    ring->written.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::nameThread(const char *name)
+{
+    ownName = name;
+    if (ownRing != NULL) ownRing->name = name;
+}
+
+const char *Profiler::stageName(ProfileStage stage)
+{
+    if ((stage < 0) || (stage >= PROFILE_STAGES)) return("unknown");
+    return(stageNames[stage]);
+}
+
+int Profiler::copyEvents(ProfileRing *ring, ProfileEvent *out)
+{
+    uint64_t end = ring->written.load(std::memory_order_acquire);
+    uint64_t begin = (end > PROFILE_RING_EVENTS) ? end - PROFILE_RING_EVENTS : 0;
+    uint64_t claimedAt = ring->claimedAt.load(std::memory_order_acquire);
+    if (claimedAt > begin) begin = std::min(claimedAt, end);
+    for (uint64_t i = begin; i < end; i++) {
+        out[i - begin] = ring->events[i & (PROFILE_RING_EVENTS - 1)];
+    }
+    // the writer may have lapped the oldest events while they were copied,
+    //  including the one it's writing now, so drop those
+    uint64_t after = ring->written.load(std::memory_order_acquire);
+    uint64_t safe = (after >= PROFILE_RING_EVENTS) ?
+        after - PROFILE_RING_EVENTS + 1 : 0;
+    int count = (int)(end - begin);
+    if (safe > begin) {
+        int skip = (safe >= end) ? count : (int)(safe - begin);
+        count -= skip;
+        memmove(out, out + skip, count * sizeof(ProfileEvent));
+    }
+    return(count);
+}
+
+void Profiler::summarize(float seconds, ProfileSummary *summaries)
+{
+    std::vector<int32_t> durations[PROFILE_STAGES];
+    int s, i, count;
+    if (rings != NULL) {
+        int64_t since = now() - (int64_t)(seconds * 1.0e9);
+        ProfileEvent *events = new ProfileEvent[PROFILE_RING_EVENTS];
+        int claimed = std::min(ringsClaimed.load(), PROFILE_MAX_THREADS);
+        for (int r = 0; r < claimed; r++) {
+            count = copyEvents(&rings[r], events);
+            for (i = 0; i < count; i++) {
+                if (events[i].start < since) continue;
+                durations[events[i].stage].push_back(events[i].duration);
+            }
+        }
+        delete[] events;
+    }
+    for (s = 0; s < PROFILE_STAGES; s++) {
+        std::vector<int32_t> &d = durations[s];
+        ProfileSummary *summary = &summaries[s];
+        summary->count = d.size();
+        summary->p50 = 0.0;
+        summary->p99 = 0.0;
+        if (d.empty()) continue;
+        std::sort(d.begin(), d.end());
+        summary->p50 = (float)d[d.size() / 2] / 1000.0;
+        summary->p99 = (float)d[std::min(d.size() - 1,
+                                         (d.size() * 99) / 100)] / 1000.0;
+    }
+}
+
+bool Profiler::writeTrace(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return(false);
+    int pid = (int)getpid();
+    bool first = true;
+    fprintf(f, "{\"traceEvents\":[\n");
+    if (rings != NULL) {
+        ProfileEvent *events = new ProfileEvent[PROFILE_RING_EVENTS];
+        int claimed = std::min(ringsClaimed.load(), PROFILE_MAX_THREADS);
+        for (int r = 0; r < claimed; r++) {
+            ProfileRing *ring = &rings[r];
+            // name the thread's track
+            if (ring->name != NULL) {
+                fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, ring->tid, ring->name);
+                first = false;
+            }
+            int count = copyEvents(ring, events);
+            for (int i = 0; i < count; i++) {
+                const ProfileEvent *event = &events[i];
+                fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"jackstrobe\","
+                    "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%d,\"tid\":%d}",
+                    first ? "" : ",\n",
+                    stageName((ProfileStage)event->stage),
+                    (double)event->start / 1000.0,
+                    (double)event->duration / 1000.0, pid, ring->tid);
+                first = false;
+            }
+        }
+        delete[] events;
+    }
+    fprintf(f, "\n]}\n");
+    return(fclose(f) == 0);
+}
@@ -0,0 +1,130 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+
+#include <stdint.h>
+
+// the number of timings each thread keeps, which must be a power of two
+#define PROFILE_RING_EVENTS 16384
+// the most threads that can record timings at once; threads past this
+//  don't until another one exits
+#define PROFILE_MAX_THREADS 32
+
+// the stages of the pipeline that get timed
+typedef enum {
+    ProfileJackProcess,
+    ProfileJackRead,
+    ProfilePreprocess,
+    ProfileAccumulate,
+    ProfileIntegrate,
+    ProfileNormalize,
+    ProfileDrift,
+    ProfileStats,
+    ProfileSelect,
+    ProfileGate,
+    ProfilePublish,
+    ProfilePaint,
+    ProfileDrawWheel,
+    PROFILE_STAGES
+} ProfileStage;
+
+// one timed run of a stage, in nanoseconds on the monotonic clock
+typedef struct {
+    int64_t start;
+    int32_t duration;
+    int32_t stage;
+} ProfileEvent;
+
+// the spread of recent timings of a stage, in microseconds
+typedef struct {
+    int count;
+    float p50;
+    float p99;
+} ProfileSummary;
+
+// the most recent timings recorded by one thread, which only that thread
+//  writes and any thread can read
+typedef struct {
+    ProfileEvent events[PROFILE_RING_EVENTS];
+    // the number of events ever written, and how many of those were
+    //  written before the current thread claimed the ring
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> claimedAt;
+    // whether a running thread owns the ring
+    std::atomic<bool> inUse;
+    // the thread's id and name for traces
+    int tid;
+    const char *name;
+} ProfileRing;
+
+// records how long stages of the pipeline take into a ring for each thread
+//  without locking or allocating, so it's safe in the realtime thread;
+//  until it's enabled, timing a stage costs one atomic load
+class Profiler
+{
+public:
+    // start recording timings, allocating the rings if needed
+    static void enable();
+    // whether timings are being recorded
+    static bool isEnabled() {
+        return(enabled.load(std::memory_order_relaxed));
+    }
+    // get the time on the monotonic clock in nanoseconds
+    static int64_t now();
+    // record a run of a stage on the calling thread
+    static void record(ProfileStage stage, int64_t start, int64_t end);
+    // name the calling thread in traces
+    static void nameThread(const char *name);
+    // get a readable name for a stage
+    static const char *stageName(ProfileStage stage);
+    // summarize the timings of each stage that started within the given
+    //  number of seconds, filling one summary per stage
+    static void summarize(float seconds, ProfileSummary *summaries);
+    // write all recorded timings to a file as a Chrome trace, which
+    //  Perfetto and chrome://tracing can show; returns false on failure
+    static bool writeTrace(const char *path);
+
+private:
+    // get the ring for the calling thread, claiming a free one the first
+    //  time, or NULL if they're all taken
+    static ProfileRing *threadRing();
+    // give a thread's ring back when the thread exits
+    static void releaseRing(void *ring);
+    // copy the events still in a ring, oldest first, returning how many
+    //  were copied
+    static int copyEvents(ProfileRing *ring, ProfileEvent *out);
+    static std::atomic<bool> enabled;
+    static ProfileRing *rings;
+    // the number of rings that have ever been claimed, which are always
+    //  the first ones
+    static std::atomic<int> ringsClaimed;
+};
+
+// times the enclosing scope as a run of a stage
+class ProfileScope
+{
+public:
+    ProfileScope(ProfileStage inStage) {
+        stage = inStage;
+        start = Profiler::isEnabled() ? Profiler::now() : 0;
+    }
+    ~ProfileScope() {
+        if (start != 0) Profiler::record(stage, start, Profiler::now());
+    }
+private:
+    ProfileStage stage;
+    int64_t start;
+};
+
+// time the rest of the enclosing scope as a run of a stage; define
+//  NO_PROFILING to compile the timers out entirely
+#ifdef NO_PROFILING
+#define PROFILE_SCOPE(stage)
+#else
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profileScope, line)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_NAME(__LINE__)(stage)
+#endif
+
+#endif // PROFILER_H
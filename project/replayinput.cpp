@@ -0,0 +1,140 @@
+#include "replayinput.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// how long to wait for the reader to make room when replaying fast
+#define REPLAY_POLL_USECS 1000
+
+ReplayInput::ReplayInput(const char *path, float bufferSeconds,
+                         ReplaySpeed inSpeed)
+{
+    fd = -1;
+    map = NULL;
+    mapSize = 0;
+    end = 0;
+    speed = inSpeed;
+    blockBuffers = NULL;
+    stopping = false;
+    done = false;
+    // map the recording
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        throw AudioInputException("Failed to open the recording.");
+    }
+    struct stat info;
+    if ((fstat(fd, &info) != 0) ||
+        ((size_t)info.st_size < sizeof(CaptureHeader))) {
+        release();
+        throw AudioInputException("The recording is too short.");
+    }
+    mapSize = info.st_size;
+    void *data = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        map = NULL;
+        release();
+        throw AudioInputException("Failed to map the recording into memory.");
+    }
+    map = (const char *)data;
+    madvise(data, mapSize, MADV_SEQUENTIAL);
+    const CaptureHeader *header = (const CaptureHeader *)map;
+    if ((memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->channels < 1) || (header->sampleRate < 1)) {
+        release();
+        throw AudioInputException("The file isn't a recording of JACK input.");
+    }
+    channels = header->channels;
+    sampleRate = header->sampleRate;
+    // find the end of the last whole block, in case the recording was cut
+    //  short
+    size_t offset = sizeof(CaptureHeader);
+    size_t size;
+    CaptureBlock block;
+    while (offset + sizeof(CaptureBlock) <= mapSize) {
+        memcpy(&block, map + offset, sizeof(block));
+        size = sizeof(CaptureBlock) +
+            ((size_t)block.frames * channels * sizeof(jack_default_audio_sample_t));
+        if (offset + size > mapSize) break;
+        offset += size;
+    }
+    end = offset;
+    if (! initBuffers(bufferSeconds)) {
+        release();
+        throw AudioInputException("Failed to allocate a buffer for replay.");
+    }
+    blockBuffers = new const jack_default_audio_sample_t *[channels];
+    player = std::thread(threadMain, this);
+}
+
+void ReplayInput::threadMain(ReplayInput *input)
+{
+    input->play();
+    input->done = true;
+}
+
+void ReplayInput::play()
+{
+    CaptureBlock block;
+    size_t offset = sizeof(CaptureHeader);
+    const char *audio;
+    uint64_t firstUsecs = 0;
+    struct timespec start, due;
+    int64_t nsecs;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool first = true;
+    while ((offset < end) && (! stopping)) {
+        memcpy(&block, map + offset, sizeof(block));
+        audio = map + offset + sizeof(CaptureBlock);
+        for (int c = 0; c < channels; c++) {
+            blockBuffers[c] = (const jack_default_audio_sample_t *)audio;
+            audio += block.frames * sizeof(jack_default_audio_sample_t);
+        }
+        offset = audio - map;
+        if (speed == ReplayRealTime) {
+            // wait until the block arrived relative to the first one
+            if (first) firstUsecs = block.usecs;
+            nsecs = (int64_t)(block.usecs - firstUsecs) * 1000;
+            due.tv_sec = start.tv_sec + (nsecs / 1000000000);
+            due.tv_nsec = start.tv_nsec + (nsecs % 1000000000);
+            if (due.tv_nsec >= 1000000000) {
+                due.tv_sec++;
+                due.tv_nsec -= 1000000000;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                   &due, NULL) != 0) {
+                if (stopping) return;
+            }
+        }
+        else {
+            // wait for the reader to make room so nothing gets dropped
+            while ((writeSpace() < block.frames) &&
+                   (writeSpace() < capacity) && (! stopping)) {
+                usleep(REPLAY_POLL_USECS);
+            }
+        }
+        first = false;
+        bufferBlock(blockBuffers, block.frames);
+    }
+}
+
+void ReplayInput::release()
+{
+    if (map != NULL) munmap((void *)map, mapSize);
+    map = NULL;
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+ReplayInput::~ReplayInput()
+{
+    if (player.joinable()) {
+        stopping = true;
+        player.join();
+    }
+    release();
+    delete[] blockBuffers;
+}
@@ -0,0 +1,57 @@
+#ifndef REPLAYINPUT_H
+#define REPLAYINPUT_H
+
+#include <atomic>
+#include <thread>
+
+#include <stddef.h>
+
+#include "audioinput.h"
+#include "capture.h"
+
+// how to pace a replay
+typedef enum {
+    // release each block when it arrived in the recording, so the reader
+    //  sees the same timing and drops it would have live
+    ReplayRealTime,
+    // release blocks as fast as the reader takes them without dropping
+    //  any, for regressions and benchmarks
+    ReplayFast
+} ReplaySpeed;
+
+// audio input replayed from a file recorded by JackInput::startCapture,
+//  which feeds the recorded blocks through the same buffers as live input
+//  from a thread of its own
+class ReplayInput : public AudioInput
+{
+private:
+    // the recording, mapped into memory, and where its blocks end
+    int fd;
+    const char *map;
+    size_t mapSize;
+    size_t end;
+    // how to pace the replay
+    ReplaySpeed speed;
+    // the audio of each channel in the block being replayed
+    const jack_default_audio_sample_t **blockBuffers;
+    // the thread doing the replay, whether it should stop, and whether it
+    //  has buffered the whole recording
+    std::thread player;
+    std::atomic<bool> stopping;
+    std::atomic<bool> done;
+    // replay the recording until it's done or stopped
+    static void threadMain(ReplayInput *input);
+    void play();
+    // release the recording
+    void release();
+public:
+    // start replaying a recording with the given buffer length in seconds,
+    //  throwing an AudioInputException if it can't be read
+    ReplayInput(const char *path, float bufferSeconds, ReplaySpeed speed);
+    // whether the whole recording has been buffered
+    bool isDone() { return(done.load()); }
+    // stop replaying and release the recording
+    ~ReplayInput();
+};
+
+#endif // REPLAYINPUT_H
@@ -0,0 +1,932 @@
+#include "strobeengine.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// count the bins of a wheel below zero and the number of times the sign
+//  changes going around it
+static inline void countSignsAny(const float *samples, int count,
+                                 int *unders, int *crossings)
+{
+    int under = 0, crossing = 0;
+    int negative, last = (samples[count - 1] < 0.0f);
+    for (int s = 0; s < count; s++) {
+        negative = (samples[s] < 0.0f);
+        under += negative;
+        crossing += (negative != last);
+        last = negative;
+    }
+    *unders = under;
+    *crossings = crossing;
+}
+
+// the same for fixed-resolution wheels, with the count known at compile time
+template <int LOG2>
+static void countSignsFixed(const float *samples, int, int *unders,
+                            int *crossings)
+{
+    countSignsAny(samples, 1 << LOG2, unders, crossings);
+}
+
+static SignCountFunc signCounterForBins(int binCount)
+{
+    switch (binCount) {
+    case 1 << 4: return(countSignsFixed<4>);
+    case 1 << 5: return(countSignsFixed<5>);
+    case 1 << 6: return(countSignsFixed<6>);
+    case 1 << 7: return(countSignsFixed<7>);
+    case 1 << 8: return(countSignsFixed<8>);
+    case 1 << 9: return(countSignsFixed<9>);
+    case 1 << 10: return(countSignsFixed<10>);
+    default: return(countSignsAny);
+    }
+}
+
+StrobeEngine::StrobeEngine()
+{
+    wheels = NULL;
+    wheelCount = 0;
+    sampleRate = 44100.0;
+    harmonics = DEFAULT_HARMONICS;
+    resolution = 0;
+    nextResolution = 0;
+    foldOctaves = 0;
+    nextFoldOctaves = 0;
+    splat = NULL;
+    countSigns = countSignsAny;
+    integrationMode = IntegrateLeaky;
+    integrationCycles = DEFAULT_INTEGRATION_CYCLES;
+    windowFrames = 1;
+    windowFilled = 0;
+    levels = NULL;
+    binCounts = NULL;
+    phases = NULL;
+    steps = NULL;
+    invSteps = NULL;
+    phaseWords = NULL;
+    increments = NULL;
+    tapLevels = NULL;
+    tapPhases = NULL;
+    tapIncrements = NULL;
+    tapCount = 0;
+    sums = NULL;
+    weights = NULL;
+    ringSums = NULL;
+    ringWeights = NULL;
+    ringSlots = NULL;
+    slots = NULL;
+    totalSums = NULL;
+    totalWeights = NULL;
+    decays = NULL;
+    capacities = NULL;
+    scratch = NULL;
+    gating = false;
+    pitchLevel = 0;
+    detectedPitch = 0.0;
+    autoselect = true;
+    kernel = kernelForType(bestKernelType());
+}
+
+void StrobeEngine::initWheels(const float *frequencies, int count,
+                              float inSampleRate)
+{
+    // lay out the new wheels over the old ones, reusing their memory if
+    //  it's big enough
+    float levelRate;
+    int d;
+    int maxLevel = 0;
+    sampleRate = inSampleRate;
+    wheelCount = count;
+    foldOctaves = (nextFoldOctaves > 1) ? nextFoldOctaves : 0;
+    resolution = wheelResolution(nextResolution, foldOctaves);
+    splat = splatForBins(resolution);
+    countSigns = signCounterForBins(resolution);
+    tapCount = count * foldOctaves;
+    wheelArena.reserve(
+        Arena::bytes(count * sizeof(Wheel)) +
+        Arena::bytes(count * sizeof(double)) +
+        (5 * Arena::bytes(count * sizeof(int))) +
+        (3 * Arena::bytes(count * sizeof(float))) +
+        (2 * Arena::bytes(count * sizeof(uint32_t))) +
+        (6 * Arena::bytes(count * sizeof(float *))) +
+        Arena::bytes(tapCount * sizeof(int)) +
+        (2 * Arena::bytes(tapCount * sizeof(uint32_t))));
+    wheels = wheelArena.take<Wheel>(count);
+    phases = wheelArena.take<double>(count);
+    levels = wheelArena.take<int>(count);
+    binCounts = wheelArena.take<int>(count);
+    ringSlots = wheelArena.take<int>(count);
+    slots = wheelArena.take<int>(count);
+    capacities = wheelArena.take<int>(count);
+    steps = wheelArena.take<float>(count);
+    invSteps = wheelArena.take<float>(count);
+    decays = wheelArena.take<float>(count);
+    phaseWords = wheelArena.take<uint32_t>(count);
+    increments = wheelArena.take<uint32_t>(count);
+    sums = wheelArena.take<float *>(count);
+    weights = wheelArena.take<float *>(count);
+    ringSums = wheelArena.take<float *>(count);
+    ringWeights = wheelArena.take<float *>(count);
+    totalSums = wheelArena.take<float *>(count);
+    totalWeights = wheelArena.take<float *>(count);
+    tapLevels = wheelArena.take<int>(tapCount);
+    tapPhases = wheelArena.take<uint32_t>(tapCount);
+    tapIncrements = wheelArena.take<uint32_t>(tapCount);
+    for (int t = 0; t < tapCount; t++) tapPhases[t] = 0;
+    Wheel *wheel = wheels;
+    for (int i = 0; i < wheelCount; i++) {
+        tuneWheel(i, frequencies[i]);
+        if (wheel->level > maxLevel) maxLevel = wheel->level;
+        // round each wheel up to whole cache lines, which leaves it room to
+        //  be retuned a little lower without moving
+        capacities[i] =
+            Arena::bytes(wheel->sampleCount * sizeof(float)) / sizeof(float);
+        phases[i] = 0.0;
+        phaseWords[i] = 0;
+        wheel->integration = integrationMode;
+        ringSlots[i] = planDecay(i);
+        slots[i] = 0;
+        wheel->maxAmplitude = 0.0;
+        wheel->zeroCrossings = 0;
+        wheel->unders = 0;
+        wheel->overs = 0;
+        wheel->diffIndex = 0;
+        for (d = 0; d < WHEEL_DIFF_COUNT; d++) {
+            wheel->diffs[d] = 0;
+        }
+        wheel->instability = 0.0;
+        wheel->selected = true;
+        wheel->offsetHz = 0.0;
+        wheel->cents = 0.0;
+        wheel->hasOffset = false;
+        wheel->active = ! gating;
+        wheel->hold = 0;
+        if (gating) wheel->selected = false;
+        wheel++;
+    }
+    layoutBins(false);
+    drift.init(binCounts, wheelCount);
+    // detect pitch from the lowest level that still covers the highest
+    //  pitch there's a wheel for
+    pitchLevel = 0;
+    if ((gating) || (foldOctaves > 0)) {
+        levelRate = sampleRate;
+        while ((pitchLevel + 1 < BANK_MAX_LEVELS) &&
+               (PITCH_MAX_HZ <= BANK_PASSBAND * (levelRate / 2.0))) {
+            pitchLevel++;
+            levelRate /= 2.0;
+        }
+        if (pitchLevel > maxLevel) maxLevel = pitchLevel;
+        pitch.init(levelRate);
+    }
+    else pitch.destroy();
+    detectedPitch = 0.0;
+    bank.init(maxLevel + 1);
+    planPreprocessing();
+    clearWheels();
+}
+
+void StrobeEngine::planPreprocessing()
+{
+    float lowest = 0.0, highest = 0.0, frequency;
+    for (int w = 0; w < wheelCount; w++) {
+        frequency = wheels[w].frequency;
+        if (frequency < MIN_WHEEL_FREQUENCY) continue;
+        if ((lowest == 0.0) || (frequency < lowest)) lowest = frequency;
+        if (frequency > highest) highest = frequency;
+    }
+    // folded wheels reach up to their top octave
+    if (foldOctaves > 0) highest *= (float)(1 << (foldOctaves - 1));
+    // keep the harmonics the bank keeps, or everything if it keeps them all
+    pre.plan(sampleRate, lowest * BAND_LOW_RATIO,
+             (harmonics > 0) ? highest * harmonics : 0.0);
+}
+
+int StrobeEngine::planBins(float frequency, int *level, float *step)
+{
+    float period;
+    int binCount;
+    // read from the lowest octave that still has the harmonics we want
+    *level = 0;
+    float levelRate = sampleRate;
+    //  and, for fixed-resolution wheels, at least a sample for every bin
+    //  of a revolution, so no bin goes empty
+    if ((harmonics > 0) && (frequency >= MIN_WHEEL_FREQUENCY)) {
+        while ((*level + 1 < BANK_MAX_LEVELS) &&
+               (frequency * harmonics <= BANK_PASSBAND * (levelRate / 2.0)) &&
+               (frequency * resolution <= levelRate / 2.0)) {
+            (*level)++;
+            levelRate /= 2.0;
+        }
+    }
+    if (resolution > 0) {
+        binCount = resolution;
+        period = (frequency > 0.0) ? levelRate / frequency : 2.0;
+    }
+    else if (frequency >= MIN_WHEEL_FREQUENCY) {
+        period = levelRate / frequency;
+        // the kernel needs a step of more than 2/3 bin per sample
+        if (period < 3.0) period = 3.0;
+        binCount = (int)period - 1;
+    }
+    else {
+        period = 2.0;
+        binCount = 2;
+    }
+    *step = (float)binCount / period;
+    return(binCount);
+}
+
+void StrobeEngine::tuneWheel(int w, float frequency)
+{
+    Wheel *wheel = &wheels[w];
+    int level;
+    float step;
+    int binCount = planBins(frequency, &level, &step);
+    wheel->frequency = frequency;
+    wheel->level = level;
+    levels[w] = level;
+    wheel->sampleCount = binCount;
+    binCounts[w] = binCount;
+    steps[w] = step;
+    invSteps[w] = 1.0 / step;
+    increments[w] = splatIncrement(frequency, sampleRate / (float)(1 << level));
+    // each octave of a folded wheel reads the level that suits it, which
+    //  is the wheel's own level for its lowest octave
+    int t = w * foldOctaves;
+    for (int o = 0; o < foldOctaves; o++, t++) {
+        frequency = wheel->frequency * (float)(1 << o);
+        planBins(frequency, &level, &step);
+        tapLevels[t] = level;
+        tapIncrements[t] =
+            splatIncrement(frequency, sampleRate / (float)(1 << level));
+    }
+}
+
+void StrobeEngine::retuneWheels(const float *frequencies, int count)
+{
+    // a different number of wheels needs a new set
+    if ((wheels == NULL) || (count != wheelCount)) {
+        initWheels(frequencies, count, sampleRate);
+        return;
+    }
+    int w, level, binCount;
+    float step;
+    // make room first for wheels that need more bins than they've had,
+    //  which moves all of them to a bigger arena
+    bool grow = false;
+    for (w = 0; w < wheelCount; w++) {
+        if (frequencies[w] == wheels[w].frequency) continue;
+        binCount = planBins(frequencies[w], &level, &step);
+        if (binCount > capacities[w]) {
+            capacities[w] = binCount;
+            grow = true;
+        }
+    }
+    if (grow) layoutBins(true);
+    int maxLevel = gating ? pitchLevel : 0;
+    for (w = 0; w < wheelCount; w++) {
+        if (frequencies[w] != wheels[w].frequency) {
+            retuneWheel(w, frequencies[w]);
+        }
+        if (levels[w] > maxLevel) maxLevel = levels[w];
+    }
+    // a wheel that moved down an octave may need a level the bank lacks
+    if (maxLevel >= bank.getLevels()) bank.init(maxLevel + 1);
+    planPreprocessing();
+}
+
+void StrobeEngine::retuneWheel(int w, float frequency)
+{
+    Wheel *wheel = &wheels[w];
+    float oldFrequency = wheel->frequency;
+    int oldCount = binCounts[w];
+    tuneWheel(w, frequency);
+    int binCount = binCounts[w];
+    // stretch or squeeze what the wheel has onto the new number of bins,
+    //  keeping the pattern at the same place around it, which
+    //  fixed-resolution wheels never need to do
+    bool resample = (binCount != oldCount);
+    if (resample) {
+        resampleBins(wheel->sampleBuffer, 1, oldCount, binCount);
+        resampleBins(totalSums[w], 1, oldCount, binCount);
+        resampleBins(totalWeights[w], 1, oldCount, binCount);
+        phases[w] = fmod(phases[w] * (double)binCount / (double)oldCount,
+                         (double)binCount);
+    }
+    if (planDecay(w) == ringSlots[w]) {
+        if (resample) {
+            resampleBins(ringSums[w], ringSlots[w], oldCount, binCount);
+            resampleBins(ringWeights[w], ringSlots[w], oldCount, binCount);
+        }
+        sums[w] = ringSums[w] + (slots[w] * binCount);
+        weights[w] = ringWeights[w] + (slots[w] * binCount);
+    }
+    // a sliding window that now covers a different number of windows has
+    //  to start over
+    else planIntegration(w);
+    // stats are counted in bins
+    wheel->unders = wheel->unders * binCount / oldCount;
+    wheel->overs = wheel->overs * binCount / oldCount;
+    for (int d = 0; d < WHEEL_DIFF_COUNT; d++) {
+        wheel->diffs[d] = wheel->diffs[d] * binCount / oldCount;
+    }
+    // the signal hasn't moved, only the wheel
+    if (wheel->hasOffset) {
+        wheel->offsetHz += oldFrequency - frequency;
+        if (frequency + wheel->offsetHz > 0.0) {
+            wheel->cents = 1200.0 *
+                log2f((frequency + wheel->offsetHz) / frequency);
+        }
+        else wheel->hasOffset = false;
+    }
+    drift.retune(w, binCount);
+}
+
+void StrobeEngine::resampleBins(float *bins, int slotCount, int fromCount,
+                                int toCount)
+{
+    memcpy(scratch, bins, slotCount * fromCount * sizeof(float));
+    // interpolate around the wheel, wrapping from the last bin to the first
+    float scale = (float)fromCount / (float)toCount;
+    const float *from = scratch;
+    float *to = bins;
+    float pos, frac;
+    int i, j, k;
+    for (int slot = 0; slot < slotCount; slot++) {
+        for (i = 0; i < toCount; i++) {
+            pos = (float)i * scale;
+            j = (int)pos;
+            frac = pos - (float)j;
+            k = (j + 1 < fromCount) ? j + 1 : 0;
+            *to = from[j] + (frac * (from[k] - from[j]));
+            to++;
+        }
+        from += fromCount;
+    }
+}
+
+void StrobeEngine::layoutBins(bool keep)
+{
+    int w, ring, scratchCount = 0;
+    size_t size = 0;
+    for (w = 0; w < wheelCount; w++) {
+        ring = ringSlots[w] * capacities[w];
+        size += (2 * Arena::bytes(ring * sizeof(float))) +
+            (3 * Arena::bytes(capacities[w] * sizeof(float)));
+        if (ring > scratchCount) scratchCount = ring;
+    }
+    size += Arena::bytes(scratchCount * sizeof(float));
+    // keeping the current contents means copying them out of the old
+    //  arena, so that needs a new one
+    Arena moved;
+    Arena *arena = keep ? &moved : &binArena;
+    arena->reserve(size);
+    // give each wheel everything it uses in one run, in the order wheels
+    //  are processed
+    float *ringSum, *ringWeight, *total, *totalWeight, *samples;
+    int binCount;
+    for (w = 0; w < wheelCount; w++) {
+        binCount = binCounts[w];
+        ring = ringSlots[w] * capacities[w];
+        ringSum = arena->take<float>(ring);
+        ringWeight = arena->take<float>(ring);
+        total = arena->take<float>(capacities[w]);
+        totalWeight = arena->take<float>(capacities[w]);
+        samples = arena->take<float>(capacities[w]);
+        if (! keep) {
+            memset(samples, 0, capacities[w] * sizeof(float));
+        }
+        else {
+            // a wheel whose ring was just resized starts over anyway
+            if (ringSums[w] != NULL) {
+                memcpy(ringSum, ringSums[w],
+                       ringSlots[w] * binCount * sizeof(float));
+                memcpy(ringWeight, ringWeights[w],
+                       ringSlots[w] * binCount * sizeof(float));
+            }
+            memcpy(total, totalSums[w], binCount * sizeof(float));
+            memcpy(totalWeight, totalWeights[w], binCount * sizeof(float));
+            memcpy(samples, wheels[w].sampleBuffer, binCount * sizeof(float));
+        }
+        ringSums[w] = ringSum;
+        ringWeights[w] = ringWeight;
+        totalSums[w] = total;
+        totalWeights[w] = totalWeight;
+        wheels[w].sampleBuffer = samples;
+        sums[w] = ringSum + (slots[w] * binCount);
+        weights[w] = ringWeight + (slots[w] * binCount);
+    }
+    scratch = arena->take<float>(scratchCount);
+    if (keep) binArena.swap(moved);
+}
+
+void StrobeEngine::setHarmonics(int count)
+{
+    harmonics = (count > 0) ? count : 0;
+}
+
+void StrobeEngine::setResolution(int bins)
+{
+    nextResolution = roundResolution(bins);
+}
+
+int StrobeEngine::roundResolution(int bins)
+{
+    if (bins <= 0) return(0);
+    int log2Bins = SPLAT_MIN_LOG2;
+    while ((log2Bins < SPLAT_MAX_LOG2) && ((1 << log2Bins) < bins)) {
+        log2Bins++;
+    }
+    return(1 << log2Bins);
+}
+
+int StrobeEngine::wheelResolution(int bins, int foldOctaves)
+{
+    bins = roundResolution(bins);
+    // octaves can only be added up on the same bins if every wheel has the
+    //  same number of them
+    if ((foldOctaves > 1) && (bins == 0)) bins = FOLD_DEFAULT_BINS;
+    return(bins);
+}
+
+void StrobeEngine::setIntegration(IntegrationMode mode, float cycles)
+{
+    integrationMode = mode;
+    integrationCycles = (cycles > 0.0) ? cycles : 0.0;
+    for (int w = 0; w < wheelCount; w++) {
+        wheels[w].integration = mode;
+    }
+    planIntegrations();
+}
+
+void StrobeEngine::setGating(bool value)
+{
+    gating = value;
+}
+
+void StrobeEngine::setFolding(int octaves)
+{
+    nextFoldOctaves = (octaves > 1) ? octaves : 0;
+}
+
+void StrobeEngine::setWheelIntegration(int index, IntegrationMode mode)
+{
+    if ((index < 0) || (index >= wheelCount)) return;
+    wheels[index].integration = mode;
+    planIntegration(index);
+}
+
+void StrobeEngine::setWindowFrames(int frames)
+{
+    windowFrames = (frames > 0) ? frames : 1;
+    // integration lengths are counted in windows
+    planIntegrations();
+    windowFilled = 0;
+}
+
+int StrobeEngine::planDecay(int w)
+{
+    Wheel *wheel = &wheels[w];
+    // low notes integrate over longer times so they get enough cycles
+    float interval = (float)windowFrames / sampleRate;
+    float seconds = integrationCycles / wheel->frequency;
+    if (seconds > MAX_INTEGRATION_SECONDS) seconds = MAX_INTEGRATION_SECONDS;
+    if (seconds < interval) seconds = interval;
+    wheel->integrationSeconds = seconds;
+    decays[w] = expf(- interval / seconds);
+    // a sliding window keeps one slot for each window it covers plus one
+    //  being filled, while a leaky one only needs the window being filled
+    int windowCount = 0;
+    if (wheel->integration == IntegrateWindow) windowCount = 1;
+    else if (wheel->integration == IntegrateSliding) {
+        windowCount = (int)((seconds / interval) + 0.5);
+        if (windowCount < 1) windowCount = 1;
+    }
+    return(windowCount + 1);
+}
+
+void StrobeEngine::planIntegration(int w)
+{
+    int slotCount = planDecay(w);
+    if (ringSlots[w] != slotCount) {
+        ringSlots[w] = slotCount;
+        ringSums[w] = NULL;
+        ringWeights[w] = NULL;
+        layoutBins(true);
+    }
+    resetIntegration(w);
+}
+
+void StrobeEngine::planIntegrations()
+{
+    int slotCount, w;
+    bool resized = false;
+    for (w = 0; w < wheelCount; w++) {
+        slotCount = planDecay(w);
+        if (ringSlots[w] != slotCount) {
+            ringSlots[w] = slotCount;
+            resized = true;
+        }
+    }
+    // everything starts over, so the arena can be laid out again in place
+    if (resized) layoutBins(false);
+    for (w = 0; w < wheelCount; w++) {
+        resetIntegration(w);
+    }
+}
+
+void StrobeEngine::resetIntegration(int w)
+{
+    int binCount = binCounts[w];
+    memset(ringSums[w], 0, ringSlots[w] * binCount * sizeof(float));
+    memset(ringWeights[w], 0, ringSlots[w] * binCount * sizeof(float));
+    memset(totalSums[w], 0, binCount * sizeof(float));
+    memset(totalWeights[w], 0, binCount * sizeof(float));
+    slots[w] = 0;
+    sums[w] = ringSums[w];
+    weights[w] = ringWeights[w];
+}
+
+void StrobeEngine::clearWheels()
+{
+    windowFilled = 0;
+    pre.reset();
+    bank.reset();
+    pitch.reset();
+    for (int w = 0; w < wheelCount; w++) {
+        resetIntegration(w);
+    }
+}
+
+void StrobeEngine::addSamples(const float *samples, int count)
+{
+    int n;
+    while (count > 0) {
+        n = (count < BANK_CHUNK) ? count : BANK_CHUNK;
+        bank.process(pre.process(samples, n), n);
+        accumulateLevels(false);
+        samples += n;
+        count -= n;
+    }
+}
+
+void StrobeEngine::accumulateLevels(bool all)
+{
+    PROFILE_SCOPE(ProfileAccumulate);
+    // decimated levels only get a few samples from each block, so let them
+    //  build up a run before paying for a call into the kernel
+    bool ready[BANK_MAX_LEVELS];
+    int levelCount = bank.getLevels();
+    int level, w;
+    for (level = 0; level < levelCount; level++) {
+        ready[level] = (bank.levelCount(level) > 0) && ((level == 0) ||
+            (all) || (bank.levelCount(level) >= BANK_PENDING));
+    }
+    if (((gating) || (foldOctaves > 0)) && (ready[pitchLevel])) {
+        pitch.addSamples(bank.levelSamples(pitchLevel),
+                         bank.levelCount(pitchLevel));
+    }
+    // add each octave of a folded wheel onto the same bins, so a signal in
+    //  any of them shows as one cycle around the wheel
+    if (tapCount > 0) {
+        int o, t = 0;
+        for (w = 0; w < wheelCount; w++) {
+            if (! wheels[w].active) {
+                t += foldOctaves;
+                continue;
+            }
+            for (o = 0; o < foldOctaves; o++, t++) {
+                level = tapLevels[t];
+                if (! ready[level]) continue;
+                tapPhases[t] = splat(sums[w], weights[w], tapPhases[t],
+                                     tapIncrements[t],
+                                     bank.levelSamples(level),
+                                     bank.levelCount(level));
+            }
+        }
+    }
+    // add each level's samples to one wheel at a time
+    else for (w = 0; w < wheelCount; w++) {
+        level = levels[w];
+        if ((! ready[level]) || (! wheels[w].active)) continue;
+        if (splat != NULL) {
+            phaseWords[w] = splat(sums[w], weights[w], phaseWords[w],
+                                  increments[w], bank.levelSamples(level),
+                                  bank.levelCount(level));
+        }
+        else {
+            phases[w] = kernel(sums[w], weights[w], binCounts[w], phases[w],
+                               steps[w], invSteps[w], bank.levelSamples(level),
+                               bank.levelCount(level));
+        }
+    }
+    for (level = 0; level < levelCount; level++) {
+        if (ready[level]) bank.consume(level);
+    }
+}
+
+int StrobeEngine::fillWindow(const float *samples, int count)
+{
+    int n = windowFrames - windowFilled;
+    if (n > count) n = count;
+    if (n <= 0) return(0);
+    addSamples(samples, n);
+    windowFilled += n;
+    // make sure every wheel has the whole window before it's finished
+    if (windowFull()) accumulateLevels(true);
+    return(n);
+}
+
+bool StrobeEngine::setKernel(KernelType type)
+{
+    AccumulateFunc func = kernelForType(type);
+    if (func == NULL) return(false);
+    kernel = func;
+    return(true);
+}
+
+void StrobeEngine::finishWindow()
+{
+    integrateWheels();
+    normalizeWheels();
+    estimateDrift();
+    updateStats();
+    selectWheels();
+    gateWheels();
+}
+
+void StrobeEngine::integrateWheels()
+{
+    PROFILE_SCOPE(ProfileIntegrate);
+    float *sum, *weight, *total, *totalWeight, *oldSum, *oldWeight;
+    float decay;
+    int binCount, slot, b;
+    for (int w = 0; w < wheelCount; w++) {
+        if (! wheels[w].active) continue;
+        binCount = binCounts[w];
+        sum = sums[w];
+        weight = weights[w];
+        total = totalSums[w];
+        totalWeight = totalWeights[w];
+        if (ringSlots[w] == 1) {
+            // decay the total and add the window, clearing it as we go
+            decay = decays[w];
+            for (b = 0; b < binCount; b++) {
+                *total = (*total * decay) + *sum;
+                *totalWeight = (*totalWeight * decay) + *weight;
+                *sum = 0.0f;
+                *weight = 0.0f;
+                total++;
+                totalWeight++;
+                sum++;
+                weight++;
+            }
+        }
+        else {
+            // add the window to the total and retire the oldest one, whose
+            //  slot is cleared to take the next window
+            slot = slots[w] + 1;
+            if (slot >= ringSlots[w]) slot = 0;
+            oldSum = ringSums[w] + (slot * binCount);
+            oldWeight = ringWeights[w] + (slot * binCount);
+            slots[w] = slot;
+            sums[w] = oldSum;
+            weights[w] = oldWeight;
+            for (b = 0; b < binCount; b++) {
+                *total += *sum - *oldSum;
+                *totalWeight += *weight - *oldWeight;
+                *oldSum = 0.0f;
+                *oldWeight = 0.0f;
+                total++;
+                totalWeight++;
+                sum++;
+                weight++;
+                oldSum++;
+                oldWeight++;
+            }
+        }
+    }
+    windowFilled = 0;
+}
+
+void StrobeEngine::normalizeWheels()
+{
+    PROFILE_SCOPE(ProfileNormalize);
+    // do post-processing of samples in the wheel
+    Wheel *wheel = wheels;
+    const float *total;
+    const float *weight;
+    float *sample;
+    float maxAmplitude;
+    float amplify;
+    float amplitude;
+    int s, w;
+    for (w = 0; w < wheelCount; w++, wheel++) {
+        if (! wheel->active) continue;
+        maxAmplitude = 0.0;
+        // average integrated samples and get the maximum amplitude; the
+        //  weights have to be the ones actually accumulated, since a window
+        //  only holds a few cycles of a wheel's level, so where each one
+        //  starts decides which bins get one more sample than the rest
+        //  (e.g. 5 or 6 for a 110 Hz wheel), and fixed reciprocals would
+        //  leave that as a pattern of its own
+        total = totalSums[w];
+        weight = totalWeights[w];
+        sample = wheel->sampleBuffer;
+        for (s = 0; s < wheel->sampleCount; s++) {
+            *sample = (*weight > 0.0f) ? *total / *weight : 0.0f;
+            // track the maximum amplitude
+            amplitude = fabsf(*sample);
+            if (amplitude > maxAmplitude) maxAmplitude = amplitude;
+            // advance to the next sample
+            total++;
+            weight++;
+            sample++;
+        }
+        // normalize all samples to compensate for low levels
+        //  (unless we're basically getting silence)
+        if (maxAmplitude > 0.0001) {
+            amplify = 1.0 / maxAmplitude;
+            sample = wheel->sampleBuffer;
+            for (s = 0; s < wheel->sampleCount; s++) {
+                *sample *= amplify;
+                sample++;
+            }
+        }
+        wheel->maxAmplitude = maxAmplitude;
+    }
+}
+
+void StrobeEngine::estimateDrift()
+{
+    PROFILE_SCOPE(ProfileDrift);
+    float interval = (float)windowFrames / sampleRate;
+    float revolutions, offset, frequency;
+    int octave;
+    Wheel *wheel = wheels;
+    for (int w = 0; w < wheelCount; w++, wheel++) {
+        if (! wheel->active) continue;
+        // there's nothing to track in silence
+        if (wheel->maxAmplitude <= 0.0001) {
+            drift.forget(w);
+            wheel->hasOffset = false;
+            continue;
+        }
+        // the octaves below the one a folded wheel is hearing see the
+        //  signal as a harmonic and turn more slowly, so only the first
+        //  harmonic of the pattern can be trusted
+        if (! drift.estimate(w, wheel->sampleBuffer, wheel->sampleCount,
+                             &revolutions, foldOctaves > 0)) continue;
+        // a folded wheel's pattern turns at the rate of the octave it's
+        //  hearing, which only the pitch estimate can tell
+        frequency = wheel->frequency;
+        if (foldOctaves > 0) {
+            octave = (detectedPitch > 0.0) ?
+                (int)floorf(log2f(detectedPitch / frequency) + 0.5f) : -1;
+            if ((octave < 0) || (octave >= foldOctaves)) {
+                wheel->hasOffset = false;
+                continue;
+            }
+            frequency *= (float)(1 << octave);
+        }
+        // the pattern slips backward around the wheel when the signal is
+        //  sharp, by one revolution per second for each Hz
+        offset = - revolutions / interval;
+        wheel->offsetHz = wheel->hasOffset ?
+            0.5 * (wheel->offsetHz + offset) : offset;
+        wheel->cents = 1200.0 *
+            log2f((frequency + wheel->offsetHz) / frequency);
+        wheel->hasOffset = true;
+    }
+}
+
+void StrobeEngine::updateStats()
+{
+    PROFILE_SCOPE(ProfileStats);
+    for (int w = 0; w < wheelCount; w++) {
+        if (wheels[w].active) updateWheelStats(&wheels[w]);
+    }
+}
+
+void StrobeEngine::updateWheelStats(Wheel *wheel)
+{
+    int unders, overs, crossings, diff, diffSum, d;
+    countSigns(wheel->sampleBuffer, wheel->sampleCount, &unders, &crossings);
+    overs = wheel->sampleCount - unders;
+    wheel->zeroCrossings = crossings;
+    diff = abs(wheel->unders - unders) + abs(wheel->overs - overs);
+    wheel->unders = unders;
+    wheel->overs = overs;
+    wheel->diffs[wheel->diffIndex] = diff;
+    wheel->diffIndex = (wheel->diffIndex + 1) % WHEEL_DIFF_COUNT;
+    diffSum = 0;
+    for (d = 0; d < WHEEL_DIFF_COUNT; d++) {
+        diffSum += wheel->diffs[d];
+    }
+    wheel->instability =
+        (float)diffSum / (float)(WHEEL_DIFF_COUNT * wheel->sampleCount);
+}
+
+void StrobeEngine::selectWheels()
+{
+    PROFILE_SCOPE(ProfileSelect);
+    int i;
+    float maxAmplitude = 0.0;
+    for (i = 0; i < wheelCount; i++) {
+        wheels[i].selected = wheels[i].active;
+        if (! wheels[i].active) continue;
+        if (wheels[i].maxAmplitude > maxAmplitude) {
+            maxAmplitude = wheels[i].maxAmplitude;
+        }
+    }
+    if (autoselect) {
+        float cutoff = maxAmplitude * 0.95;
+        int minZC = 1000000;
+        for (i = 0; i < wheelCount; i++) {
+            if (! wheels[i].active) continue;
+            if (wheels[i].maxAmplitude < cutoff) {
+                wheels[i].selected = false;
+            }
+            else if (wheels[i].zeroCrossings < minZC) {
+                minZC = wheels[i].zeroCrossings;
+            }
+        }
+        for (i = 0; i < wheelCount; i++) {
+            if (wheels[i].zeroCrossings > minZC) {
+                wheels[i].selected = false;
+            }
+        }
+    }
+}
+
+int StrobeEngine::getBestWheel()
+{
+    int best = -1;
+    for (int w = 0; w < wheelCount; w++) {
+        if ((wheels[w].selected) && ((best < 0) ||
+             (wheels[w].instability < wheels[best].instability))) {
+            best = w;
+        }
+    }
+    return(best);
+}
+
+void StrobeEngine::gateWheels()
+{
+    if ((! gating) && (foldOctaves == 0)) return;
+    PROFILE_SCOPE(ProfileGate);
+    detectedPitch = pitch.estimate();
+    if (! gating) return;
+    float limit = GATE_SEMITONES / 12.0;
+    Wheel *wheel = wheels;
+    for (int w = 0; w < wheelCount; w++, wheel++) {
+        if ((detectedPitch > 0.0) &&
+            (fabsf(log2f(wheel->frequency / detectedPitch)) <= limit)) {
+            if (! wheel->active) setWheelActive(w, true);
+            wheel->hold = GATE_HOLD_WINDOWS;
+        }
+        else if ((wheel->active) && (--wheel->hold <= 0)) {
+            setWheelActive(w, false);
+        }
+    }
+}
+
+void StrobeEngine::setWheelActive(int w, bool active)
+{
+    Wheel *wheel = &wheels[w];
+    wheel->active = active;
+    wheel->selected = false;
+    // start over from nothing either way
+    planIntegration(w);
+    drift.forget(w);
+    memset(wheel->sampleBuffer, 0, wheel->sampleCount * sizeof(float));
+    wheel->maxAmplitude = 0.0;
+    wheel->zeroCrossings = 0;
+    wheel->unders = 0;
+    wheel->overs = 0;
+    wheel->diffIndex = 0;
+    for (int d = 0; d < WHEEL_DIFF_COUNT; d++) {
+        wheel->diffs[d] = 0;
+    }
+    wheel->instability = 0.0;
+    wheel->hasOffset = false;
+}
+
+void StrobeEngine::destroyWheels()
+{
+    wheels = NULL;
+    wheelCount = 0;
+    wheelArena.release();
+    binArena.release();
+    drift.destroy();
+    bank.destroy();
+    pitch.destroy();
+}
+
+StrobeEngine::~StrobeEngine()
+{
+    destroyWheels();
+}
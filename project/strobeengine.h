@@ -0,0 +1,302 @@
+#ifndef STROBEENGINE_H
+#define STROBEENGINE_H
+
+#include "arena.h"
+#include "strobekernel.h"
+#include "driftestimator.h"
+#include "octavebank.h"
+#include "pitchdetector.h"
+#include "preprocessor.h"
+
+#define WHEEL_DIFF_COUNT 6
+// the lowest frequency a wheel can have, which is low enough for C0; wheels
+//  for lower frequencies are left as tiny placeholders
+#define MIN_WHEEL_FREQUENCY 15.0
+// the number of harmonics of each wheel's frequency to keep by default
+//  when choosing a decimated input for it
+#define DEFAULT_HARMONICS 16
+// the number of cycles of each wheel's frequency to integrate over by
+//  default, and the longest a wheel can integrate over in seconds
+#define DEFAULT_INTEGRATION_CYCLES 16
+#define MAX_INTEGRATION_SECONDS 1.0
+// when gating wheels by pitch, how many semitones from the detected pitch a
+//  wheel can be and still run, and how many windows it keeps running after
+//  the pitch moves away
+#define GATE_SEMITONES 1.5
+#define GATE_HOLD_WINDOWS 10
+// the number of bins per revolution of octave-folded wheels when no fixed
+//  resolution is set
+#define FOLD_DEFAULT_BINS 64
+// how far below the lowest wheel the input is high-passed, as a ratio of
+//  its frequency
+#define BAND_LOW_RATIO 0.5
+
+// counts the bins of a wheel below zero and the sign changes around it
+typedef void (*SignCountFunc)(const float *samples, int count, int *unders,
+                              int *crossings);
+
+// ways a wheel can combine successive analysis windows
+typedef enum {
+    // show only the most recent window
+    IntegrateWindow,
+    // let older windows decay exponentially
+    IntegrateLeaky,
+    // show the exact sum of the most recent windows
+    IntegrateSliding
+} IntegrationMode;
+
+// a structure representing the state of a strobed wheel
+typedef struct {
+    // the fundamental frequency the wheel is spinning at,
+    //  in revolutions per second (i.e. Hz)
+    float frequency;
+    // the octave of decimated input the wheel reads, where each level
+    //  halves the sample rate
+    int level;
+    // the number of wheel segments
+    int sampleCount;
+    // the buffer of wheel segments
+    float *sampleBuffer;
+    // how the wheel combines analysis windows and the time constant or
+    //  length of its integration in seconds
+    IntegrationMode integration;
+    float integrationSeconds;
+    // statistics about the stability of the wheel contents
+    float maxAmplitude;
+    int zeroCrossings;
+    int unders;
+    int overs;
+    int diffs[WHEEL_DIFF_COUNT];
+    int diffIndex;
+    float instability;
+    bool selected;
+    // how far the signal is from the wheel's frequency, estimated from how
+    //  fast the pattern rotates, and whether there's an estimate yet
+    float offsetHz;
+    float cents;
+    bool hasOffset;
+    // whether the wheel is being run, which is always true unless wheels
+    //  are gated by pitch, and how many more windows to keep running it
+    //  without hearing its pitch
+    bool active;
+    int hold;
+} Wheel;
+
+// accumulates audio into a set of strobed wheels and analyzes the result,
+//  independent of where the audio comes from or how the wheels are shown
+class StrobeEngine
+{
+public:
+    StrobeEngine();
+    ~StrobeEngine();
+    // initialize the array of wheel structs for the given frequencies,
+    //  reusing the memory of the last set if it's big enough; setting the
+    //  window length first saves planning integration twice
+    void initWheels(const float *frequencies, int count, float sampleRate);
+    // change the frequencies of the existing wheels, keeping what each one
+    //  has accumulated by resampling it to the new number of bins, and only
+    //  allocating when a wheel needs more bins than it's had before; a
+    //  different number of wheels initializes a new set
+    void retuneWheels(const float *frequencies, int count);
+    // destroy the array of wheel structs and release their memory
+    void destroyWheels();
+    // set how many harmonics of each wheel's frequency its input must
+    //  keep, where 0 runs all wheels at the full sample rate; this takes
+    //  effect the next time wheels are initialized
+    void setHarmonics(int count);
+    // give every wheel a fixed number of bins per revolution, rounded up to
+    //  a power of two from 2^SPLAT_MIN_LOG2 to 2^SPLAT_MAX_LOG2, or pass 0 to
+    //  size each wheel to its period at its sample rate; this takes effect
+    //  the next time wheels are initialized
+    void setResolution(int bins);
+    // the resolution setResolution would use for a number of bins
+    static int roundResolution(int bins);
+    // the resolution wheels get from initWheels for a number of bins and
+    //  of folded octaves, since folded wheels need a fixed one
+    static int wheelResolution(int bins, int foldOctaves);
+    // the fixed number of bins per revolution of the current wheels, or 0
+    //  if it varies
+    int getResolution() { return(resolution); }
+    // set how wheels combine analysis windows and how many cycles of its
+    //  frequency each wheel integrates over, limited to between one window
+    //  and MAX_INTEGRATION_SECONDS; this applies to existing wheels and ones
+    //  initialized later
+    void setIntegration(IntegrationMode mode, float cycles);
+    // set whether to only run the wheels near a coarse estimate of the
+    //  pitch, which makes a large set of wheels cost about as much as a few;
+    //  this takes effect the next time wheels are initialized
+    void setGating(bool value);
+    // whether wheels are gated by pitch
+    bool getGating() { return(gating); }
+    // fold a number of octaves starting at each wheel's frequency into it,
+    //  so that a wheel for each pitch class covers them all, or pass 0 or
+    //  1 for wheels that only read their own frequency; folded wheels have
+    //  a fixed number of bins and cost little more than their top octave;
+    //  this takes effect the next time wheels are initialized
+    void setFolding(int octaves);
+    // the number of octaves folded into each of the current wheels
+    int getFolding() { return(foldOctaves); }
+    // set whether to band-limit the input to the range the wheels cover,
+    //  which is on by default
+    void setFiltering(bool value) { pre.setFiltering(value); }
+    bool getFiltering() { return(pre.getFiltering()); }
+    // set the level in dB relative to full scale below which the input is
+    //  silenced, or PRE_GATE_OFF to pass everything, which is the default
+    void setNoiseGate(float thresholdDb) { pre.setGate(thresholdDb); }
+    float getNoiseGate() { return(pre.getGate()); }
+    // change how one wheel combines analysis windows
+    void setWheelIntegration(int index, IntegrationMode mode);
+    // set the length of an analysis window in samples
+    void setWindowFrames(int frames);
+    // discard everything the wheels have accumulated
+    void clearWheels();
+    // add input samples to all wheels, though wheels that read decimated
+    //  input may not see the last few until the window is full
+    void addSamples(const float *samples, int count);
+    // add input samples up to the end of the current analysis window,
+    //  returning how many were used
+    int fillWindow(const float *samples, int count);
+    // whether the current analysis window is full and ready to finish
+    bool windowFull() { return(windowFilled >= windowFrames); }
+    // integrate and normalize wheel contents, update stats and select
+    //  wheels at the end of an analysis window, pick the wheels to run if
+    //  gating, and begin the next one
+    void finishWindow();
+    // the stages of finishing a window, which can be run separately
+    void integrateWheels();
+    void normalizeWheels();
+    void estimateDrift();
+    void updateStats();
+    void selectWheels();
+    void gateWheels();
+    // the most recent coarse pitch estimate in Hz when gating or folding,
+    //  or 0 if there's no clear pitch
+    float getPitch() { return(detectedPitch); }
+    // use a particular accumulation kernel, returning false if the CPU
+    //  doesn't support it
+    bool setKernel(KernelType type);
+    // access the wheels
+    Wheel *getWheels() { return(wheels); }
+    int getWheelCount() { return(wheelCount); }
+    // get the index of the most stable of the selected wheels, or -1 if
+    //  none are selected
+    int getBestWheel();
+    // whether to detect the fundamental frequency
+    bool autoselect;
+
+protected:
+    // work out the level, bin count and step of a wheel at a frequency
+    int planBins(float frequency, int *level, float *step);
+    // set a wheel's frequency and work out its level, bins and step
+    //  without touching its buffers
+    void tuneWheel(int w, float frequency);
+    // move a wheel to a new frequency, resampling its contents
+    void retuneWheel(int w, float frequency);
+    // resample slotCount runs of bins from one count to another in place
+    void resampleBins(float *bins, int slotCount, int fromCount, int toCount);
+    // carve every wheel's buffers out of the bin arena for its capacity and
+    //  ring slots, keeping their contents if keep is set
+    void layoutBins(bool keep);
+    // work out a wheel's integration length and decay, returning how many
+    //  ring slots it needs
+    int planDecay(int w);
+    // size the integration state of a wheel for its mode and reset it
+    void planIntegration(int w);
+    // the same for all wheels at once
+    void planIntegrations();
+    // clear a wheel's integration state
+    void resetIntegration(int w);
+    // start or stop running a wheel, clearing its contents
+    void setWheelActive(int w, bool active);
+    // run the kernel for wheels whose level of the filter bank has
+    //  collected enough samples, or for all wheels
+    void accumulateLevels(bool all);
+    // update stats about the date in a wheel
+    void updateWheelStats(Wheel *wheel);
+    // band-limit the input to the range of the current wheels
+    void planPreprocessing();
+
+private:
+    // the list of wheels being analyzed
+    Wheel *wheels;
+    // the number of wheels being analyzed
+    int wheelCount;
+    // the sample rate of the input
+    float sampleRate;
+    // the number of harmonics to keep when decimating
+    int harmonics;
+    // the fixed number of bins per revolution or 0, the kernel for it, and
+    //  the resolution to use for the next set of wheels
+    int resolution;
+    SplatFunc splat;
+    int nextResolution;
+    // the number of octaves folded into each wheel and the number for the
+    //  next set of wheels
+    int foldOctaves;
+    int nextFoldOctaves;
+    // counts signs for stats, specialized for fixed-resolution wheels
+    SignCountFunc countSigns;
+    // the integration mode and length for new wheels
+    IntegrationMode integrationMode;
+    float integrationCycles;
+    // the length of an analysis window and how much of it has been filled
+    int windowFrames;
+    int windowFilled;
+    // state used while accumulating, kept as parallel arrays indexed by
+    //  wheel so the kernel doesn't drag the rest of the wheel through cache
+    int *levels;
+    int *binCounts;
+    double *phases;
+    float *steps;
+    float *invSteps;
+    float **sums;
+    float **weights;
+    // the phase and phase increment of fixed-resolution wheels, which are
+    //  used instead of phases and steps
+    uint32_t *phaseWords;
+    uint32_t *increments;
+    // for folded wheels, the level, phase and phase increment of each
+    //  octave of each wheel, with a wheel's octaves together from its own
+    //  frequency up, and the number of octaves of all wheels
+    int *tapLevels;
+    uint32_t *tapPhases;
+    uint32_t *tapIncrements;
+    int tapCount;
+    // integration state for each wheel: a ring of windows, the first of
+    //  which leaky wheels use alone, the slot in the ring being filled,
+    //  the total of the ring or the decayed total, and the leaky decay
+    //  applied each window
+    float **ringSums;
+    float **ringWeights;
+    int *ringSlots;
+    int *slots;
+    float **totalSums;
+    float **totalWeights;
+    float *decays;
+    // the most bins each wheel's buffers can hold, and working space for
+    //  resampling them when wheels are retuned
+    int *capacities;
+    float *scratch;
+    // memory for the wheels and the arrays above, and for every wheel's
+    //  bins and the scratch space, each laid out in one block that's
+    //  reused as long as it's big enough
+    Arena wheelArena;
+    Arena binArena;
+    // cleans up the input before it's decimated
+    Preprocessor pre;
+    // decimates the input for wheels that don't need the full rate
+    OctaveBank bank;
+    // whether wheels are gated by pitch, the level of the bank the pitch
+    //  is detected from, the detector and its latest estimate, which
+    //  folded wheels also use to tell which octave they're hearing
+    bool gating;
+    int pitchLevel;
+    PitchDetector pitch;
+    float detectedPitch;
+    // the accumulation kernel for this CPU
+    AccumulateFunc kernel;
+    // estimates the rotation of each wheel
+    DriftEstimator drift;
+};
+
+#endif // STROBEENGINE_H
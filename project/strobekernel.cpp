@@ -0,0 +1,410 @@
+#include "strobekernel.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+// the largest block processed with one phase, which keeps bin positions
+//  within float precision of the phase arithmetic
+#define KERNEL_CHUNK 4096
+// the largest deviation of averaged bins from the reference kernel tolerated
+//  by checks, as a fraction of full scale; the kernels can disagree about
+//  samples that land within float rounding of a bin boundary
+#define KERNEL_TOLERANCE 0.02
+
+// process a run of consecutive bins, with m being the bin's index relative
+//  to the start of the current chunk of n samples and f being the fractional
+//  phase at the start of the chunk
+typedef void (*RunFunc)(float *sums, float *weights, int m, int run,
+    float f, float invStep, const float *input, int n);
+
+// get the index of the first sample of a chunk landing in the bin at m
+static inline int firstSample(int m, float f, float invStep)
+{
+    float k = ceilf(((float)m - f) * invStep);
+    return((k > 0.0f) ? (int)k : 0);
+}
+
+// add the samples landing in one bin
+static inline void addBin(float *sum, float *weight, int m,
+    float f, float invStep, const float *input, int n)
+{
+    int k0 = firstSample(m, f, invStep);
+    int k1 = firstSample(m + 1, f, invStep);
+    if (k1 > n) k1 = n;
+    int c = k1 - k0;
+    float v0 = (c > 0) ? input[k0] : 0.0f;
+    float v1 = (c > 1) ? input[k0 + 1] : 0.0f;
+    *sum += v0 + v1;
+    *weight += (float)c;
+}
+
+static void runScalar(float *sums, float *weights, int m, int run,
+    float f, float invStep, const float *input, int n)
+{
+    for (int i = 0; i < run; i++) {
+        addBin(sums, weights, m, f, invStep, input, n);
+        sums++;
+        weights++;
+        m++;
+    }
+}
+
+#ifdef KERNEL_X86
+
+// SSE2 has no ceiling instruction, but truncation and a correction give the
+//  same integers as ceilf over the range of sample indices
+static inline __m128i firstSampleSSE2(__m128 m, __m128 f, __m128 invStep)
+{
+    __m128 k = _mm_mul_ps(_mm_sub_ps(m, f), invStep);
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(k));
+    t = _mm_add_ps(t, _mm_and_ps(_mm_cmplt_ps(t, k), _mm_set1_ps(1.0f)));
+    return(_mm_cvttps_epi32(_mm_max_ps(t, _mm_setzero_ps())));
+}
+
+static void runSSE2(float *sums, float *weights, int m, int run,
+    float f, float invStep, const float *input, int n)
+{
+    const __m128 vf = _mm_set1_ps(f);
+    const __m128 vinv = _mm_set1_ps(invStep);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i vn = _mm_set1_epi32(n);
+    __m128 vm = _mm_setr_ps((float)m, (float)(m + 1),
+                            (float)(m + 2), (float)(m + 3));
+    int k0[4], c[4];
+    __m128i vk0, vk1, vc;
+    __m128 v0, v1;
+    int i;
+    for (i = 0; i + 4 <= run; i += 4) {
+        vk0 = firstSampleSSE2(vm, vf, vinv);
+        vk1 = firstSampleSSE2(_mm_add_ps(vm, one), vf, vinv);
+        // clamp the end of the range to the chunk (SSE2 has no integer min)
+        vk1 = _mm_sub_epi32(vk1, _mm_and_si128(_mm_cmpgt_epi32(vk1, vn),
+                                               _mm_sub_epi32(vk1, vn)));
+        vc = _mm_sub_epi32(vk1, vk0);
+        _mm_storeu_si128((__m128i *)k0, vk0);
+        _mm_storeu_si128((__m128i *)c, vc);
+        v0 = _mm_setr_ps(
+            (c[0] > 0) ? input[k0[0]] : 0.0f, (c[1] > 0) ? input[k0[1]] : 0.0f,
+            (c[2] > 0) ? input[k0[2]] : 0.0f, (c[3] > 0) ? input[k0[3]] : 0.0f);
+        v1 = _mm_setr_ps(
+            (c[0] > 1) ? input[k0[0] + 1] : 0.0f, (c[1] > 1) ? input[k0[1] + 1] : 0.0f,
+            (c[2] > 1) ? input[k0[2] + 1] : 0.0f, (c[3] > 1) ? input[k0[3] + 1] : 0.0f);
+        _mm_storeu_ps(sums, _mm_add_ps(_mm_loadu_ps(sums), _mm_add_ps(v0, v1)));
+        _mm_storeu_ps(weights,
+            _mm_add_ps(_mm_loadu_ps(weights), _mm_cvtepi32_ps(vc)));
+        vm = _mm_add_ps(vm, _mm_set1_ps(4.0f));
+        sums += 4;
+        weights += 4;
+        m += 4;
+    }
+    runScalar(sums, weights, m, run - i, f, invStep, input, n);
+}
+
+__attribute__((target("avx2")))
+static void runAVX2(float *sums, float *weights, int m, int run,
+    float f, float invStep, const float *input, int n)
+{
+    const __m256 vf = _mm256_set1_ps(f);
+    const __m256 vinv = _mm256_set1_ps(invStep);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i vn = _mm256_set1_epi32(n);
+    const __m256i last = _mm256_set1_epi32(n - 1);
+    const __m256i izero = _mm256_setzero_si256();
+    const __m256i ione = _mm256_set1_epi32(1);
+    __m256 vm = _mm256_setr_ps((float)m, (float)(m + 1), (float)(m + 2),
+        (float)(m + 3), (float)(m + 4), (float)(m + 5), (float)(m + 6),
+        (float)(m + 7));
+    __m256i vk0, vk1, vc;
+    __m256 v0, v1;
+    int i;
+    for (i = 0; i + 8 <= run; i += 8) {
+        vk0 = _mm256_cvttps_epi32(_mm256_max_ps(
+            _mm256_ceil_ps(_mm256_mul_ps(_mm256_sub_ps(vm, vf), vinv)), zero));
+        vk1 = _mm256_cvttps_epi32(_mm256_max_ps(
+            _mm256_ceil_ps(_mm256_mul_ps(
+                _mm256_sub_ps(_mm256_add_ps(vm, one), vf), vinv)), zero));
+        vk1 = _mm256_min_epi32(vk1, vn);
+        vc = _mm256_sub_epi32(vk1, vk0);
+        // gather from clamped indices and mask out samples not in the bin
+        v0 = _mm256_i32gather_ps(input, _mm256_min_epi32(vk0, last), 4);
+        v1 = _mm256_i32gather_ps(input,
+            _mm256_min_epi32(_mm256_add_epi32(vk0, ione), last), 4);
+        v0 = _mm256_and_ps(v0,
+            _mm256_castsi256_ps(_mm256_cmpgt_epi32(vc, izero)));
+        v1 = _mm256_and_ps(v1,
+            _mm256_castsi256_ps(_mm256_cmpgt_epi32(vc, ione)));
+        _mm256_storeu_ps(sums,
+            _mm256_add_ps(_mm256_loadu_ps(sums), _mm256_add_ps(v0, v1)));
+        _mm256_storeu_ps(weights,
+            _mm256_add_ps(_mm256_loadu_ps(weights), _mm256_cvtepi32_ps(vc)));
+        vm = _mm256_add_ps(vm, _mm256_set1_ps(8.0f));
+        sums += 8;
+        weights += 8;
+        m += 8;
+    }
+    // leave the upper halves of the registers clean, or the SSE code that
+    //  follows pays for a state transition on every call
+    _mm256_zeroupper();
+    runScalar(sums, weights, m, run - i, f, invStep, input, n);
+}
+
+#endif // KERNEL_X86
+
+// walk the bins covered by a block, handing runs that don't wrap around
+//  the end of the wheel to a run function
+static double accumulate(RunFunc runFunc, float *sums, float *weights,
+    int binCount, double phase, float step, float invStep,
+    const float *input, int count)
+{
+    int n, b, m, last, run;
+    float f;
+    while (count > 0) {
+        n = (count < KERNEL_CHUNK) ? count : KERNEL_CHUNK;
+        b = (int)phase;
+        f = (float)(phase - (double)b);
+        // find the bin the last sample lands in
+        last = (int)(f + (float)(n - 1) * step);
+        while (firstSample(last + 1, f, invStep) <= n - 1) last++;
+        while ((last > 0) && (firstSample(last, f, invStep) > n - 1)) last--;
+        // visit bins in order
+        m = 0;
+        while (m <= last) {
+            run = binCount - b;
+            if (run > last - m + 1) run = last - m + 1;
+            runFunc(sums + b, weights + b, m, run, f, invStep, input, n);
+            m += run;
+            b += run;
+            if (b >= binCount) b = 0;
+        }
+        // advance the phase
+        phase = fmod(phase + (double)n * (double)step, (double)binCount);
+        input += n;
+        count -= n;
+    }
+    return(phase);
+}
+
+static double accumulateScalar(float *sums, float *weights, int binCount,
+    double phase, float step, float invStep, const float *input, int count)
+{
+    return(accumulate(runScalar, sums, weights, binCount, phase, step,
+                      invStep, input, count));
+}
+
+#ifdef KERNEL_X86
+static double accumulateSSE2(float *sums, float *weights, int binCount,
+    double phase, float step, float invStep, const float *input, int count)
+{
+    return(accumulate(runSSE2, sums, weights, binCount, phase, step,
+                      invStep, input, count));
+}
+
+static double accumulateAVX2(float *sums, float *weights, int binCount,
+    double phase, float step, float invStep, const float *input, int count)
+{
+    return(accumulate(runAVX2, sums, weights, binCount, phase, step,
+                      invStep, input, count));
+}
+#endif
+
+// spread samples over pairs of adjacent bins, with the number of bins fixed
+//  at compile time so the bin arithmetic is all shifts and masks
+template <int LOG2>
+static uint32_t splat(float *sums, float *weights, uint32_t phase,
+    uint32_t increment, const float *input, int count)
+{
+    const uint32_t mask = (1u << LOG2) - 1;
+    const int shift = 32 - LOG2;
+    const float scale = 1.0f / (float)(1u << shift);
+    uint32_t b, next;
+    float frac, x, upper;
+    for (int s = 0; s < count; s++) {
+        b = phase >> shift;
+        next = (b + 1) & mask;
+        frac = (float)(phase & ((1u << shift) - 1)) * scale;
+        x = input[s];
+        upper = x * frac;
+        sums[b] += x - upper;
+        sums[next] += upper;
+        weights[b] += 1.0f - frac;
+        weights[next] += frac;
+        phase += increment;
+    }
+    return(phase);
+}
+
+SplatFunc splatForBins(int binCount)
+{
+    switch (binCount) {
+    case 1 << 4: return(splat<4>);
+    case 1 << 5: return(splat<5>);
+    case 1 << 6: return(splat<6>);
+    case 1 << 7: return(splat<7>);
+    case 1 << 8: return(splat<8>);
+    case 1 << 9: return(splat<9>);
+    case 1 << 10: return(splat<10>);
+    default: return(NULL);
+    }
+}
+
+uint32_t splatIncrement(double frequency, double sampleRate)
+{
+    // a revolution is 2^32 steps of phase
+    double increment = floor((frequency / sampleRate) * 4294967296.0 + 0.5);
+    if (increment < 0.0) increment = 0.0;
+    if (increment > 4294967295.0) increment = 4294967295.0;
+    return((uint32_t)increment);
+}
+
+KernelType bestKernelType()
+{
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return(KernelAVX2);
+    if (__builtin_cpu_supports("sse2")) return(KernelSSE2);
+#endif
+    return(KernelScalar);
+}
+
+AccumulateFunc kernelForType(KernelType type)
+{
+    switch (type) {
+#ifdef KERNEL_X86
+    case KernelAVX2:
+        __builtin_cpu_init();
+        if (! __builtin_cpu_supports("avx2")) return(NULL);
+        return(accumulateAVX2);
+    case KernelSSE2:
+        __builtin_cpu_init();
+        if (! __builtin_cpu_supports("sse2")) return(NULL);
+        return(accumulateSSE2);
+#endif
+    case KernelScalar:
+        return(accumulateScalar);
+    default:
+        return(NULL);
+    }
+}
+
+const char *kernelTypeName(KernelType type)
+{
+    switch (type) {
+    case KernelAVX2: return("AVX2");
+    case KernelSSE2: return("SSE2");
+    default: return("scalar");
+    }
+}
+
+void accumulateReference(float *sums, int *counts, int binCount,
+    int *position, float *error, float step, const float *input, int count)
+{
+    int p = *position;
+    float e = *error;
+    int intStep;
+    for (int s = 0; s < count; s++) {
+        sums[p] += input[s];
+        counts[p] += 1;
+        // advance the wheel position
+        e += step;
+        if (e >= 1.0) {
+            intStep = (int)e;
+            p += intStep;
+            e -= (float)intStep;
+        }
+        if (p >= binCount) p -= binCount;
+    }
+    *position = p;
+    *error = e;
+}
+
+bool checkKernel(KernelType type, float *maxDeviation)
+{
+    AccumulateFunc kernel = kernelForType(type);
+    AccumulateFunc scalar = kernelForType(KernelScalar);
+    if (kernel == NULL) return(false);
+    const float sampleRate = 48000.0;
+    const int inputCount = 48000;
+    const int blockSize = 256;
+    const int windowSize = 2400;
+    const float frequencies[] = { 41.2, 55.0, 110.0, 440.0, 1975.5 };
+    const int frequencyCount = sizeof(frequencies) / sizeof(frequencies[0]);
+    float *input = new float[inputCount];
+    bool ok = true;
+    float deviation = 0.0;
+    for (int w = 0; w < frequencyCount; w++) {
+        float period = sampleRate / frequencies[w];
+        int binCount = (int)period - 1;
+        float step = (float)binCount / period;
+        float invStep = 1.0 / step;
+        float *sums = new float[binCount];
+        float *weights = new float[binCount];
+        float *scalarSums = new float[binCount];
+        float *scalarWeights = new float[binCount];
+        float *refSums = new float[binCount];
+        int *refCounts = new int[binCount];
+        // make a second of a harmonic tone slightly sharp of the wheel,
+        //  with a little noise
+        unsigned int seed = 1;
+        float f0 = frequencies[w] * 1.002;
+        for (int s = 0; s < inputCount; s++) {
+            float t = (float)s / sampleRate;
+            seed = (seed * 1103515245) + 12345;
+            input[s] = 0.6 * sin(2.0 * M_PI * f0 * t) +
+                       0.3 * sin(4.0 * M_PI * f0 * t) +
+                       0.1 * sin(6.0 * M_PI * f0 * t) +
+                       0.01 * (((float)((seed >> 16) & 0x7FFF) / 16384.0) - 1.0);
+        }
+        double phase = 0.0, scalarPhase = 0.0;
+        int position = 0;
+        float error = 0.0;
+        for (int start = 0; start + windowSize <= inputCount; start += windowSize) {
+            memset(sums, 0, binCount * sizeof(float));
+            memset(weights, 0, binCount * sizeof(float));
+            memset(scalarSums, 0, binCount * sizeof(float));
+            memset(scalarWeights, 0, binCount * sizeof(float));
+            memset(refSums, 0, binCount * sizeof(float));
+            memset(refCounts, 0, binCount * sizeof(int));
+            for (int s = start; s < start + windowSize; s += blockSize) {
+                int n = start + windowSize - s;
+                if (n > blockSize) n = blockSize;
+                phase = kernel(sums, weights, binCount, phase, step, invStep,
+                               input + s, n);
+                scalarPhase = scalar(scalarSums, scalarWeights, binCount,
+                                     scalarPhase, step, invStep, input + s, n);
+                accumulateReference(refSums, refCounts, binCount,
+                                    &position, &error, step, input + s, n);
+            }
+            // the vector kernels must do exactly what the scalar one does
+            if ((memcmp(sums, scalarSums, binCount * sizeof(float)) != 0) ||
+                (memcmp(weights, scalarWeights, binCount * sizeof(float)) != 0) ||
+                (phase != scalarPhase)) {
+                ok = false;
+            }
+            // the averaged wheel must be close to the reference
+            for (int b = 0; b < binCount; b++) {
+                if (weights[b] > 0.0) sums[b] /= weights[b];
+                if (refCounts[b] > 0) refSums[b] /= (float)refCounts[b];
+            }
+            for (int b = 0; b < binCount; b++) {
+                float d = fabsf(sums[b] - refSums[b]);
+                if (d > deviation) deviation = d;
+            }
+        }
+        delete[] sums;
+        delete[] weights;
+        delete[] scalarSums;
+        delete[] scalarWeights;
+        delete[] refSums;
+        delete[] refCounts;
+    }
+    delete[] input;
+    if (maxDeviation != NULL) *maxDeviation = deviation;
+    return(ok && (deviation <= KERNEL_TOLERANCE));
+}
@@ -0,0 +1,67 @@
+#ifndef STROBEKERNEL_H
+#define STROBEKERNEL_H
+
+#include <stdint.h>
+
+// The accumulation kernel adds a block of input samples into one wheel at a
+//  time. Rather than stepping a float error carry per sample, it works out
+//  which input samples land in each wheel bin from the wheel phase, so bins
+//  are visited in order and can be filled several at a time. Since the wheel
+//  step is always between 2/3 and 1 bin per sample, each bin receives either
+//  one or two samples per visit, and a parallel weight array records how
+//  many so the bins can be averaged at the end of the window.
+
+// the instruction sets the kernel can use
+typedef enum {
+    KernelScalar,
+    KernelSSE2,
+    KernelAVX2
+} KernelType;
+
+// add count input samples to a wheel of binCount bins starting at the given
+//  phase (in bins), returning the phase after the last sample
+typedef double (*AccumulateFunc)(float *sums, float *weights, int binCount,
+    double phase, float step, float invStep, const float *input, int count);
+
+// the range of bin counts fixed-resolution wheels can have, as powers of two
+#define SPLAT_MIN_LOG2 4
+#define SPLAT_MAX_LOG2 10
+
+// Fixed-resolution wheels have a power-of-two number of bins no matter what
+//  the sample rate is, so a sample can land anywhere between bins. Their
+//  phase is a 32-bit fraction of a revolution whose top bits are the bin,
+//  and each sample is spread over that bin and the next by the rest of the
+//  phase. The phase advances by an integer increment per sample and wraps
+//  exactly at the end of a revolution, so the wheel's frequency never
+//  drifts no matter how long it runs.
+
+// add count input samples to a fixed-resolution wheel starting at the given
+//  phase, returning the phase after the last sample
+typedef uint32_t (*SplatFunc)(float *sums, float *weights, uint32_t phase,
+    uint32_t increment, const float *input, int count);
+
+// get the splatting kernel for a number of bins, which is specialized for
+//  each power of two in range, or NULL for any other number
+SplatFunc splatForBins(int binCount);
+// get the phase increment per sample of a fixed-resolution wheel
+uint32_t splatIncrement(double frequency, double sampleRate);
+
+// get the best kernel type supported by the CPU
+KernelType bestKernelType();
+// get the kernel function for a type, or NULL if the CPU doesn't support it
+AccumulateFunc kernelForType(KernelType type);
+// get a readable name for a kernel type
+const char *kernelTypeName(KernelType type);
+
+// the original sample-at-a-time kernel, which advances a bin position and
+//  float error carry for every sample and counts additions per bin
+void accumulateReference(float *sums, int *counts, int binCount,
+    int *position, float *error, float step, const float *input, int count);
+
+// check a kernel type against the scalar kernel and the reference kernel on
+//  synthetic input; the vector kernels must match the scalar kernel bit for
+//  bit, and averaged bins must be within 2% of full scale of the reference,
+//  with maxDeviation receiving the largest deviation seen
+bool checkKernel(KernelType type, float *maxDeviation);
+
+#endif // STROBEKERNEL_H
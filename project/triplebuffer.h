@@ -0,0 +1,50 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// a lock-free triple buffer passing the latest value of T from one writer
+//  thread to one reader thread; the writer never waits for the reader and the
+//  reader always gets the most recently published buffer
+template <typename T>
+class TripleBuffer
+{
+private:
+    // flags the middle index as holding a buffer the reader hasn't seen
+    enum { FRESH = 4, INDEX = 3 };
+    // the three buffers that rotate between writer, reader, and handoff
+    T buffers[3];
+    // the buffer waiting to be picked up, with the fresh flag
+    std::atomic<int> middle;
+    // the buffer owned by the reader
+    int front;
+    // the buffer owned by the writer
+    int back;
+public:
+    TripleBuffer() : middle(1), front(0), back(2) { }
+    // get the buffer the writer can fill (writer thread only)
+    T *writeBuffer() { return(&buffers[back]); }
+    // make the write buffer the latest one (writer thread only)
+    void publish() {
+        int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = old & INDEX;
+    }
+    // whether a buffer has been published since the last read
+    bool hasUpdate() const {
+        return((middle.load(std::memory_order_acquire) & FRESH) != 0);
+    }
+    // get the latest published buffer (reader thread only); if nothing new
+    //  has been published, this is the same buffer as last time
+    T *readBuffer() {
+        if (hasUpdate()) {
+            int old = middle.exchange(front, std::memory_order_acq_rel);
+            front = old & INDEX;
+        }
+        return(&buffers[front]);
+    }
+    // get one of the three buffers regardless of which thread owns it, for
+    //  setting them all up while neither thread is using them
+    T *buffer(int index) { return(&buffers[index]); }
+};
+
+#endif // TRIPLEBUFFER_H
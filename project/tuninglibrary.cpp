@@ -0,0 +1,493 @@
+#include "tuninglibrary.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <QDebug>
+
+#define TUNING_INDEX_MAGIC "JSTUNING"
+
+// the directory set on the command line, or empty for the default
+static QString libraryDirectory;
+
+QString TuningLibrary::defaultDirectory()
+{
+    if (! libraryDirectory.isEmpty()) return(libraryDirectory);
+    return(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+           "/tunings");
+}
+
+void TuningLibrary::setDefaultDirectory(const QString &path)
+{
+    libraryDirectory = path;
+}
+
+TuningLibrary::TuningLibrary()
+{
+    data = NULL;
+    size = 0;
+    temperaments = 0;
+    scales = 0;
+}
+
+// read the lines of a file that aren't comments, which start with "!" in
+//  Scala files and in instrument presets
+static bool readLines(const QString &path, QStringList *lines)
+{
+    QFile file(path);
+    if (! file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Failed to read" << path << ":" << file.errorString();
+        return(false);
+    }
+    QTextStream stream(&file);
+    QString line;
+    while (! stream.atEnd()) {
+        line = stream.readLine();
+        if (line.startsWith('!')) continue;
+        lines->append(line);
+    }
+    return(true);
+}
+
+// runs of whitespace between words
+static const QRegularExpression whitespace("\\s+");
+
+// get the first word of a line
+static QString firstWord(const QString &line)
+{
+    return(line.trimmed().section(whitespace, 0, 0));
+}
+
+// parse the size of a Scala pitch in cents, given either in cents with a
+//  decimal point or as a ratio, returning false if it isn't either
+static bool parsePitch(const QString &word, float *cents)
+{
+    bool ok;
+    if (word.contains('.')) {
+        *cents = word.toFloat(&ok);
+        return(ok);
+    }
+    double numerator, denominator = 1.0;
+    int slash = word.indexOf('/');
+    if (slash >= 0) {
+        numerator = word.left(slash).toDouble(&ok);
+        if (! ok) return(false);
+        denominator = word.mid(slash + 1).toDouble(&ok);
+    }
+    else numerator = word.toDouble(&ok);
+    if ((! ok) || (! (numerator > 0.0)) || (! (denominator > 0.0))) {
+        return(false);
+    }
+    *cents = (float)(1200.0 * log2(numerator / denominator));
+    return(true);
+}
+
+// parse a Scala scale file, which has a description, the number of
+//  pitches, and then each pitch above the first, ending with the period
+static bool parseScala(const QString &path, Temperament *t)
+{
+    QStringList lines;
+    if (! readLines(path, &lines)) return(false);
+    // the description may be blank, in which case the file names it
+    if (lines.isEmpty()) return(false);
+    t->name = lines.takeFirst().trimmed();
+    if (t->name.isEmpty()) t->name = QFileInfo(path).completeBaseName();
+    t->type = ScalaTemperament;
+    t->param = 0.0;
+    t->mapped = false;
+    QStringList words;
+    for (int i = 0; i < lines.length(); i++) {
+        if (! lines.at(i).trimmed().isEmpty()) words.append(firstWord(lines.at(i)));
+    }
+    bool ok = false;
+    int count = words.isEmpty() ? 0 : words.takeFirst().toInt(&ok);
+    if ((! ok) || (count < 1) || (words.length() < count)) {
+        qWarning() << "Skipping" << path << ": it has too few pitches";
+        return(false);
+    }
+    float cents;
+    t->cents.clear();
+    for (int i = 0; i < count; i++) {
+        if (! parsePitch(words.at(i), &cents)) {
+            qWarning() << "Skipping" << path << ": can't read the pitch" <<
+                words.at(i);
+            return(false);
+        }
+        t->cents.append(cents);
+    }
+    if (! (t->cents.last() > 0.0)) {
+        qWarning() << "Skipping" << path << ": its period isn't above 1/1";
+        return(false);
+    }
+    return(true);
+}
+
+// parse a Scala keyboard mapping, which has the size of the pattern, the
+//  first and last keys to retune, the key that plays the first degree,
+//  a reference key and frequency, the degree the pattern repeats at, and
+//  the degree each key of the pattern plays or "x" for none
+static bool parseKeyboard(const QString &path, Temperament *t)
+{
+    QStringList lines;
+    if (! readLines(path, &lines)) return(false);
+    QStringList words;
+    for (int i = 0; i < lines.length(); i++) {
+        if (! lines.at(i).trimmed().isEmpty()) words.append(firstWord(lines.at(i)));
+    }
+    bool ok = (words.length() >= 7);
+    int values[7];
+    for (int i = 0; (ok) && (i < 7); i++) {
+        // the reference frequency is a float, and isn't used since the
+        //  tuner's own reference sets the pitch
+        if (i == 5) continue;
+        values[i] = words.at(i).toInt(&ok);
+    }
+    if ((! ok) || (values[0] < 0) || (values[0] > 128) || (values[1] < 0) ||
+        (values[2] > 127) || (values[1] > values[2]) || (values[3] < 0) ||
+        (values[3] > 127) || (values[6] < 0)) {
+        qWarning() << "Ignoring" << path << ": it isn't a keyboard mapping";
+        return(false);
+    }
+    t->mapped = true;
+    t->firstNote = values[1];
+    t->lastNote = values[2];
+    t->middleNote = values[3];
+    t->mapPeriod = (values[6] > 0) ? values[6] : t->cents.size();
+    // keys left off the end of the pattern aren't mapped
+    t->keyMap.fill(-1, values[0]);
+    int degree;
+    for (int i = 0; (i < values[0]) && (7 + i < words.length()); i++) {
+        degree = words.at(7 + i).toInt(&ok);
+        if ((ok) && (degree >= 0)) t->keyMap[i] = degree;
+    }
+    return(true);
+}
+
+// parse an instrument preset, which has a name and then the pitches of
+//  its strings separated by spaces or lines
+static bool parseInstrument(const QString &path,
+                            const QHash<QString, int> &pitches, Scale *s)
+{
+    QStringList lines;
+    if (! readLines(path, &lines)) return(false);
+    while ((! lines.isEmpty()) && (lines.first().trimmed().isEmpty())) {
+        lines.removeFirst();
+    }
+    if (lines.isEmpty()) return(false);
+    s->name = lines.takeFirst().trimmed();
+    s->autoRange = false;
+    s->foldOctaves = 0;
+    s->pitches = lines.join(" ").split(whitespace, Qt::SkipEmptyParts);
+    for (int i = 0; i < s->pitches.length(); i++) {
+        if (! pitches.contains(s->pitches.at(i))) {
+            qWarning() << "Skipping" << path << ": unknown pitch" <<
+                s->pitches.at(i);
+            return(false);
+        }
+    }
+    if (s->pitches.isEmpty()) {
+        qWarning() << "Skipping" << path << ": it has no pitches";
+        return(false);
+    }
+    return(true);
+}
+
+static bool temperamentLessThan(const Temperament &a, const Temperament &b)
+{
+    return(a.name.compare(b.name, Qt::CaseInsensitive) < 0);
+}
+
+static bool scaleLessThan(const Scale &a, const Scale &b)
+{
+    return(a.name.compare(b.name, Qt::CaseInsensitive) < 0);
+}
+
+// append bytes to the index at a boundary of four bytes or the given
+//  alignment, returning their offset
+static quint32 appendAligned(QByteArray &index, const char *bytes, int count,
+                             int alignment = 4)
+{
+    while ((index.size() % alignment) != 0) index.append('\0');
+    quint32 offset = index.size();
+    index.append(bytes, count);
+    return(offset);
+}
+
+QFileInfoList TuningLibrary::listFiles(const QString &directory)
+{
+    return(QDir(directory).entryInfoList(
+        QStringList() << "*.scl" << "*.kbm" << "*.inst", QDir::Files,
+        QDir::Name));
+}
+
+QByteArray TuningLibrary::compile(const QString &directory,
+                                  const QFileInfoList &files,
+                                  const QHash<QString, int> &pitches)
+{
+    QList<Temperament> temperamentList;
+    QList<Scale> scaleList;
+    QDir dir(directory);
+    for (int i = 0; i < files.length(); i++) {
+        const QFileInfo &info = files.at(i);
+        // keyboard mappings are read along with their scales
+        if (info.suffix() == "kbm") continue;
+        if (info.suffix() == "scl") {
+            Temperament t;
+            if (! parseScala(info.filePath(), &t)) continue;
+            // a keyboard mapping of the same name goes with the scale
+            QString kbm = dir.filePath(info.completeBaseName() + ".kbm");
+            if (QFileInfo(kbm).isFile()) parseKeyboard(kbm, &t);
+            temperamentList.append(t);
+        }
+        else {
+            Scale s;
+            if (parseInstrument(info.filePath(), pitches, &s)) scaleList.append(s);
+        }
+    }
+    std::sort(temperamentList.begin(), temperamentList.end(),
+              temperamentLessThan);
+    std::sort(scaleList.begin(), scaleList.end(), scaleLessThan);
+    // lay out the header and entries, then the data they point to
+    TuningIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TUNING_INDEX_MAGIC, 8);
+    header.version = TUNING_INDEX_VERSION;
+    header.temperaments = temperamentList.length();
+    header.scales = scaleList.length();
+    header.files = files.length();
+    int count = temperamentList.length() + scaleList.length();
+    QVector<TuningIndexEntry> entries(count);
+    memset(entries.data(), 0, count * sizeof(TuningIndexEntry));
+    QByteArray index;
+    index.append((const char *)&header, sizeof(header));
+    index.append((const char *)entries.constData(),
+                 count * sizeof(TuningIndexEntry));
+    QByteArray bytes;
+    TuningIndexEntry *e = entries.data();
+    for (int i = 0; i < temperamentList.length(); i++, e++) {
+        const Temperament &t = temperamentList.at(i);
+        bytes = t.name.toUtf8();
+        e->nameOffset = appendAligned(index, bytes.constData(), bytes.size());
+        e->nameLength = bytes.size();
+        e->dataOffset = appendAligned(index, (const char *)t.cents.constData(),
+                                      t.cents.size() * sizeof(float));
+        e->dataCount = t.cents.size();
+        if (t.mapped) {
+            QVector<qint32> keys(t.keyMap.size());
+            for (int k = 0; k < t.keyMap.size(); k++) keys[k] = t.keyMap.at(k);
+            e->mapOffset = appendAligned(index, (const char *)keys.constData(),
+                                         keys.size() * sizeof(qint32));
+            e->mapCount = keys.size();
+            e->firstNote = t.firstNote;
+            e->lastNote = t.lastNote;
+            e->middleNote = t.middleNote;
+            e->mapPeriod = t.mapPeriod;
+            e->flags = TUNING_MAPPED;
+        }
+    }
+    for (int i = 0; i < scaleList.length(); i++, e++) {
+        const Scale &s = scaleList.at(i);
+        bytes = s.name.toUtf8();
+        e->nameOffset = appendAligned(index, bytes.constData(), bytes.size());
+        e->nameLength = bytes.size();
+        bytes = QStringList(s.pitches).join(" ").toUtf8();
+        e->dataOffset = appendAligned(index, bytes.constData(), bytes.size());
+        e->dataCount = bytes.size();
+    }
+    // list the files the index was compiled from as they were before any
+    //  were read, so an edit made while compiling shows up next time
+    QVector<TuningIndexFile> fileEntries(files.length());
+    TuningIndexFile *f = fileEntries.data();
+    for (int i = 0; i < files.length(); i++, f++) {
+        const QFileInfo &info = files.at(i);
+        bytes = info.fileName().toUtf8();
+        f->nameOffset = appendAligned(index, bytes.constData(), bytes.size());
+        f->nameLength = bytes.size();
+        f->size = info.size();
+        f->modified = info.lastModified().toMSecsSinceEpoch();
+    }
+    header.filesOffset = appendAligned(index,
+        (const char *)fileEntries.constData(),
+        files.length() * sizeof(TuningIndexFile), 8);
+    memcpy(index.data(), &header, sizeof(header));
+    memcpy(index.data() + sizeof(header), entries.constData(),
+           count * sizeof(TuningIndexEntry));
+    return(index);
+}
+
+bool TuningLibrary::matches(const QFileInfoList &files)
+{
+    const TuningIndexHeader *header = (const TuningIndexHeader *)data;
+    if ((header->files != (quint32)files.length()) ||
+        ((header->filesOffset % 8) != 0) ||
+        ((qint64)header->filesOffset +
+         ((qint64)header->files * (qint64)sizeof(TuningIndexFile)) > size)) {
+        return(false);
+    }
+    const TuningIndexFile *f =
+        (const TuningIndexFile *)(data + header->filesOffset);
+    for (int i = 0; i < files.length(); i++, f++) {
+        const QFileInfo &info = files.at(i);
+        if ((f->size != info.size()) ||
+            (f->modified != info.lastModified().toMSecsSinceEpoch()) ||
+            ((qint64)f->nameOffset + (qint64)f->nameLength > size) ||
+            (QString::fromUtf8((const char *)data + f->nameOffset,
+                               f->nameLength) != info.fileName())) {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+bool TuningLibrary::open(const QString &directory,
+                         const QHash<QString, int> &pitches)
+{
+    close();
+    QFileInfo dirInfo(directory);
+    if (! dirInfo.isDir()) return(false);
+    // an edit made in place doesn't touch the directory, so the index is
+    //  checked against the size and age of every file, which only takes
+    //  listing the directory
+    QFileInfoList files = listFiles(dirInfo.absoluteFilePath());
+    QString path = dirInfo.absoluteFilePath();
+    QString cacheDir =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString indexPath = QString("%1/tunings-%2.index").arg(cacheDir)
+        .arg(qHash(path), 8, 16, QChar('0'));
+    const TuningIndexHeader *header;
+    file.setFileName(indexPath);
+    if (file.open(QIODevice::ReadOnly)) {
+        size = file.size();
+        data = file.map(0, size);
+        header = (const TuningIndexHeader *)data;
+        if ((data != NULL) && ((size_t)size >= sizeof(TuningIndexHeader)) &&
+            (memcmp(header->magic, TUNING_INDEX_MAGIC, 8) == 0) &&
+            (header->version == TUNING_INDEX_VERSION) &&
+            ((qint64)sizeof(TuningIndexHeader) +
+             ((qint64)header->temperaments + (qint64)header->scales) *
+             (qint64)sizeof(TuningIndexEntry) <= size) &&
+            (matches(files))) {
+            temperaments = header->temperaments;
+            scales = header->scales;
+            return(true);
+        }
+        close();
+    }
+    // compile the directory and keep the result for next time, using it
+    //  from memory either way
+    compiled = compile(path, files, pitches);
+    QDir().mkpath(cacheDir);
+    QSaveFile save(indexPath);
+    if ((! save.open(QIODevice::WriteOnly)) ||
+        (save.write(compiled) != compiled.size()) || (! save.commit())) {
+        qWarning() << "Failed to save the tuning index to" << indexPath <<
+            ":" << save.errorString();
+    }
+    data = (const uchar *)compiled.constData();
+    size = compiled.size();
+    header = (const TuningIndexHeader *)data;
+    temperaments = header->temperaments;
+    scales = header->scales;
+    return(true);
+}
+
+void TuningLibrary::close()
+{
+    if (file.isOpen()) {
+        if (data != NULL) file.unmap((uchar *)data);
+        file.close();
+    }
+    compiled.clear();
+    data = NULL;
+    size = 0;
+    temperaments = 0;
+    scales = 0;
+}
+
+const TuningIndexEntry *TuningLibrary::entry(int index)
+{
+    if ((index < 0) || (index >= temperaments + scales)) return(NULL);
+    const TuningIndexEntry *e = (const TuningIndexEntry *)
+        (data + sizeof(TuningIndexHeader)) + index;
+    // check that everything the entry points to is in the index, in case
+    //  the file was damaged
+    qint64 unit = (index < temperaments) ? sizeof(float) : 1;
+    if (((qint64)e->nameOffset + (qint64)e->nameLength > size) ||
+        ((qint64)e->dataOffset + ((qint64)e->dataCount * unit) > size) ||
+        ((qint64)e->mapOffset + ((qint64)e->mapCount * 4) > size) ||
+        ((e->dataOffset % 4) != 0) || ((e->mapOffset % 4) != 0)) {
+        return(NULL);
+    }
+    return(e);
+}
+
+QString TuningLibrary::entryName(const TuningIndexEntry *e)
+{
+    if (e == NULL) return(QString());
+    return(QString::fromUtf8((const char *)data + e->nameOffset,
+                             e->nameLength));
+}
+
+QString TuningLibrary::temperamentName(int index)
+{
+    if ((index < 0) || (index >= temperaments)) return(QString());
+    return(entryName(entry(index)));
+}
+
+QString TuningLibrary::scaleName(int index)
+{
+    if ((index < 0) || (index >= scales)) return(QString());
+    return(entryName(entry(temperaments + index)));
+}
+
+bool TuningLibrary::temperament(int index, Temperament *out)
+{
+    if ((index < 0) || (index >= temperaments)) return(false);
+    const TuningIndexEntry *e = entry(index);
+    if ((e == NULL) || (e->dataCount < 1)) return(false);
+    out->name = entryName(e);
+    out->type = ScalaTemperament;
+    out->param = 0.0;
+    out->cents.resize(e->dataCount);
+    memcpy(out->cents.data(), data + e->dataOffset,
+           e->dataCount * sizeof(float));
+    out->mapped = ((e->flags & TUNING_MAPPED) != 0);
+    out->keyMap.resize(e->mapCount);
+    const qint32 *keys = (const qint32 *)(data + e->mapOffset);
+    for (quint32 k = 0; k < e->mapCount; k++) out->keyMap[k] = keys[k];
+    out->firstNote = e->firstNote;
+    out->lastNote = e->lastNote;
+    out->middleNote = e->middleNote;
+    out->mapPeriod = e->mapPeriod;
+    return(true);
+}
+
+bool TuningLibrary::scale(int index, Scale *out)
+{
+    if ((index < 0) || (index >= scales)) return(false);
+    const TuningIndexEntry *e = entry(temperaments + index);
+    if (e == NULL) return(false);
+    out->name = entryName(e);
+    out->pitches = QString::fromUtf8((const char *)data + e->dataOffset,
+                                     e->dataCount)
+        .split(' ', Qt::SkipEmptyParts);
+    out->autoRange = false;
+    out->foldOctaves = 0;
+    return(true);
+}
+
+TuningLibrary::~TuningLibrary()
+{
+    close();
+}
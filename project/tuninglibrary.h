@@ -0,0 +1,119 @@
+#ifndef TUNINGLIBRARY_H
+#define TUNINGLIBRARY_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include "frequencymap.h"
+
+// the version of the index format, which invalidates older indexes
+#define TUNING_INDEX_VERSION 2
+
+// the header at the start of an index
+typedef struct {
+    char magic[8];
+    quint32 version;
+    // the number of temperaments and scales, whose entries follow the
+    //  header in that order
+    quint32 temperaments;
+    quint32 scales;
+    // the number of files the index was compiled from and the offset of
+    //  their entries, aligned to eight bytes
+    quint32 files;
+    quint32 filesOffset;
+    quint32 reserved;
+} TuningIndexHeader;
+
+// an entry for a temperament or scale, with offsets from the start of the
+//  index and all arrays aligned to four bytes
+typedef struct {
+    // the name as UTF-8
+    quint32 nameOffset;
+    quint32 nameLength;
+    // for a temperament, a float for the cents of each degree above the
+    //  first, ending with the period; for a scale, its pitch names as
+    //  UTF-8 separated by spaces, with the count in bytes
+    quint32 dataOffset;
+    quint32 dataCount;
+    // for a mapped temperament, an int for the degree each key in the
+    //  pattern plays, or -1 for none
+    quint32 mapOffset;
+    quint32 mapCount;
+    qint32 firstNote;
+    qint32 lastNote;
+    qint32 middleNote;
+    qint32 mapPeriod;
+    // TUNING_MAPPED if the temperament has a keyboard mapping
+    quint32 flags;
+    quint32 reserved;
+} TuningIndexEntry;
+
+#define TUNING_MAPPED 0x01
+
+// an entry for a file the index was compiled from, so an index can be
+//  checked against the directory by listing it without reading any files
+typedef struct {
+    // the file's name within the directory as UTF-8
+    quint32 nameOffset;
+    quint32 nameLength;
+    // its size in bytes and when it was last modified, in milliseconds
+    //  since the epoch
+    qint64 size;
+    qint64 modified;
+} TuningIndexFile;
+
+// temperaments from Scala .scl files (with an optional .kbm keyboard
+//  mapping of the same name) and instrument presets from .inst files in
+//  a directory, compiled into a binary index in the cache directory the
+//  first time the directory is seen or after any of its files change;
+//  opening a fresh index only lists the directory and maps the index, and
+//  entries are decoded as they're asked for, so startup doesn't depend on
+//  how many tunings there are
+class TuningLibrary
+{
+public:
+    TuningLibrary();
+    ~TuningLibrary();
+    // the directory FrequencyMap loads tunings from
+    static QString defaultDirectory();
+    static void setDefaultDirectory(const QString &path);
+    // open the index for a directory, compiling it if it's missing or
+    //  stale, where pitch names in instrument presets are checked against
+    //  the given map; returns false if there's nothing to load
+    bool open(const QString &directory, const QHash<QString, int> &pitches);
+    void close();
+    // get the number of entries of each kind, their names, and the
+    //  entries themselves, returning false for a bad index
+    int temperamentCount() { return(temperaments); }
+    int scaleCount() { return(scales); }
+    QString temperamentName(int index);
+    QString scaleName(int index);
+    bool temperament(int index, Temperament *out);
+    bool scale(int index, Scale *out);
+
+private:
+    // list the files in a directory that tunings are loaded from
+    static QFileInfoList listFiles(const QString &directory);
+    // compile the tunings in a list of files into an index
+    static QByteArray compile(const QString &directory,
+                              const QFileInfoList &files,
+                              const QHash<QString, int> &pitches);
+    // whether the open index was compiled from files that are all the
+    //  same size and age as a list of files
+    bool matches(const QFileInfoList &files);
+    // get an entry and check that everything it points to is in the index
+    const TuningIndexEntry *entry(int index);
+    QString entryName(const TuningIndexEntry *e);
+    // the index, either mapped from its file or compiled into memory
+    QFile file;
+    QByteArray compiled;
+    const uchar *data;
+    qint64 size;
+    int temperaments;
+    int scales;
+};
+
+#endif // TUNINGLIBRARY_H
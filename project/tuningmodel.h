@@ -0,0 +1,41 @@
+#ifndef TUNINGMODEL_H
+#define TUNINGMODEL_H
+
+#include <QAbstractListModel>
+
+#include "frequencymap.h"
+
+// which list of a frequency map to show
+typedef enum {
+    TuningTemperaments,
+    TuningScales
+} TuningList;
+
+// presents the names of a frequency map's temperaments or scales to a
+//  combo box, looking each one up only when it's shown or searched, so a
+//  large tuning library doesn't have to be read into the box up front
+class TuningModel : public QAbstractListModel
+{
+public:
+    TuningModel(FrequencyMap *inFreqs, TuningList inList, QObject *parent = 0) :
+        QAbstractListModel(parent), freqs(inFreqs), list(inList) { }
+    int rowCount(const QModelIndex &parent = QModelIndex()) const {
+        if (parent.isValid()) return(0);
+        return((list == TuningScales) ? freqs->scaleCount() :
+                                        freqs->temperamentCount());
+    }
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const {
+        if ((! index.isValid()) ||
+            ((role != Qt::DisplayRole) && (role != Qt::EditRole))) {
+            return(QVariant());
+        }
+        return((list == TuningScales) ? freqs->scaleName(index.row()) :
+                                        freqs->temperamentName(index.row()));
+    }
+
+private:
+    FrequencyMap *freqs;
+    TuningList list;
+};
+
+#endif // TUNINGMODEL_H
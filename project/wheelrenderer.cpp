@@ -0,0 +1,90 @@
+#include "wheelrenderer.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// premultiplied colors for signed levels from -WHEEL_LEVELS to
+//  WHEEL_LEVELS, where positive levels are white and negative ones black,
+//  with the level's magnitude as the opacity
+static QRgb colors[(2 * WHEEL_LEVELS) + 1];
+static bool colorsReady = false;
+
+static void initColors()
+{
+    int a;
+    for (int level = - WHEEL_LEVELS; level <= WHEEL_LEVELS; level++) {
+        a = abs(level);
+        colors[level + WHEEL_LEVELS] = (level > 0) ? qRgba(a, a, a, a) : qRgba(0, 0, 0, a);
+    }
+    colorsReady = true;
+}
+
+WheelRenderer::WheelRenderer()
+{
+    diameter = 0;
+    sampleCount = 0;
+    if (! colorsReady) initColors();
+}
+
+void WheelRenderer::rebuild(int newDiameter, int newSampleCount)
+{
+    diameter = newDiameter;
+    sampleCount = newSampleCount;
+    image = QImage(diameter, diameter, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    offsets.clear();
+    bins.clear();
+    coverage.clear();
+    float outerRadius = (float)diameter / 2.0;
+    float innerRadius = outerRadius / 2.0;
+    float center = outerRadius;
+    float dx, dy, d, outer, inner, phase;
+    int stride = image.bytesPerLine() / sizeof(QRgb);
+    int bin;
+    for (int y = 0; y < diameter; y++) {
+        dy = ((float)y + 0.5) - center;
+        for (int x = 0; x < diameter; x++) {
+            dx = ((float)x + 0.5) - center;
+            d = sqrtf((dx * dx) + (dy * dy));
+            // approximate antialiasing from the distance to each edge
+            outer = qBound(0.0f, outerRadius - d + 0.5f, 1.0f);
+            inner = qBound(0.0f, d - innerRadius + 0.5f, 1.0f);
+            if ((outer <= 0.0) || (inner <= 0.0)) continue;
+            // segments start at 12 o'clock and run counterclockwise
+            phase = (atan2f(- dy, dx) / (2.0 * M_PI)) - 0.25;
+            phase -= floorf(phase);
+            bin = (int)(phase * (float)sampleCount);
+            if (bin >= sampleCount) bin = sampleCount - 1;
+            offsets.append((y * stride) + x);
+            bins.append(bin);
+            coverage.append((int)(qMin(outer, inner) * 256.0));
+        }
+    }
+}
+
+const QImage &WheelRenderer::render(const float *samples, int count,
+                                    int size, float alpha)
+{
+    if ((size != diameter) || (count != sampleCount)) rebuild(size, count);
+    QRgb *pixels = (QRgb *)image.bits();
+    const int *offset = offsets.constData();
+    const int *bin = bins.constData();
+    const int *cover = coverage.constData();
+    int pixelCount = offsets.size();
+    float scale = alpha * (float)WHEEL_LEVELS;
+    QRgb color;
+    for (int i = 0; i < pixelCount; i++) {
+        color = colors[level(samples[*bin], scale) + WHEEL_LEVELS];
+        // scale edge pixels by their coverage, which works on all four
+        //  channels at once since the colors are premultiplied
+        if (*cover < 256) {
+            color = ((((color & 0x00FF00FF) * *cover) >> 8) & 0x00FF00FF) |
+                    ((((color >> 8) & 0x00FF00FF) * *cover) & 0xFF00FF00);
+        }
+        pixels[*offset] = color;
+        offset++;
+        bin++;
+        cover++;
+    }
+    return(image);
+}
@@ -0,0 +1,42 @@
+#ifndef WHEELRENDERER_H
+#define WHEELRENDERER_H
+
+#include <QImage>
+#include <QVector>
+
+// the number of gray levels on each side of zero
+#define WHEEL_LEVELS 255
+
+// draws a wheel's segments straight into a cached image, using lookup
+//  tables that only need rebuilding when the wheel's size or number of
+//  segments changes
+class WheelRenderer
+{
+public:
+    WheelRenderer();
+    // render a wheel of the given outer diameter in pixels, returning the
+    //  image to draw
+    const QImage &render(const float *samples, int count, int size,
+                         float alpha);
+    // get the signed gray level a segment is drawn at, given the wheel's
+    //  alpha times WHEEL_LEVELS
+    static int level(float sample, float scale) {
+        return((int)(qBound(-1.0f, sample, 1.0f) * scale));
+    }
+
+private:
+    // rebuild the image and lookup maps for a new size or segment count
+    void rebuild(int newDiameter, int newSampleCount);
+    // the size and segment count the maps were built for
+    int diameter;
+    int sampleCount;
+    // for each pixel in the ring, its offset into the image, the segment
+    //  it shows, and how much of it is covered by the ring (0-256)
+    QVector<int> offsets;
+    QVector<int> bins;
+    QVector<int> coverage;
+    // the cached wheel image
+    QImage image;
+};
+
+#endif // WHEELRENDERER_H
@@ -2,13 +2,22 @@
 #include "ui_widget.h"
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <QPainter>
-#include <QConicalGradient>
-#include <QMessageBox>
 #include <QDebug>
 #include <QApplication>
+#include <QWindow>
+#include <QFontDatabase>
+#include <QComboBox>
+#include <QCompleter>
+#include <QListView>
+#include <QElapsedTimer>
+#include <QPaintEvent>
+
+#include "profiler.h"
+#include "tuningmodel.h"
 
 Widget::Widget(QWidget *parent) :
     QWidget(parent),
@@ -16,35 +25,84 @@ Widget::Widget(QWidget *parent) :
 {
     // initialize pointers
     input = NULL;
-    wheels = NULL;
+    connecting = false;
+    shown = NULL;
+    memset(&paintCounters, 0, sizeof(paintCounters));
+    memset(&lastPaint, 0, sizeof(lastPaint));
+    replaySpeed = ReplayRealTime;
+    overflow = DropNewest;
+    channelCount = 1;
+    splitStrings = false;
+    profileOverlay = false;
+    Profiler::nameThread("gui");
+    // start analyzing audio in the background, only asking for frames when
+    //  there are new wheels to show
+    analyzer = new Analyzer(this);
+    frameRequested = false;
+    publishNotifier = NULL;
+    if (analyzer->publishedDescriptor() >= 0) {
+        publishNotifier = new QSocketNotifier(analyzer->publishedDescriptor(),
+                                              QSocketNotifier::Read, this);
+        connect(publishNotifier, SIGNAL(activated(int)),
+                this, SLOT(wheelsPublished()));
+    }
+    analyzer->start();
     // set up the UI
     ui->setupUi(this);
     populateSelects();
-    // hide the advanced interface
+    showStatus("");
+    // hide the advanced interface and controls for several channels
     toggleAdvanced(false);
-    // connect the audio input
-    connectInput();
+    ui->toggleSplit->setVisible(false);
+    // make inputs in the background so a slow or missing JACK server
+    //  doesn't hold up the window
+    connector = new InputConnector(analyzer, this);
+    connect(connector, SIGNAL(connected()), this, SLOT(inputConnected()));
+    connect(connector, SIGNAL(failed(QString,int)),
+            this, SLOT(inputFailed(QString,int)));
+    connector->start();
+    // connect the audio input once the event loop starts, so options given
+    //  after construction can choose what to connect to
+    QMetaObject::invokeMethod(this, "connectInput", Qt::QueuedConnection);
     // autoselect by default
     toggleAutoselect(true);
     // initialize wheel definitions
     selectScale(0);
-    // start the update timer
-    updateTimer = new QTimer(this);
-    connect(updateTimer, SIGNAL(timeout()), this, SLOT(updateWheels()));
-    updateTimer->start(50);
+    // refresh input telemetry once a second
+    telemetryTimer = new QTimer(this);
+    connect(telemetryTimer, SIGNAL(timeout()), this, SLOT(updateTelemetry()));
+    telemetryTimer->start(1000);
+    updateTelemetry();
+}
+
+// let a combo box with a long list be searched by typing any part of a name
+static void makeSearchable(QComboBox *box)
+{
+    box->setEditable(true);
+    box->setInsertPolicy(QComboBox::NoInsert);
+    // sizing the box to its longest item would read every name
+    box->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+    box->setMinimumContentsLength(16);
+    QListView *view = qobject_cast<QListView *>(box->view());
+    if (view != NULL) view->setUniformItemSizes(true);
+    QCompleter *completer = box->completer();
+    completer->setCompletionMode(QCompleter::PopupCompletion);
+    completer->setFilterMode(Qt::MatchContains);
+    completer->setCaseSensitivity(Qt::CaseInsensitive);
 }
 
 void Widget::populateSelects()
 {
     int i, p;
     QString s;
-    for (i = 0; i < freqs.scales.length(); i++) {
-        ui->selectScale->addItem(freqs.scales.at(i).name, i);
-    }
-    for (i = 0; i < freqs.temperaments.length(); i++) {
-        ui->selectTemperament->addItem(freqs.temperaments.at(i).name, i);
-        if (i == freqs.temperamentIndex) ui->selectTemperament->setCurrentIndex(i);
-    }
+    // scales and temperaments come from models that look names up as
+    //  they're needed, since the tuning library may hold thousands
+    ui->selectScale->setModel(new TuningModel(&freqs, TuningScales, this));
+    makeSearchable(ui->selectScale);
+    ui->selectTemperament->setModel(
+        new TuningModel(&freqs, TuningTemperaments, this));
+    makeSearchable(ui->selectTemperament);
+    ui->selectTemperament->setCurrentIndex(freqs.temperamentIndex);
     for (i = 0; i < freqs.pitchNames.length(); i++) {
         s = freqs.pitchNames.at(i);
         p = freqs.pitches[s];
@@ -54,11 +112,15 @@ void Widget::populateSelects()
         }
     }
     ui->refFreq->setValue(freqs.refFreq);
+    ui->selectIntegration->addItem("No Smoothing", IntegrateWindow);
+    ui->selectIntegration->addItem("Smooth", IntegrateLeaky);
+    ui->selectIntegration->addItem("Sliding Window", IntegrateSliding);
+    ui->selectIntegration->setCurrentIndex(1);
 }
 
-void Widget::selectScale(int index)
+void Widget::selectScale(int)
 {
-    initWheels(freqs.scales[index]);
+    initWheels();
 }
 void Widget::updateScale()
 {
@@ -70,6 +132,7 @@ void Widget::selectTemperament(int index)
     if (index != freqs.temperamentIndex) {
         freqs.temperamentIndex = index;
         freqs.updateFrequencies();
+        updateScale();
     }
 }
 
@@ -91,207 +154,62 @@ void Widget::changeRefFreq(double freq) {
     }
 }
 
-void Widget::initWheels(Scale scale)
+void Widget::selectIntegration(int index)
 {
-    // remove any existing wheel definitions
-    destroyWheels();
-    // make new ones
-    float period;
-    int sampleCount, d;
-    float sampleRate = (input != NULL) ? (float)input->getSampleRate() : 44100.0;
-    QString pitch;
-    wheelCount = scale.pitches.length();
-    wheels = new Wheel[wheelCount];
-    Wheel *wheel = wheels;
-    for (int i = 0; i < wheelCount; i++) {
-        pitch = scale.pitches.at(i);
-        wheel->frequency = freqs.frequencies[freqs.pitches[pitch]];
-        wheel->label = pitch;
-        if (wheel->frequency >= 20.0) {
-            period = sampleRate / wheel->frequency;
-            sampleCount = (int)period - 1;
-        }
-        else {
-            period = 2.0;
-            sampleCount = 2;
-        }
-        wheel->sampleCount = sampleCount;
-        wheel->sampleBuffer = new jack_default_audio_sample_t[sampleCount];
-        wheel->sample = wheel->sampleBuffer;
-        wheel->endSample = wheel->sample + sampleCount;
-        wheel->addCounts = new int[sampleCount];
-        wheel->addCount = wheel->addCounts;
-        wheel->step = (float)sampleCount / period;
-        wheel->error = 0.0;
-        wheel->unders = 0;
-        wheel->overs = 0;
-        wheel->diffIndex = 0;
-        for (d = 0; d < WHEEL_DIFF_COUNT; d++) {
-            wheel->diffs[d] = 0;
-        }
-        wheel++;
-    }
-}
-
-void Widget::updateWheels()
-{
-    if (input == NULL) return;
-    // clear existing wheel data
-    int w;
-    Wheel *wheel = wheels;
-    for (w = 0; w < wheelCount; w++) {
-        memset(wheel->sampleBuffer, 0,
-            wheel->sampleCount * sizeof(*(wheel->sampleBuffer)));
-        memset(wheel->addCounts, 0,
-            wheel->sampleCount * sizeof(*(wheel->addCounts)));
-        wheel++;
-    }
-    // get audio input
-    jack_default_audio_sample_t *samples = NULL;
-    jack_nframes_t sampleCount = input->read(&samples);
-    jack_default_audio_sample_t *sample = samples;
-    // add input samples to wheels
-    jack_nframes_t s;
-    int intStep;
-    for (s = 0; s < sampleCount; s++) {
-        wheel = wheels;
-        for (w = 0; w < wheelCount; w++) {
-            *(wheel->sample) += *sample;
-            *(wheel->addCount) += 1;
-            // advance the wheel sample pointer
-            wheel->error += wheel->step;
-            if (wheel->error >= 1.0) {
-                intStep = (int)wheel->error;
-                wheel->sample += intStep;
-                wheel->addCount += intStep;
-                wheel->error -= (float)intStep;
-            }
-            if (wheel->sample >= wheel->endSample) {
-                intStep = wheel->sample - wheel->endSample;
-                wheel->sample = wheel->sampleBuffer + intStep;
-                wheel->addCount = wheel->addCounts + intStep;
-            }
-            wheel++;
-        }
-        sample++;
-    }
-    // release sample buffer
-    delete[] samples;
-    // do post-processing of samples in the wheel
-    wheel = wheels;
-    int *addCount;
-    jack_default_audio_sample_t maxAmplitude;
-    jack_default_audio_sample_t amplify;
-    jack_default_audio_sample_t amplitude;
-    for (w = 0; w < wheelCount; w++) {
-        maxAmplitude = 0.0;
-        // average added samples and get the maximum amplitude
-        addCount = wheel->addCounts;
-        sample = wheel->sampleBuffer;
-        for (s = 0; s < wheel->sampleCount; s++) {
-            *sample /= (float)*addCount;
-            // track the maximum amplitude
-            amplitude = fabs(*sample);
-            if (amplitude > maxAmplitude) maxAmplitude = amplitude;
-            // advance to the next sample
-            addCount++;
-            sample++;
+    analyzer->setIntegration(
+        (IntegrationMode)ui->selectIntegration->itemData(index).toInt());
+}
+
+void Widget::initWheels()
+{
+    QList<ChannelSpec> channels;
+    int selected = ui->selectScale->currentIndex();
+    if (selected < 0) selected = 0;
+    for (int c = 0; c < channelCount; c++) {
+        ChannelSpec channel;
+        channel.gated = false;
+        channel.foldOctaves = 0;
+        // use the channel's own scale or the selected one
+        int index = selected;
+        if ((c < channelScales.size()) && (channelScales.at(c) >= 0)) {
+            index = channelScales.at(c);
         }
-        // normalize all samples to compensate for low levels
-        //  (unless we're basically getting silence)
-        if (maxAmplitude > 0.0001) {
-            amplify = 1.0 / maxAmplitude;
-            sample = wheel->sampleBuffer;
-            for (s = 0; s < wheel->sampleCount; s++) {
-                *sample *= amplify;
-                sample++;
+        Scale scale = freqs.scale(index);
+        QList<WheelSpec> wheels = freqs.wheelsForScale(scale);
+        QString port = (channelCount > 1) ? QString("in_%1: ").arg(c + 1) : "";
+        if (splitStrings) {
+            // give each channel one string of the scale, as from a hex pickup
+            if (c < wheels.length()) {
+                channel.wheels.append(wheels.at(c));
+                channel.name = port + wheels.at(c).label;
             }
         }
-        wheel->maxAmplitude = maxAmplitude;
-        // update stats
-        updateWheelStats(wheel);
-        wheel++;
-    }
-    selectWheels();
-    // repaint the wheels
-    repaint();
-}
-
-void Widget::updateWheelStats(Wheel *wheel)
-{
-    jack_nframes_t s;
-    int unders, overs, diff, diffSum, d;
-    // reset counters
-    wheel->zeroCrossings = unders = overs = 0;
-    // loop over samples
-    jack_default_audio_sample_t *sample = wheel->sampleBuffer;
-    jack_default_audio_sample_t last = wheel->sampleBuffer[wheel->sampleCount - 1];
-    for (s = 0; s < wheel->sampleCount; s++) {
-        // count samples above and below zero
-        if (*sample < 0.0) {
-            if (last >= 0.0) wheel->zeroCrossings++;
-            unders++;
-        }
         else {
-            if (last < 0.0) wheel->zeroCrossings++;
-            overs++;
-        }
-        last = *sample;
-        sample++;
-    }
-    diff = abs(wheel->unders - unders) + abs(wheel->overs - overs);
-    wheel->unders = unders;
-    wheel->overs = overs;
-    wheel->diffs[wheel->diffIndex] = diff;
-    wheel->diffIndex = (wheel->diffIndex + 1) % WHEEL_DIFF_COUNT;
-    diffSum = 0;
-    for (d = 0; d < WHEEL_DIFF_COUNT; d++) {
-        diffSum += wheel->diffs[d];
-    }
-    wheel->instability =
-        (float)diffSum / (float)(WHEEL_DIFF_COUNT * wheel->sampleCount);
-}
-
-void Widget::selectWheels()
-{
-    int i;
-    float maxAmplitude = 0.0;
-    for (i = 0; i < wheelCount; i++) {
-        wheels[i].selected = true;
-        if (wheels[i].maxAmplitude > maxAmplitude) {
-            maxAmplitude = wheels[i].maxAmplitude;
-        }
-    }
-    if (autoselect) {
-        float cutoff = maxAmplitude * 0.95;
-        int minZC = 1000000;
-        for (i = 0; i < wheelCount; i++) {
-            if (wheels[i].maxAmplitude < cutoff) {
-                wheels[i].selected = false;
-            }
-            else if (wheels[i].zeroCrossings < minZC) {
-                minZC = wheels[i].zeroCrossings;
-            }
-        }
-        for (i = 0; i < wheelCount; i++) {
-            if (wheels[i].zeroCrossings > minZC) {
-                wheels[i].selected = false;
-            }
+            channel.wheels = wheels;
+            channel.gated = scale.autoRange;
+            channel.foldOctaves = scale.foldOctaves;
+            if (channelCount > 1) channel.name = port + scale.name;
         }
+        channels.append(channel);
     }
+    analyzer->setChannels(channels);
 }
 
-void Widget::destroyWheels()
+void Widget::setChannels(int count, const QVector<int> &scales)
 {
-    if (wheels != NULL) {
-        for (int i = 0; i < wheelCount; i++) {
-            delete[] wheels[i].sampleBuffer;
-            delete[] wheels[i].addCounts;
-        }
-        delete[] wheels;
-        wheels = NULL;
-    }
-    wheelCount = 0;
+    channelCount = (count < 1) ? 1 : count;
+    channelScales = scales;
+    ui->toggleSplit->setVisible(channelCount > 1);
+    // reconnect to get a port for each channel
+    reconnectInput();
+    initWheels();
+}
+
+void Widget::toggleSplit(bool value)
+{
+    splitStrings = value;
+    ui->toggleSplit->setChecked(value);
+    initWheels();
 }
 
 void Widget::toggleConnected(bool connected)
@@ -302,32 +220,263 @@ void Widget::toggleConnected(bool connected)
 
 void Widget::connectInput()
 {
-    // if input is already connected, we're done
-    if (input != NULL) return;
-    try {
-        input = new JackInput(0.2);
-        ui->toggleConnected->setChecked(true);
-    }
-    catch (JackInputException& e) {
-        ui->toggleConnected->setChecked(false);
-        QMessageBox *msg = new QMessageBox(QMessageBox::Critical,
-            "JACK Input Error", e.what());
-        msg->exec();
-    }
+    // if input is already connected or on the way, we're done
+    if ((input != NULL) || (connecting)) return;
+    InputPlan plan;
+    plan.replayPath = replayPath;
+    plan.replaySpeed = replaySpeed;
+    plan.channels = channelCount;
+    plan.capturePath = capturePath;
+    plan.bufferSeconds = 0.2;
+    connecting = true;
+    connector->request(plan);
+    showStatus(replayPath.isEmpty() ? "Connecting to JACK..." :
+                                      "Opening recording...");
+    ui->toggleConnected->setChecked(true);
 }
 
 void Widget::disconnectInput()
 {
+    if (connecting) {
+        connector->cancel();
+        connecting = false;
+    }
     if (input != NULL) {
-        delete input;
+        input->setListener(NULL, NULL);
+        analyzer->setInput(NULL);
+        connector->retire(input);
         input = NULL;
+    }
+    showStatus("");
+    ui->toggleConnected->setChecked(false);
+}
+
+void Widget::reconnectInput()
+{
+    if ((input == NULL) && (! connecting)) return;
+    disconnectInput();
+    connectInput();
+}
+
+// pass events from an input's threads to the interface thread
+static void inputEvent(void *context, InputEvent event)
+{
+    Widget *widget = (Widget *)context;
+    QMetaObject::invokeMethod(widget,
+        (event == InputLost) ? "inputLost" : "inputRateChanged",
+        Qt::QueuedConnection);
+}
+
+void Widget::inputConnected()
+{
+    AudioInput *made = connector->takeInput();
+    // the attempt may have been cancelled after it finished
+    if ((made == NULL) || (! connecting)) {
+        connector->retire(made);
+        return;
+    }
+    connecting = false;
+    input = made;
+    input->setOverflowPolicy(overflow);
+    input->setListener(inputEvent, this);
+    analyzer->setInput(input);
+    showStatus("");
+    // the server may have gone away before anyone was listening
+    if (input->isLost()) {
+        QMetaObject::invokeMethod(this, "inputLost", Qt::QueuedConnection);
+    }
+}
+
+void Widget::inputFailed(QString message, int retryMsecs)
+{
+    if (! connecting) return;
+    if (retryMsecs < 0) {
+        // the connector has given up, so leave the input off
+        qWarning() << message;
+        connecting = false;
         ui->toggleConnected->setChecked(false);
+        showStatus(message);
+        return;
+    }
+    showStatus(QString("%1 Retrying in %2 s.").arg(message)
+        .arg((float)retryMsecs / 1000.0, 0, 'f', 1));
+}
+
+void Widget::inputLost()
+{
+    if ((input == NULL) || (! input->isLost())) return;
+    // let go of the old client and wait for the server to come back
+    input->setListener(NULL, NULL);
+    analyzer->setInput(NULL);
+    connector->retire(input);
+    input = NULL;
+    // opening the recording again would truncate what it caught before
+    //  the server went away, so keep that and stop recording
+    if (! capturePath.isEmpty()) {
+        qWarning() << "Stopped recording to" << capturePath <<
+            "because the JACK server shut down";
+        capturePath = "";
+    }
+    connectInput();
+    showStatus("The JACK server shut down. Reconnecting...");
+}
+
+void Widget::inputRateChanged()
+{
+    // setting the input again sizes its wakeups for the new rate, and the
+    //  analyzer replans its wheels when it sees the rate has changed
+    if (input != NULL) analyzer->setInput(input);
+}
+
+void Widget::showStatus(const QString &status)
+{
+    ui->statusLabel->setText(status);
+    ui->statusLabel->setVisible(! status.isEmpty());
+}
+
+void Widget::setOverflowPolicy(OverflowPolicy policy)
+{
+    overflow = policy;
+    if (input != NULL) input->setOverflowPolicy(overflow);
+}
+
+void Widget::setResolution(int bins)
+{
+    analyzer->setResolution(bins);
+}
+
+void Widget::setPreprocessing(bool filter, float gateDb)
+{
+    analyzer->setPreprocessing(filter, gateDb);
+}
+
+void Widget::setWindowSeconds(float seconds)
+{
+    analyzer->setWindowSeconds(seconds);
+}
+
+bool Widget::setOsc(const QString &host, int port)
+{
+    return(analyzer->setOsc(host, port));
+}
+
+void Widget::setCapturePath(const QString &path)
+{
+    capturePath = path;
+    // reconnect to start recording from the new connection
+    reconnectInput();
+}
+
+void Widget::setReplay(const QString &path, ReplaySpeed speed)
+{
+    replayPath = path;
+    replaySpeed = speed;
+    reconnectInput();
+}
+
+bool Widget::setTelemetryPath(const QString &path)
+{
+    if (telemetryFile.isOpen()) telemetryFile.close();
+    if (path == "-") {
+        return(telemetryFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text));
+    }
+    telemetryFile.setFileName(path);
+    return(telemetryFile.open(QIODevice::WriteOnly | QIODevice::Append |
+                              QIODevice::Text));
+}
+
+void Widget::setProfileOverlay(bool value)
+{
+    profileOverlay = value;
+    if (profileOverlay) Profiler::enable();
+    updateProfile();
+}
+
+void Widget::updateProfile()
+{
+    // the box changes size with its lines, so repaint both old and new
+    QRect box = profileBox();
+    profileLines.clear();
+    if (! profileOverlay) {
+        update(box);
+        return;
+    }
+    ProfileSummary summaries[PROFILE_STAGES];
+    Profiler::summarize(1.0, summaries);
+    profileLines.append(QString("%1 %2 %3")
+        .arg("stage", -12).arg("p50 us", 9).arg("p99 us", 9));
+    for (int s = 0; s < PROFILE_STAGES; s++) {
+        if (summaries[s].count == 0) continue;
+        profileLines.append(QString("%1 %2 %3")
+            .arg(Profiler::stageName((ProfileStage)s), -12)
+            .arg(summaries[s].p50, 9, 'f', 1)
+            .arg(summaries[s].p99, 9, 'f', 1));
+    }
+    // show how much painting the last second took
+    profileLines.append(QString("painted %1 kpx in %2 ms, %3 paints")
+        .arg((float)lastPaint.pixels / 1000.0, 0, 'f', 1)
+        .arg((float)lastPaint.nanoseconds / 1.0e6, 0, 'f', 2)
+        .arg(lastPaint.paints));
+    profileLines.append(QString("wheels %1 drawn, %2 changed, %3 unchanged")
+        .arg(lastPaint.wheelsDrawn)
+        .arg(lastPaint.wheelsChanged)
+        .arg(lastPaint.wheelsUnchanged));
+    update(box.united(profileBox()));
+}
+
+void Widget::updateTelemetry()
+{
+    // take the paint counters for the last second
+    lastPaint = paintCounters;
+    memset(&paintCounters, 0, sizeof(paintCounters));
+    updateProfile();
+    if (input == NULL) {
+        ui->telemetryLabel->setText("");
+        return;
+    }
+    const InputTelemetry &t = input->telemetry;
+    float rate = (float)input->getSampleRate();
+    ui->telemetryLabel->setText(QString("%1 ms, %2 dropped, %3 xruns")
+        .arg(1000.0 * (float)t.readLatency.load() / rate, 0, 'f', 1)
+        .arg(t.droppedFrames.load())
+        .arg(t.xruns.load()));
+    if (! telemetryFile.isOpen()) return;
+    QString durations;
+    for (int i = 0; i < TELEMETRY_BUCKETS; i++) {
+        unsigned long limit = InputTelemetry::bucketLimit(i);
+        durations.append(QString("%1[%2,%3]").arg((i > 0) ? "," : "")
+            .arg((limit > 0) ? QString::number(limit) : QString("null"))
+            .arg(t.durations[i].load()));
     }
+    QString line = QString("{\"sampleRate\":%1,\"capacity\":%2,"
+        "\"droppedFrames\":%3,\"highWater\":%4,\"xruns\":%5,"
+        "\"readLatency\":%6,\"maxReadLatency\":%7,\"callbacks\":%8,"
+        "\"durations\":[%9],\"paint\":{\"paints\":%10,\"pixels\":%11,"
+        "\"nanoseconds\":%12,\"wheelsDrawn\":%13,\"wheelsChanged\":%14,"
+        "\"wheelsUnchanged\":%15}}\n")
+        .arg(input->getSampleRate())
+        .arg(input->getCapacity())
+        .arg(t.droppedFrames.load())
+        .arg(t.highWater.load())
+        .arg(t.xruns.load())
+        .arg(t.readLatency.load())
+        .arg(t.maxReadLatency.load())
+        .arg(t.callbacks.load())
+        .arg(durations)
+        .arg(lastPaint.paints)
+        .arg(lastPaint.pixels)
+        .arg(lastPaint.nanoseconds)
+        .arg(lastPaint.wheelsDrawn)
+        .arg(lastPaint.wheelsChanged)
+        .arg(lastPaint.wheelsUnchanged);
+    telemetryFile.write(line.toUtf8());
+    telemetryFile.flush();
 }
 
 void Widget::toggleAutoselect(bool value)
 {
     autoselect = value;
+    analyzer->setAutoselect(value);
     ui->toggleAutoselect->setChecked(value);
 }
 
@@ -345,99 +494,399 @@ void Widget::toggleAdvanced(bool showAdvanced)
     }
 }
 
-void Widget::paintEvent(QPaintEvent *)
+void Widget::showEvent(QShowEvent *)
+{
+    // pace repaints to the display by watching for the window's frames
+    QWindow *window = windowHandle();
+    if (window == NULL) return;
+    window->installEventFilter(this);
+    if ((publishNotifier == NULL) || (analyzer->hasUpdate())) requestFrame();
+}
+
+void Widget::wheelsPublished()
+{
+    analyzer->clearPublished();
+    requestFrame();
+}
+
+void Widget::requestFrame()
+{
+    // a covered window gets repainted as a whole when it's uncovered
+    QWindow *window = windowHandle();
+    if ((frameRequested) || (window == NULL) || (! window->isExposed())) return;
+    frameRequested = true;
+    window->requestUpdate();
+}
+
+bool Widget::eventFilter(QObject *watched, QEvent *event)
+{
+    QWindow *window = windowHandle();
+    if ((window != NULL) && (watched == window)) {
+        if ((event->type() == QEvent::UpdateRequest) && (frameRequested)) {
+            // only repaint wheels that look different in newly published
+            //  ones; letting a frame we asked for through would repaint the
+            //  whole window, so the wheels' own updates are all that get
+            //  painted, while frames asked for by anything else go through
+            frameRequested = false;
+            if (analyzer->hasUpdate()) scheduleRepaint();
+            // without word from the analyzer, keep checking every frame
+            if (publishNotifier == NULL) requestFrame();
+            return(true);
+        }
+        else if (event->type() == QEvent::Expose) {
+            // show wheels published while the window was covered; a frame
+            //  asked for then may never have come, and asking again while
+            //  one is on the way doesn't ask for another
+            if ((publishNotifier == NULL) || (analyzer->hasUpdate())) {
+                frameRequested = false;
+                requestFrame();
+            }
+        }
+    }
+    return(QWidget::eventFilter(watched, event));
+}
+
+// find a number of columns and rows of squares that fit count items into
+//  a rectangle
+static void layoutGrid(int w, int h, int count, int *columns, int *rows)
+{
+    *columns = 1;
+    *rows = 1;
+    while ((*columns < w) && ((*rows = h / (w / *columns)) * *columns < count)) {
+        (*columns)++;
+    }
+    if (*rows < 1) *rows = 1;
+}
+
+float Widget::wheelAlpha(const WheelFrame *wheel)
 {
-    // check boundary conditions
-    if ((! (width() > 0)) || (! (height() > 0))) return;
-    if ((! (wheelCount > 0)) || (wheels == NULL)) return;
-    // set layout params
-    QRect bounds = ui->wheelArea->geometry();
-    int w = bounds.width();
-    int h = bounds.height();
-    // lay out the wheels in a grid of squares
-    int columns = 1;
-    int rows;
-    while ((rows = h / (w / columns)) * columns < wheelCount) {
-        columns++;
-    }
-    w /= columns;
-    h /= rows;
-    // draw the wheels
     float alpha;
+    if (wheel->instability <= 0.05) alpha = 1.0;
+    else {
+        alpha = 1.0 - (wheel->instability - 0.05) / 0.10;
+        if (alpha < 0.05) alpha = 0.05;
+    }
+    if (autoselect) alpha *= wheel->selected ? 1.0 : 0.05;
+    return(alpha);
+}
+
+// get the offset shown below a wheel's label, which fades out along with
+//  an unstable pattern
+static QString offsetText(const WheelFrame *wheel, float alpha)
+{
+    if ((! wheel->hasOffset) || (! (alpha > 0.05))) return(QString());
+    return(QString("%1%2¢\n%3%4 Hz")
+        .arg((wheel->cents >= 0.0) ? "+" : "")
+        .arg(wheel->cents, 0, 'f', 1)
+        .arg((wheel->offsetHz >= 0.0) ? "+" : "")
+        .arg(wheel->offsetHz, 0, 'f', 2));
+}
+
+// note what a wheel looks like as it's drawn
+static void rememberWheel(DrawnWheel *drawn, const WheelFrame *wheel,
+                          float alpha)
+{
+    int count = wheel->samples.size();
+    const float *samples = wheel->samples.constData();
+    float scale = alpha * (float)WHEEL_LEVELS;
+    drawn->levels.resize(count);
+    qint16 *levels = drawn->levels.data();
+    for (int i = 0; i < count; i++) {
+        levels[i] = WheelRenderer::level(samples[i], scale);
+    }
+    drawn->label = wheel->label;
+    drawn->offset = offsetText(wheel, alpha);
+    drawn->offsetAlpha = (int)(alpha * 255.0);
+}
+
+// whether a wheel would look different from when it was last drawn
+static bool looksDifferent(const DrawnWheel *drawn, const WheelFrame *wheel,
+                           float alpha)
+{
+    int count = wheel->samples.size();
+    if (drawn->levels.size() != count) return(true);
+    if (drawn->label != wheel->label) return(true);
+    QString offset = offsetText(wheel, alpha);
+    if (offset != drawn->offset) return(true);
+    if ((! offset.isEmpty()) &&
+        (abs((int)(alpha * 255.0) - drawn->offsetAlpha) >= REPAINT_MIN_LEVELS)) {
+        return(true);
+    }
+    // changes too small to see build up against what was drawn until
+    //  they can be seen
+    const float *samples = wheel->samples.constData();
+    const qint16 *levels = drawn->levels.constData();
+    float scale = alpha * (float)WHEEL_LEVELS;
+    for (int i = 0; i < count; i++) {
+        if (abs(WheelRenderer::level(samples[i], scale) - levels[i]) >=
+            REPAINT_MIN_LEVELS) return(true);
+    }
+    return(false);
+}
+
+void Widget::scheduleRepaint()
+{
+    shown = analyzer->latest();
+    // a new set of wheels or a new layout needs everything repainted
+    if (layoutWheels(shown)) {
+        update();
+        return;
+    }
+    int index = 0;
+    const WheelGroup *group = shown->groups.constData();
+    for (int g = 0; g < shown->groups.size(); g++, group++) {
+        const WheelFrame *wheel = group->wheels.constData();
+        for (int i = 0; i < group->wheels.size(); i++, wheel++, index++) {
+            const QRect &r = wheelRects.at(index);
+            if (r.isNull()) continue;
+            if (! looksDifferent(&drawnWheels.at(index), wheel,
+                                 wheelAlpha(wheel))) {
+                paintCounters.wheelsUnchanged++;
+                continue;
+            }
+            // the antialiased outline can reach a pixel past the cell
+            update(r.adjusted(-1, -1, 1, 1));
+            paintCounters.wheelsChanged++;
+        }
+    }
+}
+
+bool Widget::layoutWheels(const WheelSnapshot *snapshot)
+{
+    QVector<QRect> newWheelRects;
+    QVector<QRect> newTitleRects;
+    QStringList newTitles;
+    int groupCount = snapshot->groups.size();
+    int wheelCount = 0;
+    for (int g = 0; g < groupCount; g++) {
+        wheelCount += snapshot->groups.at(g).wheels.size();
+        newTitles.append(snapshot->groups.at(g).name);
+    }
+    if ((groupCount > 0) && (wheelCount > 0)) {
+        // lay out one cell for each channel's group of wheels
+        QRect bounds = ui->wheelArea->geometry();
+        int columns, rows;
+        layoutGrid(bounds.width(), bounds.height(), groupCount, &columns, &rows);
+        int w = bounds.width() / columns;
+        int h = bounds.height() / rows;
+        QRect cell(bounds.x(), bounds.y(), w, h);
+        const WheelGroup *group = snapshot->groups.constData();
+        for (int g = 0; g < groupCount; g++, group++) {
+            layoutGroup(cell, group, &newWheelRects, &newTitleRects);
+            // advance to the next position
+            cell.moveLeft(cell.left() + w);
+            if (cell.right() > bounds.right()) {
+                cell.moveLeft(bounds.x());
+                cell.moveTop(cell.top() + h);
+            }
+        }
+    }
+    if ((newWheelRects == wheelRects) && (newTitleRects == titleRects) &&
+        (newTitles == titles)) return(false);
+    wheelRects = newWheelRects;
+    titleRects = newTitleRects;
+    titles = newTitles;
+    // wheels that have moved have to be drawn again
+    drawnWheels.clear();
+    drawnWheels.resize(wheelRects.size());
+    if (renderers.size() != wheelRects.size()) {
+        renderers.resize(wheelRects.size());
+    }
+    return(true);
+}
+
+void Widget::layoutGroup(QRect bounds, const WheelGroup *group,
+                         QVector<QRect> *wheels, QVector<QRect> *titles)
+{
+    int wheelCount = group->wheels.size();
+    // only show wheels that are running
+    int activeCount = 0;
+    for (int i = 0; i < wheelCount; i++) {
+        if (group->wheels.at(i).active) activeCount++;
+    }
+    // name the channel above its wheels
+    QRect title;
+    if (! group->name.isEmpty()) {
+        title = QRect(bounds.x(), bounds.y(), bounds.width(),
+                      fontMetrics().height() + 4);
+        bounds.setTop(title.bottom());
+    }
+    titles->append(title);
+    if (! (activeCount > 0)) {
+        for (int i = 0; i < wheelCount; i++) wheels->append(QRect());
+        return;
+    }
+    // lay out the wheels in a grid of squares
+    int columns, rows;
+    layoutGrid(bounds.width(), bounds.height(), activeCount, &columns, &rows);
+    int w = bounds.width() / columns;
+    int h = bounds.height() / rows;
     int margin = 6;
     QRect r(bounds.x(), bounds.y(), w, h);
     r.adjust(margin, margin, - margin, - margin);
-    Wheel *wheel = wheels;
     for (int i = 0; i < wheelCount; i++) {
-        if (wheel->instability <= 0.05) alpha = 1.0;
-        else {
-            alpha = 1.0 - (wheel->instability - 0.05) / 0.10;
-            if (alpha < 0.05) alpha = 0.05;
+        if (! group->wheels.at(i).active) {
+            wheels->append(QRect());
+            continue;
         }
-        if (autoselect) alpha *= wheel->selected ? 1.0 : 0.05;
-        drawWheel(r, wheel, alpha);
+        wheels->append(r);
         // advance to the next position
         r.moveLeft(r.left() + w);
-        if (r.right() > width()) {
-            r.moveLeft(bounds.x());
+        if (r.right() > bounds.right()) {
+            r.moveLeft(bounds.x() + margin);
             r.moveTop(r.top() + h);
         }
-        wheel++;
     }
 }
 
-void Widget::drawWheel(QRect r, Wheel *wheel, float alpha)
+void Widget::paintEvent(QPaintEvent *event)
 {
+    PROFILE_SCOPE(ProfilePaint);
+    QElapsedTimer timer;
+    timer.start();
+    // check boundary conditions
+    if ((! (width() > 0)) || (! (height() > 0))) return;
+    if (shown == NULL) shown = analyzer->latest();
+    // a resize moves everything, which usually comes with a full repaint
+    //  but might not
+    const QRegion &region = event->region();
+    if ((layoutWheels(shown)) && (region != QRegion(rect()))) update();
     QPainter painter(this);
-    painter.save();
-    painter.setRenderHint(QPainter::Antialiasing);
-    painter.translate(r.center().x(), r.center().y());
-    // precompute dimensions and steps
-    float outerRadius = (float)qMin(r.width(), r.height()) / 2.0;
-    float innerRadius = outerRadius / 2.0;
-    float phaseStep = 1.0 / (float)wheel->sampleCount;
-    // set up a gradient to make the wheel contents
-    painter.setPen(Qt::NoPen);
-    jack_default_audio_sample_t *sample = wheel->sampleBuffer;
-    float value;
-    float phase = 0.0;
-    QColor color;
-    QConicalGradient gradient(QPointF(0, 0), 90);
-    for (jack_nframes_t s = 0; s < wheel->sampleCount; s++) {
-        value = qMin(1.0f, fabsf(*sample)) * alpha;
-        if (*sample > 0.0) {
-            color = QColor::fromHsvF(0.0, 0.0, 1.0, value);
+    drawSnapshot(painter, region);
+    if (profileOverlay) drawProfile(painter);
+    // count what was painted
+    for (const QRect &r : region) {
+        paintCounters.pixels += r.width() * r.height();
+    }
+    paintCounters.paints++;
+    paintCounters.nanoseconds += timer.nsecsElapsed();
+}
+
+void Widget::drawSnapshot(QPainter &painter, const QRegion &region)
+{
+    int index = 0;
+    float alpha;
+    const WheelGroup *group = shown->groups.constData();
+    for (int g = 0; g < shown->groups.size(); g++, group++) {
+        // name the channel above its wheels in the widget's font, since
+        //  drawing labels changes the painter's
+        if ((! group->name.isEmpty()) && (region.intersects(titleRects.at(g)))) {
+            painter.setFont(font());
+            painter.drawText(titleRects.at(g), Qt::AlignHCenter | Qt::AlignVCenter,
+                             group->name);
         }
-        else {
-            color = QColor::fromHsvF(0.0, 0.0, 0.0, value);
+        // draw only the wheels in the area being repainted
+        const WheelFrame *wheel = group->wheels.constData();
+        for (int i = 0; i < group->wheels.size(); i++, wheel++, index++) {
+            const QRect &r = wheelRects.at(index);
+            if ((r.isNull()) || (! region.intersects(r.adjusted(-1, -1, 1, 1)))) {
+                continue;
+            }
+            alpha = wheelAlpha(wheel);
+            drawWheel(painter, r, wheel, alpha, &renderers[index]);
+            // a wheel that's only partly repainted still shows older frames
+            //  elsewhere, so forget it to have it all drawn next time
+            if ((region & r) == QRegion(r)) {
+                rememberWheel(&drawnWheels[index], wheel, alpha);
+            }
+            else drawnWheels[index] = DrawnWheel();
+            paintCounters.wheelsDrawn++;
         }
-        gradient.setColorAt(phase, color);
-        sample++;
-        phase += phaseStep;
     }
+}
+
+void Widget::drawWheel(QPainter &painter, QRect r, const WheelFrame *wheel,
+                       float alpha, WheelRenderer *renderer)
+{
+    PROFILE_SCOPE(ProfileDrawWheel);
+    // precompute dimensions
+    int diameter = qMin(r.width(), r.height());
+    if (diameter <= 0) return;
+    float outerRadius = (float)diameter / 2.0;
+    float innerRadius = outerRadius / 2.0;
+    QRect square(r.center().x() - (diameter / 2), r.center().y() - (diameter / 2),
+                 diameter, diameter);
     // draw the wheel contents
-    QPainterPath path;
-    path.addEllipse(QPointF(0.0, 0.0), outerRadius, outerRadius);
-    QPainterPath hole;
-    hole.addEllipse(QPointF(0.0, 0.0), innerRadius, innerRadius);
-    path = path.subtracted(hole);
+    painter.drawImage(square.topLeft(), renderer->render(
+        wheel->samples.constData(), wheel->samples.size(), diameter, alpha));
+    // outline the wheel
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing);
     painter.setPen(QPen(QApplication::palette().windowText(), 1));
-    painter.setBrush(QBrush(gradient));
-    painter.drawPath(path);
-    // restore context
+    painter.setBrush(Qt::NoBrush);
+    QPointF center = QRectF(square).center();
+    painter.drawEllipse(center, outerRadius, outerRadius);
+    painter.drawEllipse(center, innerRadius, innerRadius);
     painter.restore();
     // draw the label in the center
-    if (wheel->label != NULL) {
+    if (! wheel->label.isEmpty()) {
         QFont font = painter.font();
         font.setPixelSize((int)floor(innerRadius * 0.75));
         painter.setFont(font);
         painter.drawText(r, Qt::AlignHCenter | Qt::AlignVCenter, wheel->label);
     }
+    // show how far off the signal is below the label
+    QString offset = offsetText(wheel, alpha);
+    if (! offset.isEmpty()) {
+        painter.save();
+        QFont font = painter.font();
+        font.setPixelSize(qMax(1, (int)floor(innerRadius * 0.22)));
+        painter.setFont(font);
+        painter.setOpacity(alpha);
+        QRect below(square.x(), (int)(square.center().y() + (innerRadius * 0.35)),
+                    square.width(), (int)(innerRadius * 0.6));
+        painter.drawText(below, Qt::AlignHCenter | Qt::AlignTop, offset);
+        painter.restore();
+    }
+}
+
+QRect Widget::profileBox()
+{
+    if (profileLines.isEmpty()) return(QRect());
+    QFontMetrics metrics(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    int margin = 4;
+    int width = 0;
+    for (int i = 0; i < profileLines.length(); i++) {
+        width = qMax(width, metrics.horizontalAdvance(profileLines.at(i)));
+    }
+    QRect bounds = ui->wheelArea->geometry();
+    return(QRect(bounds.x(), bounds.y(), width + (2 * margin),
+                 (metrics.height() * profileLines.length()) + (2 * margin)));
+}
+
+void Widget::drawProfile(QPainter &painter)
+{
+    if (profileLines.isEmpty()) return;
+    painter.save();
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    painter.setFont(font);
+    QFontMetrics metrics(font);
+    int lineHeight = metrics.height();
+    int margin = 4;
+    QRect box = profileBox();
+    // shade the wheels behind the timings so they can be read
+    QColor shade = QApplication::palette().window().color();
+    shade.setAlpha(200);
+    painter.fillRect(box, shade);
+    painter.setPen(QApplication::palette().windowText().color());
+    for (int i = 0; i < profileLines.length(); i++) {
+        painter.drawText(box.x() + margin,
+                         box.y() + margin + (i * lineHeight) + metrics.ascent(),
+                         profileLines.at(i));
+    }
+    painter.restore();
 }
 
 Widget::~Widget()
 {
+    delete telemetryTimer;
+    // the notifier watches a descriptor the analyzer closes
+    delete publishNotifier;
+    // the connector closes the input once the analyzer lets go of it, so
+    //  both are stopped after it's handed over
+    disconnectInput();
+    connector->stop();
+    analyzer->stop();
+    delete analyzer;
     delete ui;
-    delete updateTimer;
-    destroyWheels();
 }
@@ -4,51 +4,49 @@
 #include <QWidget>
 #include <QPainter>
 #include <QString>
+#include <QEvent>
+#include <QFile>
 #include <QTimer>
+#include <QSocketNotifier>
 
 #include "jackinput.h"
+#include "replayinput.h"
+#include "inputconnector.h"
 #include "frequencymap.h"
+#include "analyzer.h"
+#include "wheelrenderer.h"
 
-#define WHEEL_DIFF_COUNT 6
+namespace Ui {
+class Widget;
+}
+
+// how many gray levels a segment has to move from what was last drawn
+//  before its wheel is drawn again
+#define REPAINT_MIN_LEVELS 2
 
-// a structure representing the state of a strobed wheel
+// what was last drawn for a wheel, so it's only drawn again when it would
+//  look different
 typedef struct {
-    // the fundamental frequency the wheel is spinning at,
-    //  in revolutions per second (i.e. Hz)
-    float frequency;
-    // a label to go in the center of the wheel, e.g. a pitch class
+    // the gray level of each segment
+    QVector<qint16> levels;
+    // the label and offset text, and the offset's opacity out of 255
     QString label;
-    // the number of wheel segments
-    jack_nframes_t sampleCount;
-    // the buffer of wheel segments
-    jack_default_audio_sample_t *sampleBuffer;
-    // a pointer to the current position in the buffer
-    jack_default_audio_sample_t *sample;
-    // a pointer one position past the last sample in the buffer
-    jack_default_audio_sample_t *endSample;
-    // a buffer counting how many input samples have been added at each sample
-    //  position
-    int *addCounts;
-    // a pointer that advances through the addCounts list
-    int *addCount;
-    // the amount to increment the wheel position for each input sample
-    float step;
-    // accumulated error between the wheel's true position and the sample pointer
-    float error;
-    // statistics about the stability of the wheel contents
-    float maxAmplitude;
-    int zeroCrossings;
-    int unders;
-    int overs;
-    int diffs[WHEEL_DIFF_COUNT];
-    int diffIndex;
-    float instability;
-    bool selected;
-} Wheel;
+    QString offset;
+    int offsetAlpha;
+} DrawnWheel;
 
-namespace Ui {
-class Widget;
-}
+// how much painting has been done over a stretch of time
+typedef struct {
+    unsigned long paints;
+    // the area painted in pixels and the time it took in nanoseconds
+    unsigned long pixels;
+    qint64 nanoseconds;
+    // how many wheels were drawn, and how many new frames of wheels were
+    //  found to have changed and not to have changed visibly
+    unsigned long wheelsDrawn;
+    unsigned long wheelsChanged;
+    unsigned long wheelsUnchanged;
+} PaintCounters;
 
 class Widget : public QWidget
 {
@@ -57,18 +55,54 @@ class Widget : public QWidget
 public:
     explicit Widget(QWidget *parent = 0);
     ~Widget();
+    // set the number of input channels and the index of the scale to use
+    //  on each, where channels without a scale or with -1 use the selected
+    //  scale
+    void setChannels(int count, const QVector<int> &scales);
+    // set what the input drops when analysis falls behind
+    void setOverflowPolicy(OverflowPolicy policy);
+    // set a fixed number of bins per revolution for every wheel, or 0 to
+    //  size each wheel to its period
+    void setResolution(int bins);
+    // set whether to band-limit the input to the range of the wheels and
+    //  the level in dB below which to silence it, or PRE_GATE_OFF for none
+    void setPreprocessing(bool filter, float gateDb);
+    // set the length of an analysis window in seconds, which is how often
+    //  the wheels are shown and sent as OSC
+    void setWindowSeconds(float seconds);
+    // stream the state of the wheels as OSC over UDP to a host and port,
+    //  returning false if the host can't be found
+    bool setOsc(const QString &host, int port);
+    // append input telemetry as a line of JSON to the given file each time
+    //  it's shown, where "-" is standard output; returns false on failure
+    bool setTelemetryPath(const QString &path);
+    // record the JACK input to a file, or stop if the path is empty
+    void setCapturePath(const QString &path);
+    // replay a recording instead of using JACK, or go back to JACK if the
+    //  path is empty
+    void setReplay(const QString &path, ReplaySpeed speed);
+    // show how long each stage of the pipeline takes over the wheels
+    void setProfileOverlay(bool value);
 
 public slots:
-    // update all wheels from audio input
-    void updateWheels();
     // make or remake the connection to the JACK server
     void connectInput();
     // disconnect from the JACK server
     void disconnectInput();
     // connect or disconnect from the JACK server
     void toggleConnected(bool connected);
+    // take up an input the connector has made
+    void inputConnected();
+    // show why an attempt to connect failed
+    void inputFailed(QString message, int retryMsecs);
+    // drop an input whose source has gone away and start reconnecting
+    void inputLost();
+    // replan the analysis for an input's new sample rate
+    void inputRateChanged();
     // toggle whether to detect the closest frequency
     void toggleAutoselect(bool value);
+    // toggle whether each channel shows one string of the scale
+    void toggleSplit(bool value);
     // toggle the visibility of advanced controls
     void toggleAdvanced(bool showAdvanced);
     // make selections
@@ -77,36 +111,96 @@ public slots:
     void updateScale();
     void selectRefPitch(int index);
     void changeRefFreq(double freq);
+    void selectIntegration(int index);
+    // show and log the health of the input
+    void updateTelemetry();
+    // ask for a frame to show wheels the analyzer has published
+    void wheelsPublished();
 
 protected:
     // populate the UI controls
     void populateSelects();
-    // initialize the array of wheel structs
-    void initWheels(Scale scale);
-    // update stats about the date in a wheel
-    void updateWheelStats(Wheel *wheel);
-    // select the wheel with the best fit to the signal
-    void selectWheels();
-    // destroy the array of wheel structs
-    void destroyWheels();
-    // repaint the widget
+    // make a new input with the current options if one is in use or on
+    //  the way
+    void reconnectInput();
+    // show what the input is doing next to the switch that controls it
+    void showStatus(const QString &status);
+    // send the wheels for each channel to the analyzer
+    void initWheels();
+    // start pacing repaints to the display once there's a window
+    void showEvent(QShowEvent *event);
+    // ask the window for a frame if one isn't already on the way
+    void requestFrame();
+    // repaint new wheels when the display is ready for a frame
+    bool eventFilter(QObject *watched, QEvent *event);
+    // take the latest wheels and mark the areas of the ones that look
+    //  different from what was last drawn as needing a repaint
+    void scheduleRepaint();
+    // work out where each wheel of a snapshot goes, returning whether
+    //  anything has moved since the last layout
+    bool layoutWheels(const WheelSnapshot *snapshot);
+    void layoutGroup(QRect bounds, const WheelGroup *group,
+                     QVector<QRect> *wheels, QVector<QRect> *titles);
+    // get how opaque to draw a wheel
+    float wheelAlpha(const WheelFrame *wheel);
+    // repaint the parts of the widget that need it
     void paintEvent(QPaintEvent *event);
-    void drawWheel(QRect r, Wheel *wheel, float alpha);
+    void drawSnapshot(QPainter &painter, const QRegion &region);
+    void drawWheel(QPainter &painter, QRect r, const WheelFrame *wheel,
+                   float alpha, WheelRenderer *renderer);
+    // summarize recent stage timings and painting, and draw them
+    void updateProfile();
+    QRect profileBox();
+    void drawProfile(QPainter &painter);
 
 private:
     Ui::Widget *ui;
     // the input to receive audio from
-    JackInput *input;
+    AudioInput *input;
+    // a worker thread that makes inputs without blocking the interface,
+    //  and whether it's working on one
+    InputConnector *connector;
+    bool connecting;
+    // where to record JACK input to, and a recording to replay instead of
+    //  using JACK and how fast
+    QString capturePath;
+    QString replayPath;
+    ReplaySpeed replaySpeed;
     // a frequency mapper to select pitches, scales, and temperaments
     FrequencyMap freqs;
     // whether to detect the fundamental frequency
     bool autoselect;
-    // the list of wheels being shown
-    Wheel *wheels;
-    // the number of wheels being shown
-    int wheelCount;
-    // a timer to update the wheels
-    QTimer *updateTimer;
+    // a worker thread that analyzes audio and publishes wheels to show
+    Analyzer *analyzer;
+    // wakes the interface when the analyzer publishes wheels, and whether
+    //  a frame has been asked for to show them
+    QSocketNotifier *publishNotifier;
+    bool frameRequested;
+    // the wheels being shown, where each wheel and group title goes, what
+    //  was last drawn for each wheel, and a renderer for each wheel
+    const WheelSnapshot *shown;
+    QVector<QRect> wheelRects;
+    QVector<QRect> titleRects;
+    QStringList titles;
+    QVector<DrawnWheel> drawnWheels;
+    QVector<WheelRenderer> renderers;
+    // painting done since the counters were last reported, and over the
+    //  last reported second
+    PaintCounters paintCounters;
+    PaintCounters lastPaint;
+    // the number of input channels, the scale to use on each, and whether
+    //  each channel shows one string of its scale
+    int channelCount;
+    QVector<int> channelScales;
+    bool splitStrings;
+    // what the input drops when analysis falls behind
+    OverflowPolicy overflow;
+    // a timer to refresh input telemetry and the file to log it to
+    QTimer *telemetryTimer;
+    QFile telemetryFile;
+    // whether to show stage timings and the timings to show
+    bool profileOverlay;
+    QStringList profileLines;
 };
 
 #endif // WIDGET_H
@@ -0,0 +1,91 @@
+#include "workerpool.h"
+#include "profiler.h"
+
+#include <stdlib.h>
+
+WorkerPool::WorkerPool()
+{
+    threads = 1;
+    workers = NULL;
+    starts = NULL;
+    sem_init(&done, 0, 0);
+    func = NULL;
+    context = NULL;
+    count = 0;
+    next = 0;
+    stopping = false;
+}
+
+void WorkerPool::init(int newThreads)
+{
+    destroy();
+    threads = (newThreads < 1) ? 1 : newThreads;
+    if (threads == 1) return;
+    stopping = false;
+    starts = new sem_t[threads - 1];
+    workers = new std::thread[threads - 1];
+    for (int i = 0; i < threads - 1; i++) {
+        sem_init(&starts[i], 0, 0);
+        workers[i] = std::thread(threadMain, this, i);
+    }
+}
+
+void WorkerPool::destroy()
+{
+    if (workers != NULL) {
+        stopping = true;
+        for (int i = 0; i < threads - 1; i++) sem_post(&starts[i]);
+        for (int i = 0; i < threads - 1; i++) {
+            workers[i].join();
+            sem_destroy(&starts[i]);
+        }
+        delete[] workers;
+        delete[] starts;
+        workers = NULL;
+        starts = NULL;
+    }
+    threads = 1;
+}
+
+void WorkerPool::run(WorkerFunc inFunc, void *inContext, int inCount)
+{
+    func = inFunc;
+    context = inContext;
+    count = inCount;
+    next.store(0, std::memory_order_relaxed);
+    // only wake as many threads as there are items for the others
+    int helpers = inCount - 1;
+    if (helpers > threads - 1) helpers = threads - 1;
+    if (helpers < 0) helpers = 0;
+    for (int i = 0; i < helpers; i++) sem_post(&starts[i]);
+    work();
+    for (int i = 0; i < helpers; i++) {
+        while (sem_wait(&done) != 0) { }
+    }
+}
+
+void WorkerPool::threadMain(WorkerPool *pool, int thread)
+{
+    Profiler::nameThread("worker");
+    while (true) {
+        while (sem_wait(&pool->starts[thread]) != 0) { }
+        if (pool->stopping) return;
+        pool->work();
+        sem_post(&pool->done);
+    }
+}
+
+void WorkerPool::work()
+{
+    int index;
+    // take items one at a time so uneven items still balance out
+    while ((index = next.fetch_add(1, std::memory_order_acq_rel)) < count) {
+        func(context, index);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    destroy();
+    sem_destroy(&done);
+}
@@ -0,0 +1,52 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <thread>
+
+#include <semaphore.h>
+
+// a function to run for one item of a parallel job
+typedef void (*WorkerFunc)(void *context, int index);
+
+// a fixed set of threads that run the items of a job in parallel and
+//  return when all of them are done; the threads are made up front and
+//  running a job doesn't allocate, so it's safe to use while analyzing
+class WorkerPool
+{
+public:
+    WorkerPool();
+    ~WorkerPool();
+    // start enough threads to run the given number of items at once,
+    //  counting the calling thread, so 1 runs everything on the caller
+    void init(int threads);
+    // stop all threads
+    void destroy();
+    // call func for each index below count, spreading the calls across
+    //  the threads, and return when all of them have finished
+    void run(WorkerFunc func, void *context, int count);
+    // the number of threads including the caller
+    int getThreads() { return(threads); }
+
+private:
+    // the entry point of each thread
+    static void threadMain(WorkerPool *pool, int thread);
+    // run items of the current job until there are none left
+    void work();
+    // the number of threads including the caller
+    int threads;
+    // the threads other than the caller and a semaphore to start each one
+    std::thread *workers;
+    sem_t *starts;
+    // posted by each thread when it runs out of items
+    sem_t done;
+    // the current job and the next item of it to run
+    WorkerFunc func;
+    void *context;
+    int count;
+    std::atomic<int> next;
+    // whether the threads should exit
+    bool stopping;
+};
+
+#endif // WORKERPOOL_H